@@ -0,0 +1,335 @@
+/*
+ * FATAsyncIO.cpp
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ */
+
+#include "FATAsyncIO.h"
+
+
+//------------------------------------------------------------------------------------
+//--- PRIVATE TYPES ------------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+static const char* _MODULE_ = "[FATAsyncIO]....";
+#define _EXPR_	(!IS_ISR())
+
+/** Intervalo de sondeo en las esperas de espacio y de finalizacion */
+static const uint32_t PollIntervalMs = 2;
+
+
+//------------------------------------------------------------------------------------
+//-- PUBLIC METHODS IMPLEMENTATION ---------------------------------------------------
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+FATAsyncIO::FATAsyncIO(FATInterface* fat, uint8_t num_workers, uint16_t queue_size, uint32_t submit_timeout_ms, uint32_t stack_size, osPriority priority) :
+		_fat(fat), _work(0), _queue_size(queue_size), _submit_timeout_ms(submit_timeout_ms), _in_progress(0), _stop(false) {
+	memset(_lanes, 0, sizeof(_lanes));
+	_lanes[0].used = true;
+	memset(&_stats, 0, sizeof(Stats));
+	for(uint8_t i = 0; i < num_workers; i++){
+		Thread* th = new Thread(priority, stack_size, NULL, "FATAsyncIO");
+		MBED_ASSERT(th);
+		if(th->start(callback(this, &FATAsyncIO::_task)) != osOK){
+			DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_THREAD, No se puede arrancar el thread de E/S %d", i);
+			delete(th);
+			continue;
+		}
+		_workers.push_back(th);
+	}
+}
+
+
+//------------------------------------------------------------------------------------
+FATAsyncIO::~FATAsyncIO(){
+	drain();
+	_stop = true;
+	for(uint32_t i = 0; i < _workers.size(); i++){
+		_work.release();
+	}
+	for(auto it = _workers.begin(); it != _workers.end(); ++it){
+		(*it)->join();
+		delete(*it);
+	}
+	for(int i = 1; i <= FATAsyncIO_MAX_HANDLES; i++){
+		if(_lanes[i].fp){
+			_fat->close(_lanes[i].fp);
+		}
+	}
+}
+
+
+//------------------------------------------------------------------------------------
+int FATAsyncIO::open(const char* filename, const char* mode, Callback<void(const Result&)> done){
+	if(strlen(filename) >= MAX_PATH_NAME_LENGTH || strlen(mode) >= sizeof(Request::mode)){
+		return -1;
+	}
+	// se reserva el handle al encolar, para poder encolar operaciones sobre el antes de su apertura
+	_mtx.lock();
+	int handle = -1;
+	for(int i = 1; i <= FATAsyncIO_MAX_HANDLES; i++){
+		if(!_lanes[i].used){
+			_lanes[i].used = true;
+			_lanes[i].fp = NULL;
+			handle = i;
+			break;
+		}
+	}
+	_mtx.unlock();
+	if(handle < 0){
+		DEBUG_TRACE_W(_EXPR_, _MODULE_, "ERR_HANDLE, No hay handles libres para %s", filename);
+		return -1;
+	}
+	Request req;
+	req.op = OpOpen;
+	req.handle = handle;
+	strcpy(req.name, filename);
+	strcpy(req.mode, mode);
+	req.done = done;
+	if(_submit(req) != 0){
+		_mtx.lock();
+		_lanes[handle].used = false;
+		_mtx.unlock();
+		return -1;
+	}
+	return handle;
+}
+
+
+//------------------------------------------------------------------------------------
+int FATAsyncIO::write(int handle, const void* data, size_t len, Callback<void(const Result&)> done){
+	if(!_isOpen(handle)){
+		return -1;
+	}
+	Request req;
+	req.op = OpWrite;
+	req.handle = handle;
+	req.wdata.assign((const uint8_t*)data, (const uint8_t*)data + len);
+	req.len = len;
+	req.done = done;
+	return _submit(req);
+}
+
+
+//------------------------------------------------------------------------------------
+int FATAsyncIO::read(int handle, void* data, size_t len, Callback<void(const Result&)> done){
+	if(!_isOpen(handle)){
+		return -1;
+	}
+	Request req;
+	req.op = OpRead;
+	req.handle = handle;
+	req.rdata = data;
+	req.len = len;
+	req.done = done;
+	return _submit(req);
+}
+
+
+//------------------------------------------------------------------------------------
+int FATAsyncIO::close(int handle, Callback<void(const Result&)> done){
+	if(!_isOpen(handle)){
+		return -1;
+	}
+	Request req;
+	req.op = OpClose;
+	req.handle = handle;
+	req.done = done;
+	return _submit(req);
+}
+
+
+//------------------------------------------------------------------------------------
+int FATAsyncIO::rename(const char* src, const char* dest, Callback<void(const Result&)> done){
+	if(strlen(src) >= MAX_PATH_NAME_LENGTH || strlen(dest) >= MAX_PATH_NAME_LENGTH){
+		return -1;
+	}
+	Request req;
+	req.op = OpRename;
+	req.handle = 0;
+	strcpy(req.name, src);
+	strcpy(req.dest, dest);
+	req.done = done;
+	return _submit(req);
+}
+
+
+//------------------------------------------------------------------------------------
+int FATAsyncIO::unlink(const char* filename, Callback<void(const Result&)> done){
+	if(strlen(filename) >= MAX_PATH_NAME_LENGTH){
+		return -1;
+	}
+	Request req;
+	req.op = OpUnlink;
+	req.handle = 0;
+	strcpy(req.name, filename);
+	req.done = done;
+	return _submit(req);
+}
+
+
+//------------------------------------------------------------------------------------
+int FATAsyncIO::drain(uint32_t timeout_ms){
+	uint32_t elapsed = 0;
+	for(;;){
+		_mtx.lock();
+		bool done = (_queue.empty() && _in_progress == 0);
+		_mtx.unlock();
+		if(done){
+			return 0;
+		}
+		if(timeout_ms != osWaitForever && elapsed >= timeout_ms){
+			return -1;
+		}
+		ThisThread::sleep_for(PollIntervalMs);
+		elapsed += PollIntervalMs;
+	}
+}
+
+
+//------------------------------------------------------------------------------------
+void FATAsyncIO::getStats(Stats* stats){
+	_mtx.lock();
+	*stats = _stats;
+	_mtx.unlock();
+}
+
+
+//------------------------------------------------------------------------------------
+//-- PRIVATE METHODS IMPLEMENTATION --------------------------------------------------
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+bool FATAsyncIO::_isOpen(int handle){
+	if(handle <= 0 || handle > FATAsyncIO_MAX_HANDLES){
+		return false;
+	}
+	_mtx.lock();
+	bool used = _lanes[handle].used;
+	_mtx.unlock();
+	return used;
+}
+
+
+//------------------------------------------------------------------------------------
+int FATAsyncIO::_submit(Request& req){
+	uint32_t elapsed = 0;
+	bool blocked = false;
+	_mtx.lock();
+	// con la cola llena se espera espacio hasta el tiempo configurado
+	while(_queue.size() >= _queue_size){
+		if(elapsed >= _submit_timeout_ms){
+			_stats.rejected++;
+			_mtx.unlock();
+			DEBUG_TRACE_W(_EXPR_, _MODULE_, "ERR_FULL, Cola de E/S llena, operacion %d descartada", req.op);
+			return -1;
+		}
+		if(!blocked){
+			blocked = true;
+			_stats.blocked++;
+		}
+		_mtx.unlock();
+		ThisThread::sleep_for(PollIntervalMs);
+		elapsed += PollIntervalMs;
+		_mtx.lock();
+	}
+	req.t_submit = FATPlatform::now_us();
+	_queue.push_back(req);
+	_stats.submitted++;
+	if(_queue.size() > _stats.max_depth){
+		_stats.max_depth = _queue.size();
+	}
+	_mtx.unlock();
+	_work.release();
+	return 0;
+}
+
+
+//------------------------------------------------------------------------------------
+int FATAsyncIO::_execute(Request& req){
+	Lane& lane = _lanes[req.handle];
+	switch(req.op){
+		case OpOpen:{
+			lane.fp = _fat->open(req.name, req.mode);
+			return (lane.fp)? 0 : -1;
+		}
+		case OpWrite:{
+			return (lane.fp)? (int)_fat->write(req.wdata.data(), sizeof(uint8_t), req.len, lane.fp) : -1;
+		}
+		case OpRead:{
+			return (lane.fp)? (int)_fat->read(req.rdata, sizeof(uint8_t), req.len, lane.fp) : -1;
+		}
+		case OpClose:{
+			int err = (lane.fp)? _fat->close(lane.fp) : -1;
+			lane.fp = NULL;
+			return err;
+		}
+		case OpRename:{
+			return _fat->renameFile(req.name, req.dest);
+		}
+		case OpUnlink:{
+			return _fat->_unlink(req.name);
+		}
+	}
+	return -1;
+}
+
+
+//------------------------------------------------------------------------------------
+void FATAsyncIO::_task(){
+	for(;;){
+		_work.wait(osWaitForever);
+		_mtx.lock();
+		if(_stop && _queue.empty()){
+			_mtx.unlock();
+			return;
+		}
+		// primera solicitud de un handle sin operaciones en curso, preservando el orden de cada handle
+		auto it = _queue.begin();
+		for(; it != _queue.end(); ++it){
+			if(!_lanes[it->handle].busy){
+				break;
+			}
+		}
+		if(it == _queue.end()){
+			_mtx.unlock();
+			continue;
+		}
+		Request req;
+		std::swap(req, *it);
+		_queue.erase(it);
+		_lanes[req.handle].busy = true;
+		_in_progress++;
+		_mtx.unlock();
+
+		Result res;
+		res.op = req.op;
+		res.handle = req.handle;
+		res.wait_us = FATPlatform::now_us() - req.t_submit;
+		res.result = _execute(req);
+		if(req.done){
+			req.done.call(res);
+		}
+
+		_mtx.lock();
+		_lanes[req.handle].busy = false;
+		if(req.op == OpClose){
+			_lanes[req.handle].used = false;
+		}
+		_in_progress--;
+		_stats.completed++;
+		if(res.wait_us > _stats.max_wait_us){
+			_stats.max_wait_us = res.wait_us;
+		}
+		bool pending = !_queue.empty();
+		_mtx.unlock();
+		// las solicitudes retenidas por este handle quedan disponibles para otro thread
+		if(pending){
+			_work.release();
+		}
+	}
+}
+
+/**** END OF FILE ****/
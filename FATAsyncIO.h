@@ -0,0 +1,204 @@
+/*
+ * FATAsyncIO.h
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ *
+ *	FATAsyncIO ejecuta las operaciones de FATInterface en uno o varios threads de E/S, de forma que los borrados de
+ *  sector que se producen dentro de fwrite/fclose no bloquean a la tarea que las solicita. Las solicitudes se
+ *  encolan en una cola acotada y su resultado se notifica mediante una callback ejecutada en el thread de E/S.
+ *
+ *  Los archivos se identifican mediante un handle asignado al solicitar su apertura. Las operaciones sobre un mismo
+ *  handle se ejecutan en orden de solicitud, aunque haya varios threads de E/S. Las operaciones sobre el espacio de
+ *  nombres (rename, unlink) se ejecutan en orden entre si; para ordenarlas respecto a un handle debe esperarse a
+ *  la finalizacion de las operaciones previas.
+ */
+
+#ifndef __FATAsyncIO__H
+#define __FATAsyncIO__H
+
+#include "mbed.h"
+#include "FATInterface.h"
+#include <list>
+#include <vector>
+
+
+/** Numero maximo de archivos abiertos simultaneamente */
+#define FATAsyncIO_MAX_HANDLES		8
+
+
+class FATAsyncIO{
+  public:
+
+	/** Operaciones soportadas */
+	enum OpType{
+		OpOpen,
+		OpWrite,
+		OpRead,
+		OpClose,
+		OpRename,
+		OpUnlink,
+	};
+
+	/** Resultado de una operacion, entregado en la callback de finalizacion */
+	struct Result{
+		OpType op;			/// Operacion
+		int handle;			/// Handle del archivo (0 en rename/unlink)
+		int result;			/// Bytes transferidos en read/write, 0 o codigo de error en el resto
+		uint32_t wait_us;	/// Tiempo en cola
+	};
+
+	/** Estadisticas de la cola */
+	struct Stats{
+		uint32_t submitted;		/// Solicitudes encoladas
+		uint32_t completed;		/// Solicitudes finalizadas
+		uint32_t rejected;		/// Solicitudes rechazadas por cola llena
+		uint32_t blocked;		/// Solicitudes que han esperado espacio en la cola
+		uint32_t max_depth;		/// Ocupacion maxima de la cola
+		uint32_t max_wait_us;	/// Tiempo maximo en cola
+	};
+
+    /** Constructor
+     *  Arranca los threads de E/S
+     *  @param fat Particion FAT
+     *  @param num_workers Numero de threads de E/S
+     *  @param queue_size Tamanio maximo de la cola de solicitudes
+     *  @param submit_timeout_ms Tiempo maximo de espera de espacio en la cola (0 para rechazar inmediatamente)
+     *  @param stack_size Tamanio de pila de cada thread
+     *  @param priority Prioridad de los threads
+     */
+	FATAsyncIO(FATInterface* fat, uint8_t num_workers = 1, uint16_t queue_size = 16, uint32_t submit_timeout_ms = 0,
+			   uint32_t stack_size = 4096, osPriority priority = osPriorityBelowNormal);
+
+    /** Destructor
+     *  Espera a que finalicen las solicitudes encoladas, detiene los threads y cierra los archivos abiertos
+     */
+	virtual ~FATAsyncIO();
+
+	/** open
+	 *  Solicita la apertura de un archivo. El handle puede utilizarse de inmediato en otras solicitudes
+	 *  @param filename Archivo
+	 *  @param mode Modo de apertura (w, r, a, wb...)
+	 *  @param done Callback de finalizacion
+	 *  @return Handle (>0) o <0 si no se ha podido encolar
+	 */
+	int open(const char* filename, const char* mode, Callback<void(const Result&)> done = Callback<void(const Result&)>());
+
+	/** write
+	 *  Solicita una escritura. Los datos se copian en la solicitud
+	 *  @param handle Handle del archivo
+	 *  @param data Datos
+	 *  @param len Tamanio
+	 *  @param done Callback de finalizacion
+	 *  @return 0 si se ha encolado, <0 en caso contrario
+	 */
+	int write(int handle, const void* data, size_t len, Callback<void(const Result&)> done = Callback<void(const Result&)>());
+
+	/** read
+	 *  Solicita una lectura. El buffer debe permanecer valido hasta la callback de finalizacion
+	 *  @param handle Handle del archivo
+	 *  @param data Buffer destino
+	 *  @param len Tamanio
+	 *  @param done Callback de finalizacion
+	 *  @return 0 si se ha encolado, <0 en caso contrario
+	 */
+	int read(int handle, void* data, size_t len, Callback<void(const Result&)> done);
+
+	/** close
+	 *  Solicita el cierre de un archivo. El handle queda libre al finalizar
+	 *  @param handle Handle del archivo
+	 *  @param done Callback de finalizacion
+	 *  @return 0 si se ha encolado, <0 en caso contrario
+	 */
+	int close(int handle, Callback<void(const Result&)> done = Callback<void(const Result&)>());
+
+	/** rename
+	 *  Solicita el renombrado de un archivo
+	 *  @param src Origen
+	 *  @param dest Destino
+	 *  @param done Callback de finalizacion
+	 *  @return 0 si se ha encolado, <0 en caso contrario
+	 */
+	int rename(const char* src, const char* dest, Callback<void(const Result&)> done = Callback<void(const Result&)>());
+
+	/** unlink
+	 *  Solicita la eliminacion de un archivo
+	 *  @param filename Archivo
+	 *  @param done Callback de finalizacion
+	 *  @return 0 si se ha encolado, <0 en caso contrario
+	 */
+	int unlink(const char* filename, Callback<void(const Result&)> done = Callback<void(const Result&)>());
+
+	/** drain
+	 *  Espera a que finalicen todas las solicitudes encoladas
+	 *  @param timeout_ms Tiempo maximo de espera
+	 *  @return 0 (correcto), <0 si vence el tiempo de espera
+	 */
+	int drain(uint32_t timeout_ms = osWaitForever);
+
+	/** getStats
+	 *  Obtiene las estadisticas de la cola
+	 *  @param stats Recibe las estadisticas
+	 */
+	void getStats(Stats* stats);
+
+  private:
+
+	/** Solicitud encolada */
+	struct Request{
+		OpType op;
+		int handle;
+		char name[MAX_PATH_NAME_LENGTH];
+		char dest[MAX_PATH_NAME_LENGTH];
+		char mode[4];
+		std::vector<uint8_t> wdata;
+		void* rdata;
+		size_t len;
+		uint32_t t_submit;
+		Callback<void(const Result&)> done;
+	};
+
+	/** Estado de un handle. El handle 0 agrupa las operaciones sobre el espacio de nombres */
+	struct Lane{
+		FILE* fp;
+		bool used;
+		bool busy;		/* Hay una operacion del handle en ejecucion */
+	};
+
+	/** Chequea bajo el mutex si un handle de archivo esta reservado
+	 *  @param handle Handle a chequear
+	 *  @return true si es valido y esta reservado
+	 */
+	bool _isOpen(int handle);
+
+	/** Encola una solicitud, esperando espacio si esta configurado
+	 *  @param req Solicitud
+	 *  @return 0 si se ha encolado, <0 si la cola esta llena
+	 */
+	int _submit(Request& req);
+
+	/** Ejecuta una solicitud
+	 *  @param req Solicitud
+	 *  @return Resultado de la operacion
+	 */
+	int _execute(Request& req);
+
+	/** Tarea de los threads de E/S */
+	void _task();
+
+	FATInterface* _fat;
+	std::vector<Thread*> _workers;
+	std::list<Request> _queue;
+	Mutex _mtx;
+	Semaphore _work;
+	uint16_t _queue_size;
+	uint32_t _submit_timeout_ms;
+	uint32_t _in_progress;
+	bool _stop;
+	Lane _lanes[FATAsyncIO_MAX_HANDLES + 1];
+	Stats _stats;
+};
+
+#endif /*__FATAsyncIO__H */
+
+/**** END OF FILE ****/
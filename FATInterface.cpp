@@ -8,7 +8,11 @@
  *
  */
 #include "FATInterface.h"
-#include <fstream>
+#include "FATLineIndex.h"
+#include "FATLineReader.h"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
 
 /** instancia est�tica */
 FATInterface* FATInterface::_static_instance = NULL;
@@ -24,29 +28,46 @@ static const char* _MODULE_ = "[FAT]............";
      *  @param path: path para utilizar fat
      *  @param num_files_max, numero maximo de archivos en la fat
      *  @param format: true o false, formatear la particion si error al montar
+     *  @param platform: plataforma del sistema de ficheros, NULL para la de por defecto
      */
-FATInterface::FATInterface(const char *partition_label, const char *path, int num_files_max,bool format) :  _error(0) {
-	s_wl_handle= WL_INVALID_HANDLE;
+FATInterface::FATInterface(const char *partition_label, const char *path, int num_files_max,bool format, FATPlatform* platform) :  _error(0) {
+	_own_platform = (platform == NULL);
+	_platform = (platform)? platform : FATPlatform::create();
+	MBED_ASSERT(_platform);
 	_ready = false;
 //	_mounted = false;
 
 	//memcpy(_label,partition_label,strlen(partition_label));
-	sprintf(_label,"%s",partition_label);
-	sprintf(_path,"/%s",path);
+	snprintf(_label, MAX_PATH_NAME_LENGTH, "%s",partition_label);
+	if(_platform->resolvePath(path, _path, MAX_PATH_NAME_LENGTH) != 0){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "Path demasiado largo: %s", path);
+		return;
+	}
 	DEBUG_TRACE_I(_EXPR_, _MODULE_, "Path: %s Label: %s",_path,_label);
 	//memcpy(_path,path,strlen(path));
 	_num_files_max = num_files_max;
+	_meta_max_entries = 0;
+	_meta_hits = 0;
+	_meta_misses = 0;
+	_write_gen = 0;
 
 	_defdbg = true;
 
 
+#if ESP_PLATFORM == 1
 	setLoggingLevel(ESP_LOG_INFO);
-	if(mount(format)!= ESP_OK)
+#endif
+	if(mount(format)!= 0)
 		return;
 	_static_instance = this;
 }
 FATInterface::~FATInterface(){
-	umount();
+	if(_ready){
+		umount();
+	}
+	if(_own_platform){
+		delete(_platform);
+	}
 	_static_instance = NULL;
 	_ready = false;
 }
@@ -64,9 +85,11 @@ FATInterface::~FATInterface(){
 //const char* FATInterface::getName() { return _name; }
 
 
+#if ESP_PLATFORM == 1
 void FATInterface::setLoggingLevel(esp_log_level_t level){
 	esp_log_level_set(_MODULE_, level);
 }
+#endif
 //static FATInterface* FATInterface::getStaticInstance(){
 //	return _static_instance;
 //}
@@ -77,16 +100,8 @@ void FATInterface::setLoggingLevel(esp_log_level_t level){
  * @return True: Handle abierto, False: Handle no abierto (error)
  */
 int FATInterface::mount(bool format) {
-	esp_err_t _err;
-	esp_vfs_fat_mount_config_t mount_config;
-
-	mount_config.max_files = _num_files_max;
-	mount_config.format_if_mount_failed = format;
-	mount_config.allocation_unit_size = CONFIG_WL_SECTOR_SIZE;
-
-	_err = esp_vfs_fat_spiflash_mount(_path, _label, &mount_config, &s_wl_handle);
-	if(_err != ESP_OK){
-		DEBUG_TRACE_E(_EXPR_, _MODULE_, "Error montando Fatfs path:%s , label:%s  %s",_path,_label,esp_err_to_name(_err));
+	int _err = _platform->mount(_path, _label, _num_files_max, format);
+	if(_err != 0){
 		return _err;
 	}
 	DEBUG_TRACE_I(_EXPR_, _MODULE_, "Fatfs CREADO CORRECTAMENTE");
@@ -99,11 +114,8 @@ int FATInterface::mount(bool format) {
  *
  */
 int FATInterface::umount() {
-	esp_err_t _err;
-
-	_err = esp_vfs_fat_spiflash_unmount(_path, s_wl_handle);
-	if(_err != ESP_OK){
-		DEBUG_TRACE_E(_EXPR_, _MODULE_, "OTHER ERROR %s",esp_err_to_name(_err));
+	int _err = _platform->umount(_path);
+	if(_err != 0){
 		return _err;
 	}
 	DEBUG_TRACE_I(_EXPR_, _MODULE_, "Fatfs Desmontado correctamente");
@@ -118,28 +130,56 @@ int FATInterface::umount() {
  */
 FILE * FATInterface::open(const char *filename,const char *opentype){
 	FILE *fp = NULL;
-	char* fullpath = new char[strlen(filename) + strlen(_path) + 2]();
-	MBED_ASSERT(fullpath);
-	sprintf(fullpath, "%s/%s", _path, filename);
+	char fullpath[MAX_FULL_PATH_LENGTH];
+	if(!_fullPath(fullpath, filename)){
+		return NULL;
+	}
 	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Abriendo archivo %s", fullpath);
+	STATS_TIMESTAMP(t0);
 	_mtx.lock();
+	STATS_TIMESTAMP(t1);
 	fp = fopen(fullpath, opentype);
-	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Archivo fp=%x", (uint32_t)fp);
+	if(fp && strpbrk(opentype, "wa+") != NULL){
+		_invalidateMeta(filename);
+	}
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Archivo fp=%p", fp);
+	STATS_RECORD(_stats, StatOpen, t0, t1, 0, fp == NULL);
 	_mtx.unlock();
-	delete(fullpath);
 	return fp;
 
 }
 /**
- * @brief 		funcion fclose con proteccion mutex
+ * @brief 		funcion fclose con proteccion del mutex del archivo
  * @param[in]	FILE *p: nombre archivo a cerrar
  * @return		int resultado
  */
 int FATInterface::close(FILE *stream){
 	int res = 0;
-	_mtx.lock();
+	Mutex& mtx = _streamLock(stream);
+	mtx.lock();
 	res = fclose(stream);
-	_mtx.unlock();
+	// los datos pendientes en el buffer de stdio modifican el tamanio al cerrar
+	_write_gen++;
+	mtx.unlock();
+	return res;
+}
+
+/**
+ * @brief		funcion fflush (y fsync) con proteccion del mutex del archivo
+ * @param[in]	stream: puntero FILE del archivo a volcar
+ * @param[in]	sync: true para sincronizar ademas los datos con el disco
+ * @return		int resultado
+ */
+int FATInterface::flush(FILE *stream, bool sync){
+	int res = 0;
+	Mutex& mtx = _streamLock(stream);
+	mtx.lock();
+	res = fflush(stream);
+	if(res == 0 && sync){
+		res = fsync(fileno(stream));
+	}
+	_write_gen++;
+	mtx.unlock();
 	return res;
 }
 
@@ -150,19 +190,20 @@ int FATInterface::close(FILE *stream){
  */
 int FATInterface::_unlink(const char *filename){
 	int result = 0;
-	char* fullpath = new char[strlen(filename) + strlen(_path) + 2]();
-	MBED_ASSERT(fullpath);
-	sprintf(fullpath, "%s/%s", _path, filename);
+	char fullpath[MAX_FULL_PATH_LENGTH];
+	if(!_fullPath(fullpath, filename)){
+		return -1;
+	}
 	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Eliminando archivo %s", fullpath);
 	_mtx.lock();
 	result = unlink(fullpath);
+	_invalidateMeta(filename);
 	_mtx.unlock();
-	delete(fullpath);
 	return result;
 
 }
 /**
- * @brief		funcion fwrite con proteccion mutex
+ * @brief		funcion fwrite con proteccion del mutex del archivo
  * @param[in]	data: puntero con los datos a escribir
  * @param[in]	size: tama�o de cada elemento a escribir
  * @param[in]	count: numero de elementos a escribir
@@ -171,13 +212,18 @@ int FATInterface::_unlink(const char *filename){
  */
 size_t FATInterface::write(const void *data,size_t size,size_t count,FILE*stream) {
 	size_t s;
-	_mtx.lock();
+	STATS_TIMESTAMP(t0);
+	Mutex& mtx = _streamLock(stream);
+	mtx.lock();
+	STATS_TIMESTAMP(t1);
 	s = fwrite(data,size,count,stream);
-	_mtx.unlock();
+	_write_gen++;
+	STATS_RECORD(_stats, StatWrite, t0, t1, s * size, s != count);
+	mtx.unlock();
 	return s;
 }
 /**
- * @brief		funcion fread con proteccion mutex
+ * @brief		funcion fread con proteccion del mutex del archivo
  * @param[in]	data: puntero del buffer a rellenar con los datos leidos
  * @param[in]	size: tama�o de cada elemento a leer
  * @param[in]	count: numero de elementos a leer
@@ -186,16 +232,20 @@ size_t FATInterface::write(const void *data,size_t size,size_t count,FILE*stream
  */
 size_t FATInterface::read(void *data,size_t size, size_t count,FILE *stream){
 	size_t s;
-	_mtx.lock();
+	STATS_TIMESTAMP(t0);
+	Mutex& mtx = _streamLock(stream);
+	mtx.lock();
+	STATS_TIMESTAMP(t1);
 	s = fread(data,size,count,stream);
-	_mtx.unlock();
+	STATS_RECORD(_stats, StatRead, t0, t1, s * size, s != count && ferror(stream));
+	mtx.unlock();
 	return s;
 }
 
 
 //-----------------------------------------------------------------------------------------
 /**
- * @brief		funcion fread con proteccion mutex
+ * @brief		funcion fread con proteccion del mutex del archivo
  * @param[in]	data: puntero del buffer a rellenar con los datos leidos
  * @param[in]	size: tama�o de cada elemento a leer
  * @param[in]	count: numero de elementos a leer
@@ -204,16 +254,19 @@ size_t FATInterface::read(void *data,size_t size, size_t count,FILE *stream){
  */
 size_t FATInterface::readLine(char* result, size_t max_len, FILE *stream){
 	size_t s=0;
-	_mtx.lock();
-	do{
-		int count = fread(&result[s],sizeof(char),1,stream);
-		if(count==0){
-			break;
-		}
-		s+=count;
-	}while(result[s-1] != '\n' && s < max_len);
-	result[s]=0;
-	_mtx.unlock();
+	STATS_TIMESTAMP(t0);
+	Mutex& mtx = _streamLock(stream);
+	mtx.lock();
+	STATS_TIMESTAMP(t1);
+	// fgets recorre el buffer interno de stdio en lugar de realizar un fread por byte
+	if(fgets(result, max_len + 1, stream) != NULL){
+		s = strlen(result);
+	}
+	else{
+		result[0] = 0;
+	}
+	STATS_RECORD(_stats, StatReadLine, t0, t1, s, ferror(stream));
+	mtx.unlock();
 	return s;
 }
 
@@ -221,16 +274,87 @@ size_t FATInterface::readLine(char* result, size_t max_len, FILE *stream){
 //-----------------------------------------------------------------------------------------
 size_t FATInterface::getLineCount(FILE *stream){
 	size_t s=0;
-	char result=0;
-	int count = 0;
-	_mtx.lock();
-	do{
-		count = fread(&result,sizeof(char),1,stream);
-		if(count && result == '\n'){
-			s++;
+	size_t count = 0;
+	char* block = new char[FAT_READ_BLOCK_SIZE];
+	MBED_ASSERT(block);
+	// lectura por bloques, tomando el mutex solo durante cada lectura
+	while((count = read(block, sizeof(char), FAT_READ_BLOCK_SIZE, stream)) > 0){
+		s += countNewlines(block, count);
+	}
+	delete[](block);
+	return s;
+}
+
+
+//-----------------------------------------------------------------------------------------
+size_t FATInterface::getLineCount(const char* filename){
+	FATLineIndex index(this, filename);
+	if(index.update() != 0){
+		return 0;
+	}
+	return index.getLineCount();
+}
+
+
+//-----------------------------------------------------------------------------------------
+int FATInterface::appendLines(const char* filename, const void* data, size_t len){
+	FATLineIndex index(this, filename);
+	return index.append(data, len);
+}
+
+
+//-----------------------------------------------------------------------------------------
+int FATInterface::readLines(const char* filename, size_t first, size_t count, Callback<bool(size_t, const char*, size_t)> visitor){
+	FATLineIndex index(this, filename);
+	if(index.update() != 0){
+		return -1;
+	}
+	FILE* fp = open(filename, "r");
+	if(!fp){
+		return -1;
+	}
+	int n = 0;
+	// posicionamiento desde la linea indexada mas cercana
+	if(index.seekLine(fp, first) == 0){
+		FATLineReader reader(this, fp);
+		const char* line;
+		size_t len;
+		while((size_t)n < count && reader.next(&line, &len)){
+			n++;
+			if(!visitor.call(first + n - 1, line, len)){
+				break;
+			}
 		}
-	}while(count > 0);
-	_mtx.unlock();
+	}
+	close(fp);
+	return n;
+}
+
+
+//-----------------------------------------------------------------------------------------
+size_t FATInterface::countNewlines(const void* data, size_t len){
+	const uint8_t* p = (const uint8_t*)data;
+	size_t s = 0;
+	// bytes iniciales hasta alinear a palabra
+	while(len > 0 && ((uintptr_t)p & 3) != 0){
+		s += (*p++ == '\n')? 1 : 0;
+		len--;
+	}
+	// cada palabra se compara con 0x0A0A0A0A, marcando el bit alto de cada byte coincidente
+	while(len >= 4){
+		uint32_t x;
+		memcpy(&x, p, sizeof(uint32_t));
+		x ^= 0x0A0A0A0AUL;
+		uint32_t y = (x & 0x7F7F7F7FUL) + 0x7F7F7F7FUL;
+		y = ~(y | x | 0x7F7F7F7FUL);
+		s += __builtin_popcount(y);
+		p += 4;
+		len -= 4;
+	}
+	while(len > 0){
+		s += (*p++ == '\n')? 1 : 0;
+		len--;
+	}
 	return s;
 }
 
@@ -239,9 +363,10 @@ size_t FATInterface::getLineCount(FILE *stream){
 int FATInterface::listFolder(const char* folder, std::list<const char*> *file_list){
 
 	int count = -1;
-	char* txt = new char[strlen(_path)+1+strlen(folder)+1]();
-	MBED_ASSERT(txt);
-	sprintf(txt, "%s/%s", _path, folder);
+	char txt[MAX_FULL_PATH_LENGTH];
+	if(!_fullPath(txt, folder)){
+		return -1;
+	}
 	DIR* dir = opendir(txt);
 	if(dir){
 		count = 0;
@@ -261,41 +386,180 @@ int FATInterface::listFolder(const char* folder, std::list<const char*> *file_li
 	else{
 		DEBUG_TRACE_E(_EXPR_, _MODULE_, "dir = null");
 	}
-	delete(txt);
+	return count;
+}
+
+//-----------------------------------------------------------------------------------------
+int FATInterface::forEachFile(const char* folder, Callback<bool(const FATDirEntry&)> visitor, const char* prefix, const char* ext, bool with_stat, long* cookie){
+	// un recorrido finalizado no se reinicia
+	if(cookie && *cookie == -1){
+		return 0;
+	}
+	char txt[MAX_FULL_PATH_LENGTH];
+	if(!_fullPath(txt, folder)){
+		return -1;
+	}
+	DIR* dir = opendir(txt);
+	if(!dir){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "dir = null");
+		return -1;
+	}
+	if(cookie && *cookie > 0){
+		seekdir(dir, *cookie);
+	}
+	size_t prefix_len = (prefix)? strlen(prefix) : 0;
+	size_t ext_len = (ext)? strlen(ext) : 0;
+	int count = 0;
+	bool stopped = false;
+	FATDirEntry entry;
+	struct dirent* de = NULL;
+	while(!stopped && (de = readdir(dir)) != NULL){
+		if(de->d_type != DT_REG){
+			continue;
+		}
+		size_t len = strlen(de->d_name);
+		if(len >= MAX_PATH_NAME_LENGTH){
+			DEBUG_TRACE_W(_EXPR_, _MODULE_, "Archivo %s omitido, nombre demasiado largo", de->d_name);
+			continue;
+		}
+		if(prefix_len > 0 && (len < prefix_len || strncasecmp(de->d_name, prefix, prefix_len) != 0)){
+			continue;
+		}
+		if(ext_len > 0 && (len <= ext_len || de->d_name[len - ext_len - 1] != '.' || strcasecmp(&de->d_name[len - ext_len], ext) != 0)){
+			continue;
+		}
+		memcpy(entry.name, de->d_name, len + 1);
+		entry.size = 0;
+		entry.mtime = 0;
+		if(with_stat){
+			// el path del archivo se construye sobre el del directorio
+			struct stat st;
+			size_t dir_len = strlen(txt);
+			if(dir_len + 1 + len < MAX_FULL_PATH_LENGTH){
+				txt[dir_len] = '/';
+				memcpy(&txt[dir_len + 1], de->d_name, len + 1);
+				if(stat(txt, &st) == 0){
+					entry.size = st.st_size;
+					entry.mtime = st.st_mtime;
+				}
+				txt[dir_len] = 0;
+			}
+		}
+		count++;
+		stopped = !visitor.call(entry);
+	}
+	if(cookie){
+		*cookie = (stopped)? telldir(dir) : -1;
+	}
+	closedir(dir);
 	return count;
 }
 
 //-----------------------------------------------------------------------------------------
 int FATInterface::createFolder(const char* folder){
 	int res=0;
-	char* txt = new char[strlen(_path)+1+strlen(folder)+1]();
-	MBED_ASSERT(txt);
-	sprintf(txt, "%s/%s", _path, folder);
+	char txt[MAX_FULL_PATH_LENGTH];
+	if(!_fullPath(txt, folder)){
+		return -1;
+	}
+	// operacion sobre el espacio de nombres, protegida por el mutex global
+	_mtx.lock();
 	DIR* dir = opendir(txt);
 	if(!dir){
-		int res = mkdir(txt, S_IRUSR | S_IWUSR | S_IXUSR | S_IRGRP | S_IWGRP | S_IXGRP | S_IROTH | S_IWOTH | S_IXOTH);
+		res = mkdir(txt, S_IRUSR | S_IWUSR | S_IXUSR | S_IRGRP | S_IWGRP | S_IXGRP | S_IROTH | S_IWOTH | S_IXOTH);
 	}
-	delete(txt);
+	else{
+		closedir(dir);
+	}
+	_mtx.unlock();
 	return res;
 }
 
 //-----------------------------------------------------------------------------------------
-int FATInterface::copyFile(const char* src_file, const char* dest_file, bool erase_src){
-	if(!fileExists(src_file)){
+int FATInterface::copyFile(const char* src_file, const char* dest_file, bool erase_src, void* buffer, size_t buffer_size, Callback<bool(uint32_t, uint32_t)> progress){
+	STATS_TIMESTAMP(t0);
+	char stxt[MAX_FULL_PATH_LENGTH];
+	char dtxt[MAX_FULL_PATH_LENGTH];
+	if(!_fullPath(stxt, src_file) || !_fullPath(dtxt, dest_file)){
+		STATS_RECORD(_stats, StatCopyFile, t0, t0, 0, true);
+		return -1;
+	}
+	// en la misma particion, el movimiento de un archivo es un renombrado
+	if(erase_src && fileExists(src_file)){
+		_mtx.lock();
+		// el destino solo se elimina si impide el renombrado (FAT no sobrescribe un archivo existente)
+		int err = rename(stxt, dtxt);
+		if(err != 0 && errno == EEXIST && remove(dtxt) == 0){
+			err = rename(stxt, dtxt);
+		}
+		_invalidateMeta(src_file);
+		_invalidateMeta(dest_file);
+		_mtx.unlock();
+		if(err == 0){
+			STATS_RECORD(_stats, StatCopyFile, t0, t0, 0, false);
+			return 0;
+		}
+	}
+	FILE* src = open(src_file, "rb");
+	if(!src){
+		STATS_RECORD(_stats, StatCopyFile, t0, t0, 0, true);
+		return -1;
+	}
+	FILE* dest = open(dest_file, "wb");
+	if(!dest){
+		close(src);
+		STATS_RECORD(_stats, StatCopyFile, t0, t0, 0, true);
 		return -1;
 	}
-	char* stxt = new char[strlen(_path)+1+strlen(src_file)+1]();
-	MBED_ASSERT(stxt);
-	sprintf(stxt, "%s/%s", _path, src_file);
-	char* dtxt = new char[strlen(_path)+1+strlen(dest_file)+1]();
-	MBED_ASSERT(dtxt);
-	sprintf(dtxt, "%s/%s", _path, dest_file);
-
-	std::ifstream srce( stxt, std::ios::binary );
-	std::ofstream dest( dtxt, std::ios::binary );
-	dest << srce.rdbuf();
-	delete(dtxt);
-	delete(stxt);
+	// transferencias de sectores completos, sin el buffer intermedio de stdio
+	setvbuf(src, NULL, _IONBF, 0);
+	setvbuf(dest, NULL, _IONBF, 0);
+	uint8_t* block = (uint8_t*)buffer;
+	if(!block || buffer_size == 0){
+		buffer_size = FAT_COPY_BLOCK_SIZE;
+		block = new uint8_t[buffer_size];
+		MBED_ASSERT(block);
+	}
+	else if(buffer_size >= FAT_SECTOR_SIZE){
+		buffer_size -= (buffer_size % FAT_SECTOR_SIZE);
+	}
+	fseek(src, 0, SEEK_END);
+	uint32_t total = ftell(src);
+	fseek(src, 0, SEEK_SET);
+	uint32_t copied = 0;
+	int res = 0;
+	size_t count;
+	while(res == 0 && (count = read(block, sizeof(uint8_t), buffer_size, src)) > 0){
+		if(write(block, sizeof(uint8_t), count, dest) != count){
+			DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_WRITE, Error copiando %s en %s", src_file, dest_file);
+			res = -1;
+			break;
+		}
+		copied += count;
+		if(progress && !progress.call(copied, total)){
+			DEBUG_TRACE_W(_EXPR_, _MODULE_, "Copia de %s cancelada", src_file);
+			res = -2;
+		}
+	}
+	if(block != buffer){
+		delete[](block);
+	}
+	if(res == 0 && (copied != total || ftell(dest) != (long)total)){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_LENGTH, Copiados %d de %d bytes", copied, total);
+		res = -1;
+	}
+	close(src);
+	if(close(dest) != 0 && res == 0){
+		res = -1;
+	}
+	STATS_RECORD(_stats, StatCopyFile, t0, t0, copied, res != 0);
+	if(res != 0){
+		_mtx.lock();
+		remove(dtxt);
+		_invalidateMeta(dest_file);
+		_mtx.unlock();
+		return res;
+	}
 	if(!erase_src)
 		return 0;
 	return eraseFile(src_file);
@@ -312,34 +576,52 @@ int FATInterface::renameFile(const char* src_file, const char* dest_file){
 		DEBUG_TRACE_E(_EXPR_, _MODULE_, "Archivo dst no existe %s",dest_file);
 		return -1;
 	}
-	char* stxt = new char[strlen(_path)+1+strlen(src_file)+1]();
-	MBED_ASSERT(stxt);
-	sprintf(stxt, "%s/%s", _path, src_file);
-	char* dtxt = new char[strlen(_path)+1+strlen(dest_file)+1]();
-	MBED_ASSERT(dtxt);
-	sprintf(dtxt, "%s/%s", _path, dest_file);
-
-	return rename(stxt, dtxt);
+	char stxt[MAX_FULL_PATH_LENGTH];
+	char dtxt[MAX_FULL_PATH_LENGTH];
+	if(!_fullPath(stxt, src_file) || !_fullPath(dtxt, dest_file)){
+		return -1;
+	}
+	_mtx.lock();
+	int res = rename(stxt, dtxt);
+	_invalidateMeta(src_file);
+	_invalidateMeta(dest_file);
+	_mtx.unlock();
+	return res;
 }
 
 //-----------------------------------------------------------------------------------------
 int FATInterface::eraseFile(const char* f){
-	char* stxt = new char[strlen(_path)+1+strlen(f)+1]();
-	MBED_ASSERT(stxt);
-	sprintf(stxt, "%s/%s", _path, f);
+	char stxt[MAX_FULL_PATH_LENGTH];
+	if(!_fullPath(stxt, f)){
+		return -1;
+	}
+	_mtx.lock();
 	int res = remove(stxt);
-	delete(stxt);
+	_invalidateMeta(f);
+	_mtx.unlock();
 	return res;
 }
 
 //-----------------------------------------------------------------------------------------
 bool FATInterface::fileExists(const char* f){
-	FILE* ptr = open(f, "r");
-	if(ptr){
-		close(ptr);
-		return true;
-	}
-	return false;
+	return _fileInfo(f, NULL);
+}
+
+//-----------------------------------------------------------------------------------------
+int32_t FATInterface::getFileSize(const char* f){
+	int32_t size = -1;
+	_fileInfo(f, &size);
+	return size;
+}
+
+//-----------------------------------------------------------------------------------------
+void FATInterface::setMetadataCache(uint16_t max_entries){
+	_mtx.lock();
+	_meta_max_entries = max_entries;
+	_meta_cache.clear();
+	_meta_hits = 0;
+	_meta_misses = 0;
+	_mtx.unlock();
 }
 
 //-----------------------------------------------------------------------------------------
@@ -347,31 +629,96 @@ bool FATInterface::format(){
 	//formateamos la particion FAT
 	bool res = true;
 	_mtx.lock();
-	esp_partition_iterator_t fat_ite = esp_partition_find(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_FAT, NULL);
-	if(fat_ite != NULL){
-		const esp_partition_t* part = esp_partition_get(fat_ite);
-		DEBUG_TRACE_I(_EXPR_,_MODULE_,"Inicio Formateamos FAT!!!!!!!!")
-		DEBUG_TRACE_I(_EXPR_,_MODULE_,"Type: %d", (uint32_t)part->type);
-		DEBUG_TRACE_I(_EXPR_,_MODULE_,"SubType: %d", (uint32_t)part->subtype);
-		DEBUG_TRACE_I(_EXPR_,_MODULE_,"Address: 0x%x", part->address);
-		DEBUG_TRACE_I(_EXPR_,_MODULE_,"Size: 0x%x", part->size);
-		DEBUG_TRACE_I(_EXPR_,_MODULE_,"Label: %d", (uint8_t)part->label);
-		DEBUG_TRACE_I(_EXPR_,_MODULE_,"Encrypted: %d", (uint8_t)part->encrypted);
-
-		esp_err_t err = esp_partition_erase_range(part,0, part->size);
-		if(err != ESP_OK){
-			DEBUG_TRACE_I(_EXPR_,_MODULE_,"Error formateando partition: %d",(int)err);
-			res = false;
+	res = _platform->format(_path, _label);
+	_mtx.unlock();
+	return res;
+}
+
+//-----------------------------------------------------------------------------------------
+bool FATInterface::_fullPath(char (&fullpath)[MAX_FULL_PATH_LENGTH], const char* name){
+	int len = snprintf(fullpath, MAX_FULL_PATH_LENGTH, "%s/%s", _path, name);
+	if(len < 0 || len >= MAX_FULL_PATH_LENGTH){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_PATH, Path demasiado largo para %s", name);
+		fullpath[0] = 0;
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------
+bool FATInterface::_fileInfo(const char* name, int32_t* size){
+	bool exists = false;
+	_mtx.lock();
+	// la existencia cacheada es valida siempre; el tamanio, solo si no ha habido escrituras posteriores
+	for(auto it = _meta_cache.begin(); it != _meta_cache.end(); ++it){
+		if(strcmp(it->name, name) == 0){
+			if(!size || !it->exists || it->write_gen == _write_gen){
+				_meta_hits++;
+				exists = it->exists;
+				if(size){
+					*size = (exists)? it->size : -1;
+				}
+				_meta_cache.splice(_meta_cache.begin(), _meta_cache, it);
+				_mtx.unlock();
+				return exists;
+			}
+			_meta_cache.erase(it);
+			break;
 		}
-		else{
-			DEBUG_TRACE_I(_EXPR_,_MODULE_,"Fin Formateamos FAT!!!!!!!!");
-			esp_partition_iterator_release(fat_ite);
+	}
+	char fullpath[MAX_FULL_PATH_LENGTH];
+	struct stat st;
+	int32_t len = -1;
+	if(_fullPath(fullpath, name) && stat(fullpath, &st) == 0 && !S_ISDIR(st.st_mode)){
+		exists = true;
+		len = st.st_size;
+	}
+	if(size){
+		*size = len;
+	}
+	if(_meta_max_entries > 0 && strlen(name) < MAX_FULL_PATH_LENGTH){
+		_meta_misses++;
+		if(_meta_cache.size() >= _meta_max_entries){
+			_meta_cache.pop_back();
 		}
+		_meta_cache.emplace_front();
+		CachedFile& entry = _meta_cache.front();
+		strcpy(entry.name, name);
+		entry.exists = exists;
+		entry.size = len;
+		entry.write_gen = _write_gen;
 	}
-	else{
-		DEBUG_TRACE_E(_EXPR_,_MODULE_,"Particion FAT no encontrada!!!!");
-		res = false;
+	_mtx.unlock();
+	return exists;
+}
+
+//-----------------------------------------------------------------------------------------
+void FATInterface::_invalidateMeta(const char* name){
+	if(_meta_max_entries == 0){
+		return;
+	}
+	_mtx.lock();
+	for(auto it = _meta_cache.begin(); it != _meta_cache.end(); ++it){
+		if(strcmp(it->name, name) == 0){
+			_meta_cache.erase(it);
+			break;
+		}
 	}
 	_mtx.unlock();
-	return res;
+}
+
+//-----------------------------------------------------------------------------------------
+void FATInterface::getStats(StorageOpStats* stats){
+	#if StorageStats_ENABLED == 1
+	_stats.snapshot(stats);
+	#else
+	memset(stats, 0, StatCount * sizeof(StorageOpStats));
+	#endif
+}
+
+//-----------------------------------------------------------------------------------------
+void FATInterface::resetStats(){
+	#if StorageStats_ENABLED == 1
+	_stats.reset();
+	#endif
 }
@@ -12,27 +12,47 @@
 #define __FATInterface__H
 
 #include "mbed.h"
-#if ESP_PLATFORM == 1
-#include "esp_vfs_fat.h"
-#endif
+#include "FATPlatform.h"
+#include "StorageStats.h"
 #include <list>
+#include <atomic>
 #include <dirent.h>
 
 #define DEFAULT_FATInterface_Partition	(const char*)"fat_stm32"
 #define MAX_PATH_NAME_LENGTH		50		//Longitud maxima para el path raiz de la particion FAT y partition_label del partition_table
+#define FAT_COPY_BLOCK_SIZE			FAT_SECTOR_SIZE	//Tamanio de transferencia por defecto en la copia de archivos
+#define FAT_STREAM_LOCK_STRIPES		8		//Numero de mutex de acceso a archivos abiertos (read, write, readLine, close)
+#define MAX_FULL_PATH_LENGTH		(2 * MAX_PATH_NAME_LENGTH)	//Longitud maxima del path absoluto (raiz + nombre relativo)
+#define FAT_READ_BLOCK_SIZE			4096	//Tamanio de bloque para lecturas secuenciales (recuento e indexado de lineas)
 
 
 
 class FATInterface{
   public:
 
+    /** FATDirEntry
+     *  Informacion de un archivo de un directorio, obtenida en <forEachFile>
+     */
+    struct FATDirEntry{
+    	char name[MAX_PATH_NAME_LENGTH];	/// Nombre del archivo
+    	uint32_t size;						/// Tamanio en bytes (0 si no se solicita)
+    	time_t mtime;						/// Fecha de ultima modificacion (0 si no se solicita)
+    };
+
 //    struct FATInfo{
 //    	char path[MAX_PATH_NAME_LENGTH];
 //    	char partition_lable[MAX_PATH_NAME_LENGTH];
 //    	bool mounted;
 //    };
 
-    FATInterface(const char *partition_label, const char *path, int num_files_max,bool format);
+    /** Constructor
+     *  @param partition_label Nombre de la particion
+     *  @param path Path raiz de la particion
+     *  @param num_files_max Numero maximo de archivos abiertos
+     *  @param format Flag para formatear si falla el montaje
+     *  @param platform Plataforma del sistema de ficheros (NULL para la de por defecto, FATPlatform::create)
+     */
+    FATInterface(const char *partition_label, const char *path, int num_files_max,bool format, FATPlatform* platform = NULL);
     virtual ~FATInterface();
 
     static FATInterface* getStaticInstance(){ return _static_instance; }
@@ -40,7 +60,9 @@ class FATInterface{
     //const char* getName(){return _name;};
     //bool isMounted(){return _mounted;};
 
+#if ESP_PLATFORM == 1
     void setLoggingLevel(esp_log_level_t level);
+#endif
     int mount(bool format);
     int umount();
     FILE * open(const char *filename,const char *opentype);
@@ -52,13 +74,80 @@ class FATInterface{
     size_t getLineCount(FILE *stream);
 
     /**
-     * Lista los archivos de un directorio y los devuelve como una lista de nombres
+     * Vuelca el buffer de stdio de un archivo abierto y, opcionalmente, sincroniza sus datos con el disco (fsync).
+     * Debe utilizarse en lugar de fflush para que los tamanios de la cache de metadatos se mantengan coherentes
+     * @param stream Archivo
+     * @param sync Flag para realizar ademas fsync
+     * @return 0 (correcto), <0 (codigo de error)
+     */
+    int flush(FILE *stream, bool sync = false);
+
+    /**
+     * Obtiene el numero de lineas de un archivo mediante su indice de lineas (archivo auxiliar <file>.lix). Si el
+     * archivo se escribe con <appendLines> el indice ya esta actualizado y la consulta tiene coste constante; los datos
+     * escritos por otras vias se indexan en la consulta
+     * @param filename Archivo
+     * @return Numero de lineas (fines de linea '\n')
+     */
+    size_t getLineCount(const char* filename);
+
+    /**
+     * Aniade datos al final de un archivo de texto y actualiza su indice de lineas con los datos escritos, sin volver
+     * a leer el archivo
+     * @param filename Archivo
+     * @param data Datos a aniadir
+     * @param len Tamanio de los datos
+     * @return 0 (correcto), <0 (codigo de error)
+     */
+    int appendLines(const char* filename, const void* data, size_t len);
+
+    /**
+     * Lee un rango de lineas de un archivo, posicionandose mediante su indice de lineas (archivo auxiliar <file>.lix)
+     * sin recorrer el archivo desde el inicio. Cada linea se entrega sin fin de linea ni terminador, como referencia al
+     * buffer de lectura valida solo durante la llamada, sin reservas de memoria por linea. Las lineas mas largas que
+     * FATLineReader_DEFAULT_BLOCK_SIZE se entregan truncadas a ese tamanio, manteniendo la numeracion de lineas.
+     * @param filename Archivo
+     * @param first Primera linea a leer (0..N)
+     * @param count Numero maximo de lineas a leer
+     * @param visitor Callback invocada con el numero, el contenido y la longitud de cada linea. Si devuelve false se
+     * 		  detiene la lectura
+     * @return Numero de lineas leidas, <0 en caso de error
+     */
+    int readLines(const char* filename, size_t first, size_t count, Callback<bool(size_t, const char*, size_t)> visitor);
+
+    /**
+     * Cuenta los fines de linea '\n' de un buffer, procesando una palabra de 32 bits por iteracion
+     * @param data Buffer
+     * @param len Tamanio del buffer
+     * @return Numero de fines de linea
+     */
+    static size_t countNewlines(const void* data, size_t len);
+
+    /**
+     * Lista los archivos de un directorio y los devuelve como una lista de nombres. Cada nombre se reserva en memoria
+     * y debe liberarse por el llamante. En directorios grandes es preferible <forEachFile>
      * @param folder Directorio en el que buscar
      * @param file_list Lista a rellenar con los nombres de archivo encontrados
      * @return Nmero de archivos encontrados
      */
     int listFolder(const char* folder, std::list<const char*> *file_list);
 
+    /**
+     * Recorre los archivos de un directorio en una unica pasada, filtrando por prefijo y extension. La informacion de
+     * cada archivo se entrega en una estructura reutilizada, sin reservas de memoria por entrada. Los archivos cuyo
+     * nombre no cabe en FATDirEntry::name se omiten.
+     * @param folder Directorio a recorrer
+     * @param visitor Callback invocada por cada archivo. Si devuelve false se detiene el recorrido
+     * @param prefix Prefijo del nombre (NULL o "" para todos)
+     * @param ext Extension del nombre, sin punto (NULL o "" para todas)
+     * @param with_stat Flag para obtener tamanio y fecha de cada archivo (requiere una consulta adicional por archivo)
+     * @param cookie Posicion de inicio del recorrido (NULL o 0 para el inicio). Si el recorrido se detiene, recibe
+     * 		  la posicion desde la que continuarlo en una llamada posterior; si finaliza, recibe -1, y una llamada
+     * 		  posterior con -1 devuelve 0 sin visitar ningun archivo
+     * @return Numero de archivos visitados o <0 si hay error
+     */
+    int forEachFile(const char* folder, Callback<bool(const FATDirEntry&)> visitor, const char* prefix = NULL, const char* ext = NULL, bool with_stat = true, long* cookie = NULL);
+
     /**
      * Crea un directorio en disco
      * @param folder Directorio a crear
@@ -73,7 +162,24 @@ class FATInterface{
      * @param erase_src Flag para borrar o no el archivo origen
      * @return 0=OK
      */
-    int copyFile(const char* src, const char* dest, bool erase_src);
+    int copyFile(const char* src, const char* dest, bool erase_src){
+    	return copyFile(src, dest, erase_src, NULL, 0);
+    }
+
+    /**
+     * Copia un fichero en otro mediante transferencias de tamanio multiplo del sector. Si se borra el archivo origen,
+     * la operacion se resuelve como un renombrado sin copiar datos. Al finalizar se verifica que el destino tiene la
+     * longitud del origen; si la copia falla o se cancela, el archivo destino se elimina.
+     * @param src Origen
+     * @param dest Destino
+     * @param erase_src Flag para borrar o no el archivo origen
+     * @param buffer Buffer de transferencia alineado a 4 bytes (NULL para reservar uno de FAT_COPY_BLOCK_SIZE)
+     * @param buffer_size Tamanio del buffer. Se ajusta al multiplo de FAT_SECTOR_SIZE inferior
+     * @param progress Callback opcional invocada tras cada transferencia con los bytes copiados y el total. Si
+     * 		  devuelve false se cancela la copia
+     * @return 0=OK, -1=Error, -2=Cancelada
+     */
+    int copyFile(const char* src, const char* dest, bool erase_src, void* buffer, size_t buffer_size, Callback<bool(uint32_t, uint32_t)> progress = Callback<bool(uint32_t, uint32_t)>());
 
     /**
 	* Renombra un fichero
@@ -91,12 +197,34 @@ class FATInterface{
     int eraseFile(const char* file);
 
     /**
-     * Chequea si el archivo existe
+     * Chequea si el archivo existe, consultando sus metadatos sin abrirlo
      * @param file Archivo
      * @return true, false
      */
     bool fileExists(const char* file);
 
+    /**
+     * Obtiene el tamanio de un archivo consultando sus metadatos
+     * @param file Archivo
+     * @return Tamanio en bytes, -1 si no existe
+     */
+    int32_t getFileSize(const char* file);
+
+    /**
+     * Configura la cache LRU de metadatos situada delante de <fileExists> y <getFileSize>. La existencia de un archivo
+     * se mantiene coherente con las operaciones realizadas a traves de FATInterface (open, _unlink, eraseFile,
+     * renameFile, copyFile). El tamanio cacheado se descarta tras cualquier escritura, volcado (flush) o cierre.
+     * @param max_entries Numero maximo de archivos en cache. Con 0 se desactiva la cache
+     */
+    void setMetadataCache(uint16_t max_entries);
+
+    /**
+     * Obtiene las estadisticas de la cache de metadatos
+     * @param hits Recibe el numero de consultas servidas desde la cache
+     * @param misses Recibe el numero de consultas que han requerido acceso al sistema de ficheros
+     */
+    void getMetadataCacheStats(uint32_t* hits, uint32_t* misses) { *hits = _meta_hits; *misses = _meta_misses; }
+
     char * Get_Fat_path(){return _path;};
     char * Get_Fat_label(){return _label;};
 
@@ -106,6 +234,30 @@ class FATInterface{
      * */
     bool format();
 
+    /**
+     * Operaciones instrumentadas en getStats
+     */
+    enum StatOp{
+    	StatOpen,
+    	StatRead,
+    	StatWrite,
+    	StatReadLine,
+    	StatCopyFile,
+    	StatCount
+    };
+
+    /**
+     * Obtiene las estadisticas de cada operacion: invocaciones, bytes, errores e histogramas de latencia de
+     * espera del mutex y de E/S. Si la instrumentacion esta desactivada (StorageStats_ENABLED=0) se devuelven a cero
+     * @param stats Array de StatCount elementos que recibe las estadisticas, indexado por StatOp
+     */
+    void getStats(StorageOpStats* stats);
+
+    /**
+     * Reinicia las estadisticas de las operaciones
+     */
+    void resetStats();
+
   protected:
 
     //const char* _name;          /* Nombre del sistema de ficheros */
@@ -113,8 +265,10 @@ class FATInterface{
     bool _ready;
 
     bool _defdbg;
-    Mutex _mtx;					/* Mutex de acceso al sistema FAT */
-    wl_handle_t s_wl_handle;	/* Weat levelling handle */
+    Mutex _mtx;					/* Mutex de operaciones sobre el espacio de nombres (open, unlink, rename...) */
+    Mutex _stream_mtx[FAT_STREAM_LOCK_STRIPES];	/* Mutex de acceso a archivos abiertos, seleccionado por FILE* */
+    FATPlatform* _platform;		/* Plataforma que monta, desmonta y formatea la particion */
+    bool _own_platform;			/* Flag para liberar la plataforma en el destructor */
 
     char _path[MAX_PATH_NAME_LENGTH];
 	char _label[MAX_PATH_NAME_LENGTH];
@@ -123,6 +277,64 @@ class FATInterface{
 
 	static FATInterface* _static_instance;
 
+	/**
+	 * Construye en el buffer del llamante el path absoluto de un archivo o directorio de la particion
+	 * @param fullpath Buffer destino
+	 * @param name Nombre relativo a la raiz de la particion
+	 * @return true si el path cabe en el buffer, false si excede MAX_FULL_PATH_LENGTH
+	 */
+	bool _fullPath(char (&fullpath)[MAX_FULL_PATH_LENGTH], const char* name);
+
+	/** Entrada de la cache de metadatos */
+	struct CachedFile{
+		char name[MAX_FULL_PATH_LENGTH];
+		bool exists;
+		int32_t size;
+		uint32_t write_gen;		/* Generacion de escritura en la que se obtuvo el tamanio */
+	};
+
+	/** Cache de metadatos ordenada de mas a menos reciente */
+	std::list<CachedFile> _meta_cache;
+
+	/** Numero maximo de archivos en la cache de metadatos */
+	uint16_t _meta_max_entries;
+
+	/** Estadisticas de la cache de metadatos */
+	uint32_t _meta_hits;
+	uint32_t _meta_misses;
+
+	/** Contador de escrituras, invalida los tamanios cacheados */
+	std::atomic<uint32_t> _write_gen;
+
+	/**
+	 * Obtiene el mutex que protege un archivo abierto. Las operaciones sobre archivos distintos solo se bloquean
+	 * entre si cuando comparten mutex
+	 * @param stream Archivo abierto
+	 * @return Mutex asociado
+	 */
+	Mutex& _streamLock(FILE* stream){
+		uintptr_t h = (uintptr_t)stream;
+		return _stream_mtx[((h >> 4) ^ (h >> 9)) % FAT_STREAM_LOCK_STRIPES];
+	}
+
+	/**
+	 * Obtiene la existencia y el tamanio de un archivo, desde la cache de metadatos o mediante stat
+	 * @param name Archivo
+	 * @param size Recibe el tamanio (NULL si no se necesita)
+	 * @return true si el archivo existe
+	 */
+	bool _fileInfo(const char* name, int32_t* size);
+
+	/**
+	 * Elimina un archivo de la cache de metadatos
+	 * @param name Archivo
+	 */
+	void _invalidateMeta(const char* name);
+
+	#if StorageStats_ENABLED == 1
+	StorageStats<StatCount> _stats;	/* Estadisticas de las operaciones */
+	#endif
+
 
 };
      
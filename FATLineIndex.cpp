@@ -0,0 +1,220 @@
+/*
+ * FATLineIndex.cpp
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ */
+
+#include "FATLineIndex.h"
+
+
+//------------------------------------------------------------------------------------
+//--- PRIVATE TYPES ------------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+static const char* _MODULE_ = "[LineIndex].....";
+#define _EXPR_	(!IS_ISR())
+
+
+//------------------------------------------------------------------------------------
+//-- PUBLIC METHODS IMPLEMENTATION ---------------------------------------------------
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+FATLineIndex::FATLineIndex(FATInterface* fat, const char* filename, uint16_t stride) : _fat(fat), _stride(stride), _loaded(false) {
+	snprintf(_file, MAX_PATH_NAME_LENGTH, "%s", filename);
+	snprintf(_idx_file, MAX_PATH_NAME_LENGTH, "%s.lix", filename);
+	_reset();
+}
+
+
+//------------------------------------------------------------------------------------
+int FATLineIndex::update(){
+	if(!_loaded){
+		if(!_load()){
+			_reset();
+		}
+		_loaded = true;
+	}
+	FILE* fp = _fat->open(_file, "rb");
+	if(!fp){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_OPEN, No se puede abrir %s", _file);
+		return -1;
+	}
+	fseek(fp, 0, SEEK_END);
+	uint32_t size = ftell(fp);
+	if(size < _hdr.indexed_bytes || (_hdr.indexed_bytes > 0 && _tailCrc(fp, _hdr.indexed_bytes) != _hdr.tail_crc)){
+		DEBUG_TRACE_W(_EXPR_, _MODULE_, "Archivo %s modificado, reconstruyendo indice", _file);
+		_reset();
+	}
+	if(size == _hdr.indexed_bytes){
+		_fat->close(fp);
+		return 0;
+	}
+	// Se recorren solo los datos aniadidos desde la ultima actualizacion
+	uint32_t first = _checkpoints.size();
+	char* block = new char[FAT_READ_BLOCK_SIZE];
+	MBED_ASSERT(block);
+	fseek(fp, _hdr.indexed_bytes, SEEK_SET);
+	size_t count;
+	while(_hdr.indexed_bytes < size && (count = _fat->read(block, sizeof(char), FAT_READ_BLOCK_SIZE, fp)) > 0){
+		_scan(block, count);
+	}
+	delete[](block);
+	_hdr.tail_crc = _tailCrc(fp, _hdr.indexed_bytes);
+	_fat->close(fp);
+	return _persist(first);
+}
+
+
+//------------------------------------------------------------------------------------
+int FATLineIndex::append(const void* data, size_t len){
+	// el indice debe cubrir el archivo completo antes de aniadir
+	if(update() != 0){
+		return -1;
+	}
+	FILE* fp = _fat->open(_file, "a+b");
+	if(!fp){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_OPEN, No se puede abrir %s", _file);
+		return -1;
+	}
+	if(_fat->write(data, sizeof(char), len, fp) != len || _fat->flush(fp) != 0){
+		// el indice se completara en la siguiente actualizacion
+		_fat->close(fp);
+		return -1;
+	}
+	uint32_t first = _checkpoints.size();
+	_scan((const char*)data, len);
+	_hdr.tail_crc = _tailCrc(fp, _hdr.indexed_bytes);
+	_fat->close(fp);
+	return _persist(first);
+}
+
+
+//------------------------------------------------------------------------------------
+int FATLineIndex::seekLine(FILE* stream, size_t line){
+	if(line > _hdr.line_count){
+		return -1;
+	}
+	size_t cp = line / _stride;
+	uint32_t offset = (cp == 0)? 0 : _checkpoints[cp - 1];
+	size_t pending = line - (cp * _stride);
+	fseek(stream, offset, SEEK_SET);
+	if(pending == 0){
+		return 0;
+	}
+	// Se avanza desde la linea indexada hasta la solicitada
+	char* block = new char[FAT_READ_BLOCK_SIZE];
+	MBED_ASSERT(block);
+	size_t count;
+	int result = -1;
+	while(result != 0 && (count = _fat->read(block, sizeof(char), FAT_READ_BLOCK_SIZE, stream)) > 0){
+		const char* p = block;
+		const char* end = block + count;
+		while((p = (const char*)memchr(p, '\n', end - p)) != NULL){
+			p++;
+			if(--pending == 0){
+				fseek(stream, offset + (p - block), SEEK_SET);
+				result = 0;
+				break;
+			}
+		}
+		offset += count;
+	}
+	delete[](block);
+	return result;
+}
+
+
+//------------------------------------------------------------------------------------
+//-- PRIVATE METHODS IMPLEMENTATION --------------------------------------------------
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+bool FATLineIndex::_load(){
+	FILE* fp = _fat->open(_idx_file, "rb");
+	if(!fp){
+		return false;
+	}
+	bool valid = (_fat->read(&_hdr, sizeof(Header), 1, fp) == 1 && _hdr.magic == IndexMagic && _hdr.version == IndexVersion && _hdr.stride == _stride);
+	if(valid){
+		_checkpoints.resize(_hdr.num_checkpoints);
+		valid = (_hdr.num_checkpoints == 0 || _fat->read(_checkpoints.data(), sizeof(uint32_t), _hdr.num_checkpoints, fp) == _hdr.num_checkpoints);
+	}
+	_fat->close(fp);
+	return valid;
+}
+
+
+//------------------------------------------------------------------------------------
+int FATLineIndex::_persist(uint32_t first){
+	FILE* fp = _fat->open(_idx_file, "r+b");
+	if(!fp){
+		fp = _fat->open(_idx_file, "w+b");
+		first = 0;
+	}
+	if(!fp){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_OPEN, No se puede crear el indice %s", _idx_file);
+		return -1;
+	}
+	// Se reescribe la cabecera y se aniaden solo las lineas indexadas nuevas
+	int err = (_fat->write(&_hdr, sizeof(Header), 1, fp) == 1)? 0 : -1;
+	uint32_t pending = _checkpoints.size() - first;
+	if(err == 0 && pending > 0){
+		fseek(fp, sizeof(Header) + first * sizeof(uint32_t), SEEK_SET);
+		err = (_fat->write(&_checkpoints[first], sizeof(uint32_t), pending, fp) == pending)? 0 : -1;
+	}
+	_fat->close(fp);
+	return err;
+}
+
+
+//------------------------------------------------------------------------------------
+void FATLineIndex::_scan(const char* block, size_t count){
+	size_t lines = FATInterface::countNewlines(block, count);
+	uint32_t next_checkpoint = (_checkpoints.size() + 1) * _stride;
+	if(_hdr.line_count + lines < next_checkpoint){
+		_hdr.line_count += lines;
+	}
+	else{
+		// el bloque contiene alguna linea indexada, se localizan sus fines de linea
+		const char* p = block;
+		const char* end = block + count;
+		while((p = (const char*)memchr(p, '\n', end - p)) != NULL){
+			p++;
+			_hdr.line_count++;
+			if((_hdr.line_count % _stride) == 0){
+				_checkpoints.push_back(_hdr.indexed_bytes + (p - block));
+			}
+		}
+	}
+	_hdr.indexed_bytes += count;
+	_hdr.num_checkpoints = _checkpoints.size();
+}
+
+
+//------------------------------------------------------------------------------------
+uint32_t FATLineIndex::_tailCrc(FILE* stream, uint32_t end){
+	uint8_t tail[FATLineIndex_TAIL_SIZE];
+	uint32_t len = (end < FATLineIndex_TAIL_SIZE)? end : FATLineIndex_TAIL_SIZE;
+	fseek(stream, end - len, SEEK_SET);
+	if(_fat->read(tail, sizeof(uint8_t), len, stream) != len){
+		return 0;
+	}
+	return FATPlatform::crc32(0, tail, len);
+}
+
+
+//------------------------------------------------------------------------------------
+void FATLineIndex::_reset(){
+	_hdr.magic = IndexMagic;
+	_hdr.version = IndexVersion;
+	_hdr.stride = _stride;
+	_hdr.indexed_bytes = 0;
+	_hdr.line_count = 0;
+	_hdr.num_checkpoints = 0;
+	_hdr.tail_crc = 0;
+	_checkpoints.clear();
+}
+
+/**** END OF FILE ****/
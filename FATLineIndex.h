@@ -0,0 +1,123 @@
+/*
+ * FATLineIndex.h
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ *
+ *	FATLineIndex mantiene un indice de lineas de un archivo de texto en un archivo auxiliar <file>.lix. El indice
+ *  registra el numero de lineas, los bytes ya indexados y la posicion de inicio de cada linea multiplo de <stride>.
+ *  Las escrituras realizadas con <append> actualizan el indice con los datos escritos, de forma que el recuento de
+ *  lineas es de coste constante y el posicionamiento en la linea N requiere recorrer como mucho <stride> lineas. Los
+ *  datos aniadidos por otras vias se indexan en <update>, recorriendo solo el final del archivo.
+ */
+
+#ifndef __FATLineIndex__H
+#define __FATLineIndex__H
+
+#include "mbed.h"
+#include "FATInterface.h"
+#include <vector>
+
+
+/** Separacion por defecto entre lineas indexadas */
+#define FATLineIndex_DEFAULT_STRIDE		256
+
+/** Bytes finales de la zona indexada que se verifican para detectar que el archivo ha sido reescrito */
+#define FATLineIndex_TAIL_SIZE			32
+
+
+class FATLineIndex{
+  public:
+
+    /** Constructor
+     *  @param fat Particion FAT
+     *  @param filename Archivo a indexar
+     *  @param stride Separacion entre lineas indexadas
+     */
+	FATLineIndex(FATInterface* fat, const char* filename, uint16_t stride = FATLineIndex_DEFAULT_STRIDE);
+	virtual ~FATLineIndex(){}
+
+	/** update
+	 *  Carga el indice persistido y lo extiende con los datos aniadidos al archivo desde la ultima actualizacion.
+	 *  Si el archivo ha encogido o su contenido indexado ha cambiado, el indice se reconstruye por completo.
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int update();
+
+	/** append
+	 *  Aniade datos al final del archivo e indexa los datos escritos, persistiendo el indice
+	 *  @param data Datos a aniadir
+	 *  @param len Tamanio de los datos
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int append(const void* data, size_t len);
+
+	/** getLineCount
+	 *  Obtiene el numero de fines de linea del archivo en la ultima actualizacion
+	 *  @return Numero de lineas
+	 */
+	size_t getLineCount() { return _hdr.line_count; }
+
+	/** seekLine
+	 *  Posiciona un archivo abierto al inicio de la linea indicada, partiendo de la linea indexada mas cercana
+	 *  @param stream Archivo abierto con FATInterface::open
+	 *  @param line Linea (0..N)
+	 *  @return 0 (correcto), <0 si la linea no existe
+	 */
+	int seekLine(FILE* stream, size_t line);
+
+  protected:
+
+	/** Cabecera del archivo de indice */
+	struct Header{
+		uint32_t magic;
+		uint16_t version;
+		uint16_t stride;
+		uint32_t indexed_bytes;
+		uint32_t line_count;
+		uint32_t num_checkpoints;
+		uint32_t tail_crc;
+	};
+
+	static const uint32_t IndexMagic = 0x58494C46;	// "FLIX"
+	static const uint16_t IndexVersion = 2;
+
+	/** Carga el indice persistido
+	 *  @return true si el indice es valido
+	 */
+	bool _load();
+
+	/** Persiste la cabecera y las lineas indexadas a partir de la indicada
+	 *  @param first Primera linea indexada nueva
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int _persist(uint32_t first);
+
+	/** Indexa un bloque de datos situado al final de la zona indexada
+	 *  @param block Datos
+	 *  @param count Tamanio de los datos
+	 */
+	void _scan(const char* block, size_t count);
+
+	/** Calcula el CRC de los bytes finales de la zona indexada
+	 *  @param stream Archivo indexado
+	 *  @param end Fin de la zona indexada
+	 *  @return CRC32
+	 */
+	uint32_t _tailCrc(FILE* stream, uint32_t end);
+
+	/** Reinicia el indice */
+	void _reset();
+
+	FATInterface* _fat;
+	char _file[MAX_PATH_NAME_LENGTH];
+	char _idx_file[MAX_PATH_NAME_LENGTH];
+	uint16_t _stride;
+	bool _loaded;
+	Header _hdr;
+	std::vector<uint32_t> _checkpoints;
+};
+
+#endif /*__FATLineIndex__H */
+
+/**** END OF FILE ****/
@@ -0,0 +1,97 @@
+/*
+ * FATLineReader.cpp
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ */
+
+#include "FATLineReader.h"
+
+
+//------------------------------------------------------------------------------------
+FATLineReader::FATLineReader(FATInterface* fat, FILE* stream, size_t block_size) : _fat(fat), _stream(stream), _start(0), _end(0), _lines(0), _eof(false), _skip(false) {
+	if(block_size < FATLineReader_MIN_BLOCK_SIZE){
+		block_size = FATLineReader_MIN_BLOCK_SIZE;
+	}
+	if(block_size > FATLineReader_MAX_BLOCK_SIZE){
+		block_size = FATLineReader_MAX_BLOCK_SIZE;
+	}
+	_size = block_size;
+	_buf = new char[_size];
+	MBED_ASSERT(_buf);
+}
+
+
+//------------------------------------------------------------------------------------
+FATLineReader::~FATLineReader(){
+	delete[](_buf);
+}
+
+
+//------------------------------------------------------------------------------------
+bool FATLineReader::next(const char** line, size_t* len, bool* truncated){
+	bool cut = false;
+	for(;;){
+		char* nl = (char*)memchr(&_buf[_start], '\n', _end - _start);
+		if(nl && _skip){
+			// fin de la linea truncada entregada en la llamada anterior
+			_start = (nl - _buf) + 1;
+			_skip = false;
+			continue;
+		}
+		if(nl){
+			*line = &_buf[_start];
+			*len = nl - &_buf[_start];
+			_start = (nl - _buf) + 1;
+			break;
+		}
+		if(_skip){
+			// se descarta el resto de la linea truncada que hay en el buffer
+			_start = _end;
+			if(!_eof && _refill() > 0){
+				continue;
+			}
+			return false;
+		}
+		// Sin fin de linea en el buffer: se recarga, o se entrega lo pendiente si no cabe o es el final
+		bool full = (_start == 0 && _end == _size);
+		if(!full && !_eof && _refill() > 0){
+			continue;
+		}
+		if(_start == _end){
+			return false;
+		}
+		*line = &_buf[_start];
+		*len = _end - _start;
+		_start = _end;
+		cut = full;
+		_skip = full;
+		break;
+	}
+	if(*len > 0 && (*line)[*len - 1] == '\r'){
+		(*len)--;
+	}
+	if(truncated){
+		*truncated = cut;
+	}
+	_lines++;
+	return true;
+}
+
+
+//------------------------------------------------------------------------------------
+size_t FATLineReader::_refill(){
+	if(_start > 0){
+		memmove(_buf, &_buf[_start], _end - _start);
+		_end -= _start;
+		_start = 0;
+	}
+	size_t count = _fat->read(&_buf[_end], sizeof(char), _size - _end, _stream);
+	if(count == 0){
+		_eof = true;
+	}
+	_end += count;
+	return count;
+}
+
+/**** END OF FILE ****/
@@ -0,0 +1,74 @@
+/*
+ * FATLineReader.h
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ *
+ *	FATLineReader permite leer un archivo de texto linea a linea mediante lecturas en bloque sobre un buffer propio.
+ *  Las lineas se localizan con memchr y se entregan como referencias al buffer, sin copia por linea. El mutex de
+ *  FATInterface solo se toma al recargar el buffer.
+ */
+
+#ifndef __FATLineReader__H
+#define __FATLineReader__H
+
+#include "mbed.h"
+#include "FATInterface.h"
+
+
+/** Limites y valor por defecto del tamanio del buffer de lectura */
+#define FATLineReader_MIN_BLOCK_SIZE		4096
+#define FATLineReader_MAX_BLOCK_SIZE		32768
+#define FATLineReader_DEFAULT_BLOCK_SIZE	4096
+
+
+class FATLineReader{
+  public:
+
+    /** Constructor
+     *  Asocia el lector a un archivo abierto con FATInterface::open
+     *  @param fat Particion FAT
+     *  @param stream Archivo a leer, desde su posicion actual
+     *  @param block_size Tamanio del buffer de lectura (entre 4KB y 32KB)
+     */
+	FATLineReader(FATInterface* fat, FILE* stream, size_t block_size = FATLineReader_DEFAULT_BLOCK_SIZE);
+	virtual ~FATLineReader();
+
+	/** next
+	 *  Obtiene la siguiente linea. La referencia es valida hasta la siguiente llamada. Las lineas que no caben en
+	 *  el buffer se entregan truncadas a su tamanio y el resto se descarta hasta el siguiente fin de linea, de modo
+	 *  que cada llamada corresponde a una linea del archivo.
+	 *  @param line Recibe el inicio de la linea, sin terminador
+	 *  @param len Recibe la longitud de la linea, sin el fin de linea ("\n" o "\r\n")
+	 *  @param truncated Recibe (opcional) si la linea se ha truncado
+	 *  @return true si se ha obtenido una linea, false al final del archivo
+	 */
+	bool next(const char** line, size_t* len, bool* truncated = NULL);
+
+	/** getLineNumber
+	 *  Obtiene el numero de lineas entregadas
+	 *  @return Numero de lineas
+	 */
+	size_t getLineNumber() { return _lines; }
+
+  private:
+
+	/** Recarga el buffer conservando los datos aun no consumidos
+	 *  @return Numero de bytes leidos del archivo
+	 */
+	size_t _refill();
+
+	FATInterface* _fat;
+	FILE* _stream;
+	char* _buf;
+	size_t _size;
+	size_t _start;
+	size_t _end;
+	size_t _lines;
+	bool _eof;
+	bool _skip;		/* Descartando el resto de una linea truncada */
+};
+
+#endif /*__FATLineReader__H */
+
+/**** END OF FILE ****/
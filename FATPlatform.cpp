@@ -0,0 +1,202 @@
+/*
+ * FATPlatform.cpp
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ */
+
+#include "FATPlatform.h"
+#include <sys/stat.h>
+#include <errno.h>
+#if ESP_PLATFORM == 1
+#include "rom/crc.h"
+#include "esp_timer.h"
+#else
+#include <ftw.h>
+#include <time.h>
+#endif
+
+
+//------------------------------------------------------------------------------------
+//--- PRIVATE TYPES ------------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+static const char* _MODULE_ = "[FATPlatform]...";
+#define _EXPR_	(!IS_ISR())
+
+
+//------------------------------------------------------------------------------------
+//-- FATPlatform ---------------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+FATPlatform* FATPlatform::create(){
+	#if ESP_PLATFORM == 1
+	return new FATPlatformESP();
+	#else
+	return new FATPlatformPosix();
+	#endif
+}
+
+
+//------------------------------------------------------------------------------------
+uint32_t FATPlatform::crc32(uint32_t crc, const void* data, size_t len){
+	#if ESP_PLATFORM == 1
+	return crc32_le(crc, (const uint8_t*)data, len);
+	#else
+	const uint8_t* p = (const uint8_t*)data;
+	crc = ~crc;
+	while(len--){
+		crc ^= *p++;
+		for(int k = 0; k < 8; k++){
+			crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+		}
+	}
+	return ~crc;
+	#endif
+}
+
+
+//------------------------------------------------------------------------------------
+uint32_t FATPlatform::now_us(){
+	#if ESP_PLATFORM == 1
+	return (uint32_t)esp_timer_get_time();
+	#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+	#endif
+}
+
+
+//------------------------------------------------------------------------------------
+//-- FATPlatformESP ------------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+#if ESP_PLATFORM == 1
+
+//------------------------------------------------------------------------------------
+int FATPlatformESP::resolvePath(const char* path, char* root, size_t len){
+	int n = snprintf(root, len, "/%s", path);
+	return (n > 0 && (size_t)n < len)? 0 : -1;
+}
+
+
+//------------------------------------------------------------------------------------
+int FATPlatformESP::mount(const char* root, const char* label, int max_files, bool format){
+	esp_vfs_fat_mount_config_t mount_config;
+	mount_config.max_files = max_files;
+	mount_config.format_if_mount_failed = format;
+	mount_config.allocation_unit_size = CONFIG_WL_SECTOR_SIZE;
+	esp_err_t err = esp_vfs_fat_spiflash_mount(root, label, &mount_config, &_wl_handle);
+	if(err != ESP_OK){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "Error montando Fatfs path:%s , label:%s  %s", root, label, esp_err_to_name(err));
+	}
+	return err;
+}
+
+
+//------------------------------------------------------------------------------------
+int FATPlatformESP::umount(const char* root){
+	esp_err_t err = esp_vfs_fat_spiflash_unmount(root, _wl_handle);
+	if(err != ESP_OK){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "OTHER ERROR %s", esp_err_to_name(err));
+	}
+	return err;
+}
+
+
+//------------------------------------------------------------------------------------
+bool FATPlatformESP::format(const char* root, const char* label){
+	bool res = true;
+	esp_partition_iterator_t fat_ite = esp_partition_find(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_FAT, NULL);
+	if(fat_ite != NULL){
+		const esp_partition_t* part = esp_partition_get(fat_ite);
+		DEBUG_TRACE_I(_EXPR_,_MODULE_,"Inicio Formateamos FAT!!!!!!!!")
+		DEBUG_TRACE_I(_EXPR_,_MODULE_,"Type: %d", (uint32_t)part->type);
+		DEBUG_TRACE_I(_EXPR_,_MODULE_,"SubType: %d", (uint32_t)part->subtype);
+		DEBUG_TRACE_I(_EXPR_,_MODULE_,"Address: 0x%x", part->address);
+		DEBUG_TRACE_I(_EXPR_,_MODULE_,"Size: 0x%x", part->size);
+		DEBUG_TRACE_I(_EXPR_,_MODULE_,"Label: %d", (uint8_t)part->label);
+		DEBUG_TRACE_I(_EXPR_,_MODULE_,"Encrypted: %d", (uint8_t)part->encrypted);
+
+		esp_err_t err = esp_partition_erase_range(part,0, part->size);
+		if(err != ESP_OK){
+			DEBUG_TRACE_I(_EXPR_,_MODULE_,"Error formateando partition: %d",(int)err);
+			res = false;
+		}
+		else{
+			DEBUG_TRACE_I(_EXPR_,_MODULE_,"Fin Formateamos FAT!!!!!!!!");
+			esp_partition_iterator_release(fat_ite);
+		}
+	}
+	else{
+		DEBUG_TRACE_E(_EXPR_,_MODULE_,"Particion FAT no encontrada!!!!");
+		res = false;
+	}
+	return res;
+}
+
+#endif
+
+
+//------------------------------------------------------------------------------------
+//-- FATPlatformPosix ----------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+#if ESP_PLATFORM != 1
+
+/** Elimina una entrada durante el recorrido de <format> */
+static int _removeEntry(const char* path, const struct stat* st, int flag, struct FTW* ftw){
+	// el directorio raiz se conserva
+	return (ftw->level == 0)? 0 : remove(path);
+}
+
+
+//------------------------------------------------------------------------------------
+FATPlatformPosix::FATPlatformPosix(const char* host_root){
+	snprintf(_host_root, sizeof(_host_root), "%s", host_root);
+}
+
+
+//------------------------------------------------------------------------------------
+int FATPlatformPosix::resolvePath(const char* path, char* root, size_t len){
+	int n = snprintf(root, len, "%s/%s", _host_root, path);
+	return (n > 0 && (size_t)n < len)? 0 : -1;
+}
+
+
+//------------------------------------------------------------------------------------
+int FATPlatformPosix::mount(const char* root, const char* label, int max_files, bool format){
+	// se crean el directorio raiz y los intermedios que falten
+	char dir[128];
+	snprintf(dir, sizeof(dir), "%s", root);
+	for(char* p = dir + 1; *p; p++){
+		if(*p == '/'){
+			*p = 0;
+			mkdir(dir, S_IRWXU | S_IRWXG | S_IRWXO);
+			*p = '/';
+		}
+	}
+	if(mkdir(dir, S_IRWXU | S_IRWXG | S_IRWXO) != 0 && errno != EEXIST){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "Error montando directorio %s, label:%s", root, label);
+		return -1;
+	}
+	return 0;
+}
+
+
+//------------------------------------------------------------------------------------
+int FATPlatformPosix::umount(const char* root){
+	return 0;
+}
+
+
+//------------------------------------------------------------------------------------
+bool FATPlatformPosix::format(const char* root, const char* label){
+	return (nftw(root, _removeEntry, 16, FTW_DEPTH | FTW_PHYS) == 0);
+}
+
+#endif
+
+/**** END OF FILE ****/
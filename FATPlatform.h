@@ -0,0 +1,133 @@
+/*
+ * FATPlatform.h
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ *
+ *	FATPlatform aisla a FATInterface de la plataforma que proporciona el sistema de ficheros. Resuelve el path raiz
+ *  y realiza el montaje, desmontaje y formateo. Las operaciones sobre archivos se realizan siempre mediante la API
+ *  POSIX/stdio sobre el path raiz resuelto.
+ *
+ *  - FATPlatformESP: particion FAT con wear levelling de ESP-IDF (esp_vfs_fat_spiflash_mount).
+ *  - FATPlatformPosix: directorio del host, para ejecutar pruebas y medidas de rendimiento fuera del dispositivo.
+ */
+
+#ifndef __FATPlatform__H
+#define __FATPlatform__H
+
+#include "mbed.h"
+#if ESP_PLATFORM == 1
+#include "esp_vfs_fat.h"
+#endif
+
+
+/** Tamanio de sector del sistema de ficheros */
+#if defined(CONFIG_WL_SECTOR_SIZE)
+#define FAT_SECTOR_SIZE						CONFIG_WL_SECTOR_SIZE
+#else
+#define FAT_SECTOR_SIZE						4096
+#endif
+
+/** Directorio del host en el que FATPlatformPosix situa las particiones */
+#if !defined(FATPlatformPosix_DEFAULT_ROOT)
+#define FATPlatformPosix_DEFAULT_ROOT		"."
+#endif
+
+
+class FATPlatform{
+  public:
+
+	virtual ~FATPlatform(){}
+
+	/** resolvePath
+	 *  Obtiene el path raiz de una particion
+	 *  @param path Path de la particion indicado a FATInterface
+	 *  @param root Buffer destino
+	 *  @param len Tamanio del buffer
+	 *  @return 0 (correcto), <0 si no cabe en el buffer
+	 */
+	virtual int resolvePath(const char* path, char* root, size_t len) = 0;
+
+	/** mount
+	 *  Monta la particion en el path raiz
+	 *  @param root Path raiz resuelto
+	 *  @param label Etiqueta de la particion
+	 *  @param max_files Numero maximo de archivos abiertos
+	 *  @param format Flag para formatear si falla el montaje
+	 *  @return 0 (correcto), codigo de error en caso contrario
+	 */
+	virtual int mount(const char* root, const char* label, int max_files, bool format) = 0;
+
+	/** umount
+	 *  Desmonta la particion
+	 *  @param root Path raiz resuelto
+	 *  @return 0 (correcto), codigo de error en caso contrario
+	 */
+	virtual int umount(const char* root) = 0;
+
+	/** format
+	 *  Borra todo el contenido de la particion
+	 *  @param root Path raiz resuelto
+	 *  @param label Etiqueta de la particion
+	 *  @return true si se ha formateado
+	 */
+	virtual bool format(const char* root, const char* label) = 0;
+
+	/** create
+	 *  Crea la implementacion por defecto de la plataforma de compilacion
+	 *  @return Plataforma, a liberar por el llamante
+	 */
+	static FATPlatform* create();
+
+	/** crc32
+	 *  Calcula un CRC32 (polinomio 0xEDB88320), compatible con crc32_le de ESP-IDF
+	 *  @param crc CRC inicial
+	 *  @param data Datos
+	 *  @param len Tamanio
+	 *  @return CRC32
+	 */
+	static uint32_t crc32(uint32_t crc, const void* data, size_t len);
+
+	/** now_us
+	 *  Obtiene el tiempo actual en microsegundos
+	 *  @return Tiempo (us)
+	 */
+	static uint32_t now_us();
+};
+
+
+#if ESP_PLATFORM == 1
+class FATPlatformESP : public FATPlatform{
+  public:
+	FATPlatformESP() : _wl_handle(WL_INVALID_HANDLE) {}
+	virtual int resolvePath(const char* path, char* root, size_t len);
+	virtual int mount(const char* root, const char* label, int max_files, bool format);
+	virtual int umount(const char* root);
+	virtual bool format(const char* root, const char* label);
+
+  private:
+	wl_handle_t _wl_handle;		/* Wear levelling handle */
+};
+#endif
+
+
+#if ESP_PLATFORM != 1
+class FATPlatformPosix : public FATPlatform{
+  public:
+	/** Constructor
+	 *  @param host_root Directorio del host que contiene las particiones
+	 */
+	FATPlatformPosix(const char* host_root = FATPlatformPosix_DEFAULT_ROOT);
+	virtual int resolvePath(const char* path, char* root, size_t len);
+	virtual int mount(const char* root, const char* label, int max_files, bool format);
+	virtual int umount(const char* root);
+	virtual bool format(const char* root, const char* label);
+
+  private:
+	char _host_root[64];
+};
+#endif
+
+#endif /*__FATPlatform__H */
+
+/**** END OF FILE ****/
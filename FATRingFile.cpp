@@ -0,0 +1,204 @@
+/*
+ * FATRingFile.cpp
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ */
+
+#include "FATRingFile.h"
+#include <unistd.h>
+
+
+//------------------------------------------------------------------------------------
+//--- PRIVATE TYPES ------------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+static const char* _MODULE_ = "[RingFile]......";
+#define _EXPR_	(!IS_ISR())
+
+
+//------------------------------------------------------------------------------------
+//-- PUBLIC METHODS IMPLEMENTATION ---------------------------------------------------
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+FATRingFile::FATRingFile(FATInterface* fat, const char* filename, uint32_t record_size, uint32_t capacity) :
+		_fat(fat), _fp(NULL), _record_size(record_size), _capacity(capacity) {
+	snprintf(_filename, MAX_PATH_NAME_LENGTH, "%s", filename);
+	memset(&_hdr, 0, sizeof(Header));
+	// sin registros no hay posiciones de escritura (sequence % capacity) y el archivo debe ser direccionable
+	if(_record_size == 0 || _capacity == 0 || (uint64_t)_record_size * _capacity > (uint64_t)(INT32_MAX - 2 * HeaderSlotSize)){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_SIZE, Formato no valido para %s: %d registros de %d bytes", _filename, _capacity, _record_size);
+		return;
+	}
+	_mtx.lock();
+	_fp = _fat->open(_filename, "r+b");
+	if(!_fp || !_loadHeader()){
+		if(_fp){
+			DEBUG_TRACE_W(_EXPR_, _MODULE_, "Cabecera de %s no valida, se crea de nuevo", _filename);
+			_fat->close(_fp);
+			_fp = NULL;
+		}
+		_create();
+	}
+	_mtx.unlock();
+}
+
+
+//------------------------------------------------------------------------------------
+FATRingFile::~FATRingFile(){
+	_mtx.lock();
+	if(_fp){
+		_fat->close(_fp);
+		_fp = NULL;
+	}
+	_mtx.unlock();
+}
+
+
+//------------------------------------------------------------------------------------
+int FATRingFile::append(const void* record){
+	_mtx.lock();
+	if(!_fp){
+		_mtx.unlock();
+		return -1;
+	}
+	// primero el registro y despues la cabecera: si se interrumpe, prevalece la cabecera anterior. El registro se
+	// sincroniza antes de escribir la cabecera, ya que stdio y FAT no garantizan el orden de llegada a la flash
+	fseek(_fp, _offset(_hdr.sequence % _capacity), SEEK_SET);
+	if(_fat->write(record, _record_size, 1, _fp) != 1 || _fat->flush(_fp, true) != 0){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_WRITE, Error escribiendo registro %d", _hdr.sequence);
+		_mtx.unlock();
+		return -1;
+	}
+	_hdr.sequence++;
+	int err = _saveHeader();
+	_mtx.unlock();
+	return err;
+}
+
+
+//------------------------------------------------------------------------------------
+int FATRingFile::read(uint32_t age, void* record){
+	_mtx.lock();
+	if(!_fp || age >= getCount()){
+		_mtx.unlock();
+		return -1;
+	}
+	fseek(_fp, _offset((_hdr.sequence - 1 - age) % _capacity), SEEK_SET);
+	int err = (_fat->read(record, _record_size, 1, _fp) == 1)? 0 : -1;
+	_mtx.unlock();
+	return err;
+}
+
+
+//------------------------------------------------------------------------------------
+int FATRingFile::forEach(Callback<bool(uint32_t, const void*)> visitor){
+	if(!_fp){
+		return -1;
+	}
+	uint8_t* record = new uint8_t[_record_size];
+	MBED_ASSERT(record);
+	_mtx.lock();
+	uint32_t count = getCount();
+	uint32_t sequence = _hdr.sequence;
+	_mtx.unlock();
+	int visited = 0;
+	for(uint32_t age = 0; age < count; age++){
+		if(read(age, record) != 0){
+			visited = -1;
+			break;
+		}
+		visited++;
+		if(!visitor.call(sequence - 1 - age, record)){
+			break;
+		}
+	}
+	delete[](record);
+	return visited;
+}
+
+
+//------------------------------------------------------------------------------------
+int FATRingFile::sync(){
+	_mtx.lock();
+	int err = (_fp && _fat->flush(_fp, true) == 0)? 0 : -1;
+	_mtx.unlock();
+	return err;
+}
+
+
+//------------------------------------------------------------------------------------
+//-- PRIVATE METHODS IMPLEMENTATION --------------------------------------------------
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+bool FATRingFile::_loadHeader(){
+	bool found = false;
+	for(uint32_t i = 0; i < 2; i++){
+		Header hdr;
+		fseek(_fp, i * HeaderSlotSize, SEEK_SET);
+		if(_fat->read(&hdr, sizeof(Header), 1, _fp) != 1){
+			continue;
+		}
+		if(hdr.magic != HeaderMagic || hdr.version != HeaderVersion || hdr.crc != FATPlatform::crc32(0, &hdr, offsetof(Header, crc))){
+			continue;
+		}
+		if(hdr.record_size != _record_size || hdr.capacity != _capacity){
+			continue;
+		}
+		if(!found || hdr.sequence > _hdr.sequence){
+			_hdr = hdr;
+			found = true;
+		}
+	}
+	return found;
+}
+
+
+//------------------------------------------------------------------------------------
+int FATRingFile::_saveHeader(){
+	_hdr.crc = FATPlatform::crc32(0, &_hdr, offsetof(Header, crc));
+	// las cabeceras consecutivas se alternan entre las dos copias
+	fseek(_fp, (_hdr.sequence & 1) * HeaderSlotSize, SEEK_SET);
+	return (_fat->write(&_hdr, sizeof(Header), 1, _fp) == 1)? 0 : -1;
+}
+
+
+//------------------------------------------------------------------------------------
+int FATRingFile::_create(){
+	_fp = _fat->open(_filename, "w+b");
+	if(!_fp){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_OPEN, No se puede crear %s", _filename);
+		return -1;
+	}
+	memset(&_hdr, 0, sizeof(Header));
+	_hdr.magic = HeaderMagic;
+	_hdr.version = HeaderVersion;
+	_hdr.record_size = _record_size;
+	_hdr.capacity = _capacity;
+	// se preasigna el archivo completo, de forma que su tamanio no cambia durante el uso
+	uint8_t* block = new uint8_t[FAT_COPY_BLOCK_SIZE]();
+	MBED_ASSERT(block);
+	uint32_t pending = _offset(_capacity);
+	int err = 0;
+	while(err == 0 && pending > 0){
+		uint32_t len = (pending < FAT_COPY_BLOCK_SIZE)? pending : FAT_COPY_BLOCK_SIZE;
+		err = (_fat->write(block, sizeof(uint8_t), len, _fp) == len)? 0 : -1;
+		pending -= len;
+	}
+	delete[](block);
+	if(err == 0){
+		// la copia no escrita queda a cero y por tanto invalida
+		err = _saveHeader();
+	}
+	if(err != 0){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_WRITE, No se puede preasignar %s", _filename);
+		_fat->close(_fp);
+		_fp = NULL;
+		_fat->eraseFile(_filename);
+	}
+	return err;
+}
+
+/**** END OF FILE ****/
@@ -0,0 +1,139 @@
+/*
+ * FATRingFile.h
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ *
+ *	FATRingFile es un contenedor circular de N registros de tamanio fijo sobre un archivo preasignado de la particion
+ *  FAT. Al llenarse, cada nuevo registro sustituye al mas antiguo, de forma que el espacio ocupado es constante y no
+ *  es necesario reescribir el archivo para descartar datos.
+ *
+ *  La posicion de escritura se deriva de la secuencia de registros, almacenada en una cabecera protegida por CRC.
+ *  La cabecera se escribe alternativamente en dos copias, de forma que si una escritura se interrumpe por un corte
+ *  de alimentacion, al reabrir se recupera la copia valida con mayor secuencia.
+ *
+ *  Formato: [Header A][Header B][registro 0]...[registro N-1]
+ */
+
+#ifndef __FATRingFile__H
+#define __FATRingFile__H
+
+#include "mbed.h"
+#include "FATInterface.h"
+
+
+class FATRingFile{
+  public:
+
+    /** Constructor
+     *  Abre el archivo si existe con el mismo formato o lo crea preasignando todos los registros
+     *  @param fat Particion FAT
+     *  @param filename Archivo
+     *  @param record_size Tamanio de cada registro (>0)
+     *  @param capacity Numero de registros (>0). Con un formato no valido el archivo no se abre (ver <ready>)
+     */
+	FATRingFile(FATInterface* fat, const char* filename, uint32_t record_size, uint32_t capacity);
+
+    /** Destructor
+     *  Cierra el archivo
+     */
+	virtual ~FATRingFile();
+
+	/** ready
+	 *  Chequea si el archivo esta abierto
+	 *  @return true si esta listo
+	 */
+	bool ready() { return (_fp != NULL); }
+
+	/** append
+	 *  Escribe un registro en la siguiente posicion, sustituyendo al mas antiguo si el contenedor esta lleno. El
+	 *  registro se sincroniza con el disco (fsync) antes de actualizar la cabecera que lo publica
+	 *  @param record Registro de <record_size> bytes
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int append(const void* record);
+
+	/** read
+	 *  Lee el registro con la antiguedad indicada
+	 *  @param age Antiguedad (0 = mas reciente ... count-1 = mas antiguo)
+	 *  @param record Buffer destino de <record_size> bytes
+	 *  @return 0 (correcto), <0 si el registro no existe
+	 */
+	int read(uint32_t age, void* record);
+
+	/** forEach
+	 *  Recorre los registros del mas reciente al mas antiguo
+	 *  @param visitor Callback invocada con la secuencia y el contenido de cada registro. Si devuelve false se
+	 *  	   detiene el recorrido
+	 *  @return Numero de registros visitados o <0 si hay error
+	 */
+	int forEach(Callback<bool(uint32_t, const void*)> visitor);
+
+	/** sync
+	 *  Vuelca a disco los registros y la cabecera
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int sync();
+
+	/** getCount
+	 *  Obtiene el numero de registros almacenados
+	 *  @return Numero de registros
+	 */
+	uint32_t getCount() { return (_hdr.sequence < _capacity)? _hdr.sequence : _capacity; }
+
+	/** getSequence
+	 *  Obtiene el numero total de registros escritos desde la creacion del archivo
+	 *  @return Secuencia
+	 */
+	uint32_t getSequence() { return _hdr.sequence; }
+
+  private:
+
+	/** Cabecera del archivo */
+	struct Header{
+		uint32_t magic;
+		uint16_t version;
+		uint16_t reserved;
+		uint32_t record_size;
+		uint32_t capacity;
+		uint32_t sequence;		/* Registros escritos. El siguiente se escribe en sequence % capacity */
+		uint32_t crc;
+	};
+
+	static const uint32_t HeaderMagic = 0x474E4952;	// "RING"
+	static const uint16_t HeaderVersion = 1;
+	static const uint32_t HeaderSlotSize = 32;
+
+	/** Carga la copia valida de la cabecera con mayor secuencia
+	 *  @return true si hay alguna copia valida con el formato solicitado
+	 */
+	bool _loadHeader();
+
+	/** Escribe la cabecera en la copia que corresponde a su secuencia
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int _saveHeader();
+
+	/** Crea el archivo preasignando todos los registros
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int _create();
+
+	/** Obtiene la posicion en el archivo de un registro
+	 *  @param slot Indice del registro (0..N-1)
+	 *  @return Posicion
+	 */
+	long _offset(uint32_t slot) { return (long)(2 * HeaderSlotSize + slot * _record_size); }
+
+	FATInterface* _fat;
+	FILE* _fp;
+	Mutex _mtx;
+	char _filename[MAX_PATH_NAME_LENGTH];
+	uint32_t _record_size;
+	uint32_t _capacity;
+	Header _hdr;
+};
+
+#endif /*__FATRingFile__H */
+
+/**** END OF FILE ****/
@@ -0,0 +1,250 @@
+/*
+ * FATRotatingLog.cpp
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ */
+
+#include "FATRotatingLog.h"
+
+
+//------------------------------------------------------------------------------------
+//--- PRIVATE TYPES ------------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+static const char* _MODULE_ = "[RotatingLog]...";
+#define _EXPR_	(!IS_ISR())
+
+
+//------------------------------------------------------------------------------------
+//-- PUBLIC METHODS IMPLEMENTATION ---------------------------------------------------
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+FATRotatingLog::FATRotatingLog(FATInterface* fat, const char* base, uint32_t max_file_size, uint8_t num_files) :
+		_fat(fat), _fp(NULL), _max_size(max_file_size), _num_files((num_files < 2)? 2 : num_files), _size(0) {
+	int len = snprintf(_base, MAX_PATH_NAME_LENGTH, "%s", base);
+	memset(&_index, 0, sizeof(RingIndex));
+	// el indice y el archivo de numero mas largo deben caber en MAX_PATH_NAME_LENGTH
+	char name[MAX_PATH_NAME_LENGTH];
+	if(len < 0 || len >= MAX_PATH_NAME_LENGTH || !_fileName(name, -1) || !_fileName(name, _num_files - 1)){
+		return;
+	}
+	_mtx.lock();
+	if(!_loadIndex()){
+		// sin indice valido se estima el archivo actual por tamanio (la fecha de FAT no es fiable)
+		memset(&_index, 0, sizeof(RingIndex));
+		_index.magic = IndexMagic;
+		_index.version = IndexVersion;
+		_index.num_files = _num_files;
+		_index.current = _guessCurrent();
+		DEBUG_TRACE_W(_EXPR_, _MODULE_, "Indice de %s no valido, retomando archivo %d", _base, _index.current);
+		_saveIndex();
+	}
+	_openSlot(_index.current, false);
+	_mtx.unlock();
+}
+
+
+//------------------------------------------------------------------------------------
+FATRotatingLog::~FATRotatingLog(){
+	_mtx.lock();
+	if(_fp){
+		_fat->close(_fp);
+		_fp = NULL;
+	}
+	_mtx.unlock();
+}
+
+
+//------------------------------------------------------------------------------------
+int FATRotatingLog::write(const void* data, size_t len){
+	_mtx.lock();
+	if(_fp && _size > 0 && _size + len > _max_size){
+		rotate();
+	}
+	if(!_fp){
+		_mtx.unlock();
+		return -1;
+	}
+	size_t written = _fat->write(data, sizeof(uint8_t), len, _fp);
+	_size += written;
+	_mtx.unlock();
+	return (written == len)? 0 : -1;
+}
+
+
+//------------------------------------------------------------------------------------
+int FATRotatingLog::writeLine(const char* line){
+	size_t len = strlen(line);
+	_mtx.lock();
+	if(_fp && _size > 0 && _size + len + 1 > _max_size){
+		rotate();
+	}
+	// la linea y su fin de linea se escriben siempre en el mismo archivo
+	int err = write(line, len);
+	if(err == 0){
+		err = write("\n", 1);
+	}
+	_mtx.unlock();
+	return err;
+}
+
+
+//------------------------------------------------------------------------------------
+int FATRotatingLog::rotate(){
+	_mtx.lock();
+	if(_fp){
+		_fat->close(_fp);
+		_fp = NULL;
+	}
+	// se vacia el siguiente archivo antes de publicarlo en el indice: si se interrumpe, el indice sigue apuntando
+	// al archivo anterior, que esta intacto
+	uint8_t next = (_index.current + 1) % _num_files;
+	int err = _openSlot(next, true);
+	if(err == 0){
+		err = _fat->flush(_fp, true);
+	}
+	if(err == 0){
+		_index.current = next;
+		_index.sequence++;
+		err = _saveIndex();
+	}
+	else if(!_fp){
+		// se sigue escribiendo en el archivo actual
+		_openSlot(_index.current, false);
+	}
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Rotacion %d, archivo actual %s.%d", _index.sequence, _base, _index.current);
+	_mtx.unlock();
+	return err;
+}
+
+
+//------------------------------------------------------------------------------------
+int FATRotatingLog::flush(){
+	_mtx.lock();
+	int err = (_fp && _fat->flush(_fp) == 0)? 0 : -1;
+	_mtx.unlock();
+	return err;
+}
+
+
+//------------------------------------------------------------------------------------
+bool FATRotatingLog::getFileName(uint8_t age, char* name, size_t len){
+	if(age >= _num_files){
+		return false;
+	}
+	_mtx.lock();
+	uint8_t slot = (_index.current + _num_files - age) % _num_files;
+	_mtx.unlock();
+	int n = snprintf(name, len, "%s.%u", _base, slot);
+	return (n > 0 && (size_t)n < len);
+}
+
+
+//------------------------------------------------------------------------------------
+//-- PRIVATE METHODS IMPLEMENTATION --------------------------------------------------
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+bool FATRotatingLog::_loadIndex(){
+	char name[MAX_PATH_NAME_LENGTH];
+	if(!_fileName(name, -1)){
+		return false;
+	}
+	FILE* fp = _fat->open(name, "rb");
+	if(!fp){
+		return false;
+	}
+	RingIndex copies[2];
+	size_t count = _fat->read(copies, sizeof(RingIndex), 2, fp);
+	_fat->close(fp);
+	bool found = false;
+	for(size_t i = 0; i < count; i++){
+		RingIndex& idx = copies[i];
+		bool valid = (idx.magic == IndexMagic && idx.version == IndexVersion && idx.num_files == _num_files &&
+				idx.current < _num_files && idx.crc == FATPlatform::crc32(0, &idx, offsetof(RingIndex, crc)));
+		if(valid && (!found || idx.sequence > _index.sequence)){
+			_index = idx;
+			found = true;
+		}
+	}
+	return found;
+}
+
+
+//------------------------------------------------------------------------------------
+int FATRotatingLog::_saveIndex(){
+	char name[MAX_PATH_NAME_LENGTH];
+	if(!_fileName(name, -1)){
+		return -1;
+	}
+	_index.crc = FATPlatform::crc32(0, &_index, offsetof(RingIndex, crc));
+	FILE* fp = _fat->open(name, "r+b");
+	if(!fp){
+		fp = _fat->open(name, "w+b");
+	}
+	if(!fp){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_OPEN, No se puede escribir el indice %s", name);
+		return -1;
+	}
+	// se sobreescribe la copia mas antigua, conservando la ultima publicada
+	int err = -1;
+	if(fseek(fp, (_index.sequence & 1) * sizeof(RingIndex), SEEK_SET) == 0 && _fat->write(&_index, sizeof(RingIndex), 1, fp) == 1){
+		err = _fat->flush(fp, true);
+	}
+	_fat->close(fp);
+	return err;
+}
+
+
+//------------------------------------------------------------------------------------
+uint8_t FATRotatingLog::_guessCurrent(){
+	char name[MAX_PATH_NAME_LENGTH];
+	uint8_t current = 0;
+	int32_t smallest = -1;
+	for(uint8_t i = 0; i < _num_files; i++){
+		if(!_fileName(name, i)){
+			continue;
+		}
+		int32_t size = _fat->getFileSize(name);
+		if(size > 0 && (smallest < 0 || size < smallest)){
+			smallest = size;
+			current = i;
+		}
+	}
+	return current;
+}
+
+
+//------------------------------------------------------------------------------------
+int FATRotatingLog::_openSlot(uint8_t slot, bool truncate){
+	char name[MAX_PATH_NAME_LENGTH];
+	if(!_fileName(name, slot)){
+		_size = 0;
+		return -1;
+	}
+	_fp = _fat->open(name, (truncate)? "w" : "a");
+	if(!_fp){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_OPEN, No se puede abrir %s", name);
+		_size = 0;
+		return -1;
+	}
+	fseek(_fp, 0, SEEK_END);
+	_size = ftell(_fp);
+	return 0;
+}
+
+
+//------------------------------------------------------------------------------------
+bool FATRotatingLog::_fileName(char* name, int slot){
+	int len = (slot < 0)? snprintf(name, MAX_PATH_NAME_LENGTH, "%s.idx", _base) : snprintf(name, MAX_PATH_NAME_LENGTH, "%s.%u", _base, (unsigned)slot);
+	if(len < 0 || len >= MAX_PATH_NAME_LENGTH){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_PATH, Path demasiado largo para %s", _base);
+		name[0] = 0;
+		return false;
+	}
+	return true;
+}
+
+/**** END OF FILE ****/
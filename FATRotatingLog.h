@@ -0,0 +1,152 @@
+/*
+ * FATRotatingLog.h
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ *
+ *	FATRotatingLog gestiona un conjunto acotado de archivos de log en la particion FAT. Los datos se escriben en
+ *  <base>.0 ... <base>.(N-1), utilizados como un anillo: al superar el tamanio maximo, el siguiente archivo del
+ *  anillo se trunca y pasa a ser el actual, sin renombrar el resto de archivos. El archivo actual y la secuencia de
+ *  rotacion se registran en un pequenio archivo indice <base>.idx, de forma que al arrancar se retoma el archivo
+ *  actual sin recorrer su contenido. El espacio ocupado queda limitado a N veces el tamanio maximo.
+ */
+
+#ifndef __FATRotatingLog__H
+#define __FATRotatingLog__H
+
+#include "mbed.h"
+#include "FATInterface.h"
+
+
+class FATRotatingLog{
+  public:
+
+    /** Constructor
+     *  Retoma el archivo actual desde el archivo indice y lo abre en modo append
+     *  @param fat Particion FAT
+     *  @param base Nombre base de los archivos
+     *  @param max_file_size Tamanio maximo de cada archivo
+     *  @param num_files Numero de archivos del anillo (2..255)
+     */
+	FATRotatingLog(FATInterface* fat, const char* base, uint32_t max_file_size, uint8_t num_files);
+
+    /** Destructor
+     *  Cierra el archivo actual
+     */
+	virtual ~FATRotatingLog();
+
+	/** ready
+	 *  Chequea si el archivo actual esta abierto
+	 *  @return true si esta listo
+	 */
+	bool ready() { return (_fp != NULL); }
+
+	/** write
+	 *  Escribe un bloque en el archivo actual, rotando antes si el bloque excede el tamanio maximo. Un bloque no se
+	 *  divide entre dos archivos
+	 *  @param data Datos
+	 *  @param len Tamanio
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int write(const void* data, size_t len);
+
+	/** writeLine
+	 *  Escribe una linea de texto aniadiendo '\n'
+	 *  @param line Linea sin fin de linea
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int writeLine(const char* line);
+
+	/** rotate
+	 *  Cierra el archivo actual y trunca el siguiente del anillo, que pasa a ser el actual
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int rotate();
+
+	/** flush
+	 *  Vuelca a disco los datos del archivo actual
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int flush();
+
+	/** getFileName
+	 *  Obtiene el nombre del archivo con la antiguedad indicada
+	 *  @param age Antiguedad (0 = actual, 1 = anterior ... N-1 = mas antiguo)
+	 *  @param name Buffer destino
+	 *  @param len Tamanio del buffer
+	 *  @return true si la antiguedad es valida
+	 */
+	bool getFileName(uint8_t age, char* name, size_t len);
+
+	/** getSequence
+	 *  Obtiene el numero de rotaciones realizadas desde la creacion del conjunto
+	 *  @return Secuencia
+	 */
+	uint32_t getSequence() { return _index.sequence; }
+
+	/** getCurrentSize
+	 *  Obtiene el tamanio del archivo actual
+	 *  @return Tamanio en bytes
+	 */
+	uint32_t getCurrentSize() { return _size; }
+
+  private:
+
+	/** Registro del archivo indice del anillo. El indice guarda dos copias que se escriben de forma alterna segun
+	 *  la secuencia, de modo que una escritura interrumpida solo corrompe una de ellas */
+	struct RingIndex{
+		uint32_t magic;
+		uint8_t version;
+		uint8_t num_files;
+		uint8_t current;		/* Archivo actual */
+		uint8_t reserved;
+		uint32_t sequence;		/* Numero de rotaciones */
+		uint32_t crc;
+	};
+
+	static const uint32_t IndexMagic = 0x474F4C52;	// "RLOG"
+	static const uint8_t IndexVersion = 2;
+
+	/** Carga el archivo indice, eligiendo la copia valida con mayor secuencia
+	 *  @return true si alguna copia es valida
+	 */
+	bool _loadIndex();
+
+	/** Escribe el archivo indice en la copia que corresponde a la secuencia actual
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int _saveIndex();
+
+	/** Sin indice valido, estima el archivo actual por tamanio: el de menor tamanio que no este vacio, ya que los
+	 *  anteriores se rotaron al llenarse y los posteriores estan vacios o llenos
+	 *  @return Archivo actual estimado
+	 */
+	uint8_t _guessCurrent();
+
+	/** Abre un archivo del anillo como archivo actual
+	 *  @param slot Archivo del anillo
+	 *  @param truncate Flag para vaciarlo
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int _openSlot(uint8_t slot, bool truncate);
+
+	/** Obtiene el nombre de un archivo del anillo o del indice
+	 *  @param name Recibe el nombre, de tamanio MAX_PATH_NAME_LENGTH
+	 *  @param slot Archivo del anillo o <0 para el archivo indice
+	 *  @return true si el nombre cabe en MAX_PATH_NAME_LENGTH
+	 */
+	bool _fileName(char* name, int slot);
+
+	FATInterface* _fat;
+	FILE* _fp;
+	Mutex _mtx;
+	char _base[MAX_PATH_NAME_LENGTH];
+	uint32_t _max_size;
+	uint8_t _num_files;
+	uint32_t _size;				/* Tamanio del archivo actual */
+	RingIndex _index;
+};
+
+#endif /*__FATRotatingLog__H */
+
+/**** END OF FILE ****/
@@ -0,0 +1,334 @@
+/*
+ * FATSeriesStore.cpp
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ */
+
+#include "FATSeriesStore.h"
+#include <unistd.h>
+
+
+//------------------------------------------------------------------------------------
+//--- PRIVATE TYPES ------------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+static const char* _MODULE_ = "[SeriesStore]...";
+#define _EXPR_	(!IS_ISR())
+
+
+//------------------------------------------------------------------------------------
+//-- PUBLIC METHODS IMPLEMENTATION ---------------------------------------------------
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+FATSeriesStore::FATSeriesStore(FATInterface* fat, const char* folder, uint32_t payload_size, uint16_t block_records, uint16_t segment_blocks) :
+		_fat(fat), _idx_fp(NULL), _seg_fp(NULL), _payload_size(payload_size), _block_records(block_records), _segment_blocks(segment_blocks),
+		_sealed(0), _query_blocks(0) {
+	int len = snprintf(_folder, MAX_PATH_NAME_LENGTH, "%s", folder);
+	memset(&_block, 0, sizeof(BlockSummary));
+	char name[MAX_PATH_NAME_LENGTH];
+	if(len < 0 || len >= MAX_PATH_NAME_LENGTH || snprintf(name, MAX_PATH_NAME_LENGTH, "%s/series.tsi", _folder) >= MAX_PATH_NAME_LENGTH){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_PATH, Path demasiado largo para %s", folder);
+		return;
+	}
+	_mtx.lock();
+	_fat->createFolder(_folder);
+	_idx_fp = _fat->open(name, "r+b");
+	if(!_idx_fp){
+		_idx_fp = _fat->open(name, "w+b");
+	}
+	if(!_idx_fp){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_OPEN, No se puede abrir %s", name);
+		_mtx.unlock();
+		return;
+	}
+	_recover();
+	_mtx.unlock();
+}
+
+
+//------------------------------------------------------------------------------------
+FATSeriesStore::~FATSeriesStore(){
+	_mtx.lock();
+	if(_seg_fp){
+		_fat->close(_seg_fp);
+		_seg_fp = NULL;
+	}
+	if(_idx_fp){
+		_fat->close(_idx_fp);
+		_idx_fp = NULL;
+	}
+	_mtx.unlock();
+}
+
+
+//------------------------------------------------------------------------------------
+int FATSeriesStore::append(uint32_t timestamp, const void* payload){
+	_mtx.lock();
+	if(!ready()){
+		_mtx.unlock();
+		return -1;
+	}
+	// los resumenes solo estan ordenados si las marcas de tiempo no decrecen
+	if(getCount() > 0 && timestamp < _block.max_ts){
+		DEBUG_TRACE_W(_EXPR_, _MODULE_, "ERR_ORDER, Marca de tiempo %d anterior a %d", timestamp, _block.max_ts);
+		_mtx.unlock();
+		return -1;
+	}
+	fseek(_seg_fp, (long)_block.block * _blockBytes() + _block.count * _recordSize(), SEEK_SET);
+	if(_fat->write(&timestamp, sizeof(uint32_t), 1, _seg_fp) != 1 || _fat->write(payload, _payload_size, 1, _seg_fp) != 1){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_WRITE, Error escribiendo en segmento %d", _block.segment);
+		_mtx.unlock();
+		return -1;
+	}
+	if(_block.count == 0){
+		_block.min_ts = timestamp;
+	}
+	_block.max_ts = timestamp;
+	_block.count++;
+	int err = 0;
+	if(_block.count == _block_records){
+		err = _seal();
+	}
+	_mtx.unlock();
+	return err;
+}
+
+
+//------------------------------------------------------------------------------------
+int FATSeriesStore::query(uint32_t from, uint32_t to, Callback<bool(uint32_t, const void*)> visitor){
+	_mtx.lock();
+	if(!ready()){
+		_mtx.unlock();
+		return -1;
+	}
+	_query_blocks = 0;
+	// busqueda binaria del primer bloque completo cuyo maximo alcanza el inicio del rango
+	uint32_t lo = 0;
+	uint32_t hi = _sealed;
+	BlockSummary summary;
+	while(lo < hi){
+		uint32_t mid = lo + (hi - lo) / 2;
+		if(!_readSummary(mid, &summary)){
+			_mtx.unlock();
+			return -1;
+		}
+		if(summary.max_ts < from){
+			lo = mid + 1;
+		}
+		else{
+			hi = mid;
+		}
+	}
+	uint8_t* buf = new uint8_t[_blockBytes()];
+	MBED_ASSERT(buf);
+	int visited = 0;
+	bool running = true;
+	FILE* fp = NULL;
+	uint16_t fp_segment = 0;
+	for(uint32_t i = lo; running && i < _sealed; i++){
+		if(!_readSummary(i, &summary)){
+			visited = -1;
+			break;
+		}
+		if(summary.min_ts > to){
+			running = false;
+			break;
+		}
+		// los segmentos completos se abren aparte del segmento en curso
+		FILE* block_fp = _seg_fp;
+		if(summary.segment != _block.segment){
+			if(!fp || fp_segment != summary.segment){
+				if(fp){
+					_fat->close(fp);
+				}
+				fp = _openSegment(summary.segment, "rb");
+				fp_segment = summary.segment;
+			}
+			block_fp = fp;
+		}
+		if(!block_fp){
+			visited = -1;
+			break;
+		}
+		int res = _scanBlock(block_fp, summary, from, to, visitor, buf, &visited);
+		if(res < 0){
+			visited = -1;
+			break;
+		}
+		running = (res > 0);
+	}
+	if(fp){
+		_fat->close(fp);
+	}
+	// bloque en curso
+	if(visited >= 0 && running && _block.count > 0 && _block.min_ts <= to && _block.max_ts >= from){
+		if(_scanBlock(_seg_fp, _block, from, to, visitor, buf, &visited) < 0){
+			visited = -1;
+		}
+	}
+	delete[](buf);
+	_mtx.unlock();
+	return visited;
+}
+
+
+//------------------------------------------------------------------------------------
+int FATSeriesStore::sync(){
+	_mtx.lock();
+	int err = -1;
+	if(ready() && _fat->flush(_seg_fp, true) == 0 && _fat->flush(_idx_fp, true) == 0){
+		err = 0;
+	}
+	_mtx.unlock();
+	return err;
+}
+
+
+//------------------------------------------------------------------------------------
+//-- PRIVATE METHODS IMPLEMENTATION --------------------------------------------------
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+FILE* FATSeriesStore::_openSegment(uint16_t segment, const char* mode){
+	char name[MAX_PATH_NAME_LENGTH];
+	int len = snprintf(name, MAX_PATH_NAME_LENGTH, "%s/seg%05u.tsd", _folder, segment);
+	if(len < 0 || len >= MAX_PATH_NAME_LENGTH){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_PATH, Path demasiado largo para el segmento %d de %s", segment, _folder);
+		return NULL;
+	}
+	return _fat->open(name, mode);
+}
+
+
+//------------------------------------------------------------------------------------
+int FATSeriesStore::_recover(){
+	// se descarta un resumen incompleto al final del archivo
+	fseek(_idx_fp, 0, SEEK_END);
+	_sealed = ftell(_idx_fp) / sizeof(BlockSummary);
+	memset(&_block, 0, sizeof(BlockSummary));
+	if(_sealed > 0){
+		BlockSummary last;
+		if(!_readSummary(_sealed - 1, &last)){
+			return -1;
+		}
+		_block.segment = last.segment;
+		_block.block = last.block + 1;
+		_block.max_ts = last.max_ts;
+		if(_block.block == _segment_blocks){
+			_block.segment++;
+			_block.block = 0;
+		}
+	}
+	_seg_fp = _openSegment(_block.segment, "r+b");
+	if(!_seg_fp){
+		_seg_fp = _openSegment(_block.segment, "w+b");
+	}
+	if(!_seg_fp){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_OPEN, No se puede abrir el segmento %d", _block.segment);
+		return -1;
+	}
+	// registros escritos tras el ultimo resumen (los resumenes pueden no haber llegado al disco): cada bloque
+	// completo se cierra ahora, continuando en los segmentos siguientes, y el ultimo queda como bloque en curso
+	uint32_t resealed = 0;
+	for(;;){
+		fseek(_seg_fp, 0, SEEK_END);
+		long size = ftell(_seg_fp);
+		long start = (long)_block.block * _blockBytes();
+		uint32_t count = (size > start)? (size - start) / _recordSize() : 0;
+		if(count > _block_records){
+			count = _block_records;
+		}
+		for(uint32_t i = 0; i < count; i++){
+			uint32_t ts;
+			fseek(_seg_fp, start + i * _recordSize(), SEEK_SET);
+			if(_fat->read(&ts, sizeof(uint32_t), 1, _seg_fp) != 1){
+				DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_READ, Error leyendo el segmento %d", _block.segment);
+				return -1;
+			}
+			if(_block.count == 0){
+				_block.min_ts = ts;
+			}
+			_block.max_ts = ts;
+			_block.count++;
+		}
+		if(_block.count == 0 || _block.count < _block_records){
+			break;
+		}
+		if(_seal(true) != 0){
+			return -1;
+		}
+		resealed++;
+	}
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Recuperados %d bloques (%d sin resumen) y %d registros en curso", _sealed, resealed, _block.count);
+	return 0;
+}
+
+
+//------------------------------------------------------------------------------------
+int FATSeriesStore::_seal(bool keep_next){
+	fseek(_idx_fp, (long)_sealed * sizeof(BlockSummary), SEEK_SET);
+	if(_fat->write(&_block, sizeof(BlockSummary), 1, _idx_fp) != 1){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_WRITE, Error escribiendo resumen %d", _sealed);
+		return -1;
+	}
+	_sealed++;
+	uint32_t last_ts = _block.max_ts;
+	uint16_t segment = _block.segment;
+	uint16_t block = _block.block + 1;
+	if(block == _segment_blocks){
+		// se pasa al siguiente segmento
+		_fat->close(_seg_fp);
+		segment++;
+		block = 0;
+		_seg_fp = (keep_next)? _openSegment(segment, "r+b") : NULL;
+		if(!_seg_fp){
+			_seg_fp = _openSegment(segment, "w+b");
+		}
+		if(!_seg_fp){
+			DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_OPEN, No se puede crear el segmento %d", segment);
+		}
+	}
+	memset(&_block, 0, sizeof(BlockSummary));
+	_block.segment = segment;
+	_block.block = block;
+	_block.max_ts = last_ts;
+	return (_seg_fp)? 0 : -1;
+}
+
+
+//------------------------------------------------------------------------------------
+bool FATSeriesStore::_readSummary(uint32_t i, BlockSummary* summary){
+	fseek(_idx_fp, (long)i * sizeof(BlockSummary), SEEK_SET);
+	return (_fat->read(summary, sizeof(BlockSummary), 1, _idx_fp) == 1);
+}
+
+
+//------------------------------------------------------------------------------------
+int FATSeriesStore::_scanBlock(FILE* fp, const BlockSummary& summary, uint32_t from, uint32_t to, Callback<bool(uint32_t, const void*)>& visitor, uint8_t* buf, int* visited){
+	fseek(fp, (long)summary.block * _blockBytes(), SEEK_SET);
+	if(_fat->read(buf, _recordSize(), summary.count, fp) != summary.count){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_READ, Error leyendo el bloque %d del segmento %d", summary.block, summary.segment);
+		return -1;
+	}
+	_query_blocks++;
+	for(uint32_t i = 0; i < summary.count; i++){
+		uint8_t* rec = buf + i * _recordSize();
+		uint32_t ts;
+		memcpy(&ts, rec, sizeof(uint32_t));
+		if(ts < from){
+			continue;
+		}
+		if(ts > to){
+			return 0;
+		}
+		(*visited)++;
+		if(!visitor.call(ts, rec + sizeof(uint32_t))){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**** END OF FILE ****/
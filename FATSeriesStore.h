@@ -0,0 +1,178 @@
+/*
+ * FATSeriesStore.h
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ *
+ *	FATSeriesStore almacena series temporales de registros binarios de tamanio fijo en archivos de segmento dentro
+ *  de un directorio de la particion FAT. Cada registro se compone de una marca de tiempo (uint32_t) y una carga de
+ *  tamanio fijo. Los registros se agrupan en bloques y, al completarse cada bloque, se aniade al archivo de resumen
+ *  su marca de tiempo minima y maxima.
+ *
+ *  Las marcas de tiempo deben ser no decrecientes, por lo que los resumenes estan ordenados y una consulta por
+ *  rango localiza el primer bloque mediante busqueda binaria en el archivo de resumen, leyendo despues solo los
+ *  bloques que solapan con el rango.
+ *
+ *  Archivos: <folder>/series.tsi (resumenes), <folder>/seg<N>.tsd (segmentos de <segment_blocks> bloques)
+ */
+
+#ifndef __FATSeriesStore__H
+#define __FATSeriesStore__H
+
+#include "mbed.h"
+#include "FATInterface.h"
+#include <type_traits>
+
+
+/** Numero de registros por bloque por defecto */
+#define FATSeriesStore_DEFAULT_BLOCK_RECORDS	64
+
+/** Numero de bloques por segmento por defecto */
+#define FATSeriesStore_DEFAULT_SEGMENT_BLOCKS	256
+
+
+class FATSeriesStore{
+  public:
+
+    /** Constructor
+     *  Abre o crea el almacen, recuperando el bloque en curso desde el ultimo segmento
+     *  @param fat Particion FAT
+     *  @param folder Directorio del almacen
+     *  @param payload_size Tamanio de la carga de cada registro
+     *  @param block_records Numero de registros por bloque
+     *  @param segment_blocks Numero de bloques por segmento
+     */
+	FATSeriesStore(FATInterface* fat, const char* folder, uint32_t payload_size, uint16_t block_records = FATSeriesStore_DEFAULT_BLOCK_RECORDS,
+				   uint16_t segment_blocks = FATSeriesStore_DEFAULT_SEGMENT_BLOCKS);
+
+    /** Destructor
+     *  Cierra los archivos abiertos
+     */
+	virtual ~FATSeriesStore();
+
+	/** ready
+	 *  Chequea si el almacen esta abierto
+	 *  @return true si esta listo
+	 */
+	bool ready() { return (_idx_fp != NULL && _seg_fp != NULL); }
+
+	/** append
+	 *  Aniade un registro
+	 *  @param timestamp Marca de tiempo, no inferior a la del ultimo registro
+	 *  @param payload Carga de <payload_size> bytes
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int append(uint32_t timestamp, const void* payload);
+
+	/** append
+	 *  Aniade un registro tipado. El tamanio del tipo debe coincidir con <payload_size>
+	 *  @param timestamp Marca de tiempo
+	 *  @param payload Carga
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	template<typename T>
+	int append(uint32_t timestamp, const T& payload){
+		static_assert(std::is_trivially_copyable<T>::value && !std::is_pointer<T>::value, "Tipo no almacenable en FATSeriesStore");
+		if(sizeof(T) != _payload_size){
+			return -1;
+		}
+		return append(timestamp, (const void*)&payload);
+	}
+
+	/** query
+	 *  Recorre los registros con marca de tiempo en el rango [from, to], en orden cronologico
+	 *  @param from Marca de tiempo inicial
+	 *  @param to Marca de tiempo final
+	 *  @param visitor Callback invocada con la marca de tiempo y la carga de cada registro. Si devuelve false se
+	 *  	   detiene el recorrido
+	 *  @return Numero de registros visitados o <0 si hay error
+	 */
+	int query(uint32_t from, uint32_t to, Callback<bool(uint32_t, const void*)> visitor);
+
+	/** sync
+	 *  Vuelca a disco los segmentos y resumenes
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int sync();
+
+	/** getCount
+	 *  Obtiene el numero de registros almacenados
+	 *  @return Numero de registros
+	 */
+	uint32_t getCount() { return _sealed * _block_records + _block.count; }
+
+	/** getLastQueryBlocks
+	 *  Obtiene el numero de bloques leidos en la ultima consulta
+	 *  @return Numero de bloques
+	 */
+	uint32_t getLastQueryBlocks() { return _query_blocks; }
+
+  private:
+
+	/** Resumen de un bloque */
+	struct BlockSummary{
+		uint32_t min_ts;
+		uint32_t max_ts;
+		uint16_t segment;
+		uint16_t block;
+		uint16_t count;
+		uint16_t reserved;
+	};
+
+	/** Abre un segmento
+	 *  @param segment Numero de segmento
+	 *  @param mode Modo de apertura
+	 *  @return Archivo o NULL
+	 */
+	FILE* _openSegment(uint16_t segment, const char* mode);
+
+	/** Recupera los registros escritos tras el ultimo resumen. Los bloques completos se cierran y el ultimo,
+	 *  incompleto, queda como bloque en curso
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int _recover();
+
+	/** Cierra el bloque en curso, aniadiendo su resumen
+	 *  @param keep_next Flag para conservar el contenido del siguiente segmento si ya existe (recuperacion)
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int _seal(bool keep_next = false);
+
+	/** Lee un resumen
+	 *  @param i Indice del bloque
+	 *  @param summary Recibe el resumen
+	 *  @return true si se ha leido
+	 */
+	bool _readSummary(uint32_t i, BlockSummary* summary);
+
+	/** Recorre los registros de un bloque dentro del rango
+	 *  @param fp Segmento del bloque
+	 *  @param summary Resumen del bloque
+	 *  @param from Marca de tiempo inicial
+	 *  @param to Marca de tiempo final
+	 *  @param visitor Callback
+	 *  @param buf Buffer de un bloque
+	 *  @param visited Contador de registros visitados
+	 *  @return 1 (continuar), 0 (detener el recorrido), <0 (error de lectura)
+	 */
+	int _scanBlock(FILE* fp, const BlockSummary& summary, uint32_t from, uint32_t to, Callback<bool(uint32_t, const void*)>& visitor, uint8_t* buf, int* visited);
+
+	uint32_t _recordSize() { return sizeof(uint32_t) + _payload_size; }
+	uint32_t _blockBytes() { return _block_records * _recordSize(); }
+
+	FATInterface* _fat;
+	FILE* _idx_fp;				/* Archivo de resumenes */
+	FILE* _seg_fp;				/* Segmento en curso */
+	Mutex _mtx;
+	char _folder[MAX_PATH_NAME_LENGTH];
+	uint32_t _payload_size;
+	uint16_t _block_records;
+	uint16_t _segment_blocks;
+	uint32_t _sealed;			/* Bloques completos con resumen */
+	BlockSummary _block;		/* Bloque en curso */
+	uint32_t _query_blocks;
+};
+
+#endif /*__FATSeriesStore__H */
+
+/**** END OF FILE ****/
@@ -8,6 +8,7 @@
 #include "FSManager.h"
 #if ESP_PLATFORM == 1
 #include "nvs.h"
+#include "esp_timer.h"
 #endif
 
 //------------------------------------------------------------------------------------
@@ -27,6 +28,27 @@ static const char* _MODULE_ = "[FS]............";
 #define _EXPR_	(_defdbg && !IS_ISR())
 
 
+/** Obtiene el tiempo desde el arranque en milisegundos
+ *  @return Milisegundos desde el arranque
+ */
+static uint64_t _now_ms(){
+	#if ESP_PLATFORM == 1
+	return (uint64_t)(esp_timer_get_time() / 1000);
+	#else
+	return (uint64_t)(us_ticker_read() / 1000);
+	#endif
+}
+
+
+#if FSManager_NVS_API == 1
+/** Tipos de NVS correspondientes a cada NVSInterface::KeyValueType */
+static const nvs_type_t _nvs_types[] = {
+	NVS_TYPE_U8, NVS_TYPE_I8, NVS_TYPE_U16, NVS_TYPE_I16, NVS_TYPE_U32,
+	NVS_TYPE_I32, NVS_TYPE_U64, NVS_TYPE_I64, NVS_TYPE_STR, NVS_TYPE_BLOB, NVS_TYPE_ANY
+};
+#endif
+
+
  
 //------------------------------------------------------------------------------------
 //-- PUBLIC METHODS IMPLEMENTATION ---------------------------------------------------
@@ -35,10 +57,29 @@ static const char* _MODULE_ = "[FS]............";
 
 
 //------------------------------------------------------------------------------------
-FSManager::FSManager(const char *name, PinName32 mosi, PinName32 miso, PinName32 sclk, PinName32 csel, int freq, bool defdbg) : NVSInterface(name) {
-    #if ESP_PLATFORM == 1
+FSManager::FSManager(const char *name, PinName32 mosi, PinName32 miso, PinName32 sclk, PinName32 csel, int freq, bool defdbg) : NVSInterface(name), _wb_sem(0, 1) {
+	_wb_enabled = false;
+	_wb_delay_ms = 0;
+	_wb_since_ms = 0;
+	_wb_th = NULL;
+	_wb_stop = false;
+	_commits = 0;
+	_cache_max_entries = 0;
+	_cache_max_value_size = 0;
+	_cache_hits = 0;
+	_cache_misses = 0;
+	_suppressed_writes = 0;
+	_async_th = NULL;
+	_async_max = 0;
+	_async_stop = false;
+	_async_busy = false;
+	_async_token = 0;
+	_async_done_token = 0;
+	_async_known_token = 1;
+    #if FSManager_NVS_API == 1
 	_ready = false;
 	_defdbg = defdbg;
+	_handle = 0;
 	// inicializo
 	_mtx.lock();
 	init();
@@ -53,7 +94,7 @@ FSManager::FSManager(const char *name, PinName32 mosi, PinName32 miso, PinName32
 
 //------------------------------------------------------------------------------------
 int FSManager::init() {
-    #if ESP_PLATFORM == 1
+    #if FSManager_NVS_API == 1
 	// Initialize NVS and the default partition
 	esp_err_t err = nvs_flash_init();
 	if (err == ESP_ERR_NVS_NO_FREE_PAGES) {
@@ -87,6 +128,7 @@ int FSManager::init() {
 		return err;
 	}
 	nvs_close(_handle);
+	_handle = 0;
 	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Sistema NVS OK!");
 	_ready = true;
 	return err;
@@ -100,17 +142,21 @@ int FSManager::init() {
 
 //------------------------------------------------------------------------------------
 bool FSManager::open(){
-    #if ESP_PLATFORM == 1
+    #if FSManager_NVS_API == 1
+	STATS_TIMESTAMP(t0);
 	_mtx.lock();
+	STATS_TIMESTAMP(t1);
 	nvs_handle hnd;
 	esp_err_t err = nvs_open_from_partition(DEFAULT_NVSInterface_Partition, _name, NVS_READWRITE, &hnd);
 	if (err != ESP_OK) {
 		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_OPEN [%d] al abrir el sistema NVS", err);
+		STATS_RECORD(_stats, StatOpen, t0, t1, 0, true);
 		_mtx.unlock();
 		return false;
 	}
 	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Sistema NVS abierto.");
 	_handle = hnd;
+	STATS_RECORD(_stats, StatOpen, t0, t1, 0, false);
 	return true;
     #elif __MBED__==1
     //TODO
@@ -122,15 +168,20 @@ bool FSManager::open(){
 
 //------------------------------------------------------------------------------------
 void FSManager::close(){
-    #if ESP_PLATFORM == 1
+    #if FSManager_NVS_API == 1
+	STATS_TIMESTAMP(t0);
 	if(!_handle){
 		DEBUG_TRACE_W(_EXPR_, _MODULE_, "ERR_HND, Handle nulo en <close>");
 		_mtx.unlock();
 		return;
 	}
+	if(_wb_enabled && !_dirty.empty() && (_now_ms() - _wb_since_ms) >= _wb_delay_ms){
+		_flushDirty();
+	}
 	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Cerrando sistema NVS");
 	nvs_close(_handle);
 	_handle = 0;
+	STATS_RECORD(_stats, StatClose, t0, t0, 0, false);
 	_mtx.unlock();
     #elif __MBED__==1
     //TODO
@@ -141,67 +192,87 @@ void FSManager::close(){
 
 //------------------------------------------------------------------------------------
 int FSManager::save(const char* data_id, void* data, uint32_t size, NVSInterface::KeyValueType type){
-    #if ESP_PLATFORM == 1
-	// Eliminamos la clave antes para obtener ese espacio
-	removeKey(data_id);
+	STATS_TIMESTAMP(t0);
+	int err = _save(data_id, data, size, type);
+	STATS_RECORD(_stats, StatSave, t0, t0, NVSInterface::valueSize(data, size, type), err != 0);
+	return err;
+}
+
+
+//------------------------------------------------------------------------------------
+int FSManager::restore(const char* data_id, void* data, uint32_t size, NVSInterface::KeyValueType type){
+	STATS_TIMESTAMP(t0);
+	int err = _restore(data_id, data, size, type);
+	STATS_RECORD(_stats, StatRestore, t0, t0, (err == 0 && data != NULL)? NVSInterface::valueSize(data, size, type) : 0, err != 0);
+	return err;
+}
+
+
+//------------------------------------------------------------------------------------
+int FSManager::removeKey(const char* data_id){
+	STATS_TIMESTAMP(t0);
+	int err = _removeKey(data_id);
+	STATS_RECORD(_stats, StatRemoveKey, t0, t0, 0, err != 0);
+	return err;
+}
+
+
+//------------------------------------------------------------------------------------
+int FSManager::_save(const char* data_id, void* data, uint32_t size, NVSInterface::KeyValueType type){
+    #if FSManager_NVS_API == 1
 	esp_err_t err = ESP_ERR_NVS_INVALID_HANDLE;
+	// Si el valor no ha cambiado no se accede a la flash
+	if(_handle && _isUnchanged(data_id, data, size, type)){
+		_suppressed_writes++;
+		DEBUG_TRACE_D(_EXPR_, _MODULE_, "Id %s sin cambios, escritura descartada", data_id);
+		_error = (int)ESP_OK;
+		return _error;
+	}
+	_invalidateCache(data_id);
+	if(_wb_enabled){
+		if(!_handle){
+			DEBUG_TRACE_W(_EXPR_, _MODULE_, "ERR_HND, Handle nulo en <save>");
+			return (int)err;
+		}
+		if(strlen(data_id) >= NVSInterface_KEY_MAX_SIZE){
+			_error = (int)ESP_ERR_NVS_KEY_TOO_LONG;
+			return _error;
+		}
+		// Fusionamos con la clave pendiente si existe
+		auto it = _findDirty(data_id);
+		if(it == _dirty.end()){
+			if(_dirty.empty()){
+				_wb_since_ms = _now_ms();
+				_wb_sem.release();
+			}
+			_dirty.emplace_back();
+			it = std::prev(_dirty.end());
+			strcpy(it->key, data_id);
+		}
+		uint32_t len = NVSInterface::valueSize(data, size, type);
+		it->type = type;
+		it->data.assign((const uint8_t*)data, (const uint8_t*)data + len);
+		DEBUG_TRACE_D(_EXPR_, _MODULE_, "Id %s pendiente de volcado (%d claves)", data_id, (int)_dirty.size());
+		_error = (int)ESP_OK;
+		if((_now_ms() - _wb_since_ms) >= _wb_delay_ms && _wb_delay_ms > 0){
+			_error = (int)_flushDirty();
+		}
+		return _error;
+	}
+	// Eliminamos la clave antes para obtener ese espacio
+	_removeKey(data_id);
 	if(!_handle){
 		DEBUG_TRACE_W(_EXPR_, _MODULE_, "ERR_HND, Handle nulo en <save>");
 		return (int)err;
 	}
 	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Escribiendo %d datos en id %s...", size, data_id);
-    switch(type){
-    	case NVSInterface::TypeUint8:{
-    		err = nvs_set_u8(_handle, data_id, *(uint8_t*)data);
-    		break;
-    	}
-    	case NVSInterface::TypeInt8:{
-    		err = nvs_set_i8(_handle, data_id, *(int8_t*)data);
-    		break;
-    	}
-    	case NVSInterface::TypeUint16:{
-    		err = nvs_set_u16(_handle, data_id, *(uint16_t*)data);
-    		break;
-    	}
-    	case NVSInterface::TypeInt16:{
-    		err = nvs_set_i16(_handle, data_id, *(int16_t*)data);
-    		break;
-    	}
-    	case NVSInterface::TypeUint32:{
-    		err = nvs_set_u32(_handle, data_id, *(uint32_t*)data);
-    		break;
-    	}
-    	case NVSInterface::TypeInt32:{
-    		err = nvs_set_i32(_handle, data_id, *(int32_t*)data);
-    		break;
-    	}
-    	case NVSInterface::TypeUint64:{
-    		err = nvs_set_u64(_handle, data_id, *(uint64_t*)data);
-    		break;
-    	}
-    	case NVSInterface::TypeInt64:{
-    		err = nvs_set_i64(_handle, data_id, *(int64_t*)data);
-    		break;
-    	}
-    	case NVSInterface::TypeString:{
-    		err = nvs_set_str (_handle, data_id, (const char*)data);
-    		break;
-    	}
-    	case NVSInterface::TypeBlob:{
-    		err = nvs_set_blob(_handle, data_id, data, size);
-    		break;
-    	}
-    	default:{
-    		err = ESP_ERR_INVALID_ARG;
-    		break;
-    	}
-    }
+	err = _nvsSet(data_id, data, size, type);
     if(err != ESP_OK){
     	DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_WR Error [%d] al escribir en id %s", (int)err, data_id);
     	_error = (int)err;
     	return _error;
     }
-    err = nvs_commit(_handle);
+    err = _commit();
     if(err == ESP_OK){
     	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Datos escritos en id %s", data_id);
     	_error = (int)err;
@@ -219,60 +290,66 @@ int FSManager::save(const char* data_id, void* data, uint32_t size, NVSInterface
 
 
 //------------------------------------------------------------------------------------
-int FSManager::restore(const char* data_id, void* data, uint32_t size, NVSInterface::KeyValueType type){
-    #if ESP_PLATFORM == 1
+int FSManager::_restore(const char* data_id, void* data, uint32_t size, NVSInterface::KeyValueType type){
+    #if FSManager_NVS_API == 1
 	esp_err_t err = ESP_ERR_NVS_INVALID_HANDLE;
 	if(!_handle){
 		DEBUG_TRACE_W(_EXPR_, _MODULE_, "ERR_HND, Handle nulo en <restore>");
 		return (int)err;
 	}
 	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Leyendo %d datos de id %s...", size, data_id);
-	switch(type){
-    	case NVSInterface::TypeUint8:{
-    		err = nvs_get_u8(_handle, data_id, (uint8_t*)data);
-    		break;
-    	}
-    	case NVSInterface::TypeInt8:{
-    		err = nvs_get_i8(_handle, data_id, (int8_t*)data);
-    		break;
-    	}
-    	case NVSInterface::TypeUint16:{
-    		err = nvs_get_u16(_handle, data_id, (uint16_t*)data);
-    		break;
-    	}
-    	case NVSInterface::TypeInt16:{
-    		err = nvs_get_i16(_handle, data_id, (int16_t*)data);
-    		break;
-    	}
-    	case NVSInterface::TypeUint32:{
-    		err = nvs_get_u32(_handle, data_id, (uint32_t*)data);
-    		break;
-    	}
-    	case NVSInterface::TypeInt32:{
-    		err = nvs_get_i32(_handle, data_id, (int32_t*)data);
-    		break;
-    	}
-    	case NVSInterface::TypeUint64:{
-    		err = nvs_get_u64(_handle, data_id, (uint64_t*)data);
-    		break;
-    	}
-    	case NVSInterface::TypeInt64:{
-    		err = nvs_get_i64(_handle, data_id, (int64_t*)data);
-    		break;
-    	}
-    	case NVSInterface::TypeString:{
-    		err = nvs_get_str (_handle, data_id, (char*)data, (size_t*)&size);
-    		break;
-    	}
-    	case NVSInterface::TypeBlob:{
-    		err = nvs_get_blob(_handle, data_id, data, (size_t*)&size);
-    		break;
-    	}
-    	default:{
-    		err = ESP_ERR_INVALID_ARG;
-    		break;
-    	}
-    }
+	// Las claves pendientes del modo write-back tienen prioridad sobre NVS
+	auto it = _findDirty(data_id);
+	if(it != _dirty.end()){
+		if(it->type != type){
+			err = ESP_ERR_NVS_TYPE_MISMATCH;
+		}
+		else if((type == NVSInterface::TypeString || type == NVSInterface::TypeBlob) && size < it->data.size()){
+			err = ESP_ERR_NVS_INVALID_LENGTH;
+		}
+		else{
+			memcpy(data, it->data.data(), it->data.size());
+			err = ESP_OK;
+		}
+	}
+	else if(_cache_max_entries > 0){
+		// Consultamos la cache de lectura
+		auto c = _cache.begin();
+		for(; c != _cache.end(); ++c){
+			if(c->type == type && strcmp(c->key, data_id) == 0){
+				break;
+			}
+		}
+		if(c != _cache.end()){
+			_cache_hits++;
+			_cache.splice(_cache.begin(), _cache, c);
+			if((type == NVSInterface::TypeString || type == NVSInterface::TypeBlob) && size < c->data.size()){
+				err = ESP_ERR_NVS_INVALID_LENGTH;
+			}
+			else{
+				memcpy(data, c->data.data(), c->data.size());
+				err = ESP_OK;
+			}
+		}
+		else{
+			_cache_misses++;
+			err = _nvsGet(data_id, data, &size, type);
+			uint32_t len = (err == ESP_OK && data != NULL)? NVSInterface::valueSize(data, size, type) : 0;
+			if(len > 0 && len <= _cache_max_value_size){
+				if(_cache.size() >= _cache_max_entries){
+					_cache.pop_back();
+				}
+				_cache.emplace_front();
+				strncpy(_cache.front().key, data_id, NVSInterface_KEY_MAX_SIZE - 1);
+				_cache.front().key[NVSInterface_KEY_MAX_SIZE - 1] = 0;
+				_cache.front().type = type;
+				_cache.front().data.assign((const uint8_t*)data, (const uint8_t*)data + len);
+			}
+		}
+	}
+	else{
+		err = _nvsGet(data_id, data, &size, type);
+	}
 	_error = (int)err;
     if(err == ESP_OK){
     	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Datos le�dos correctamente de id %s", data_id);
@@ -290,12 +367,25 @@ int FSManager::restore(const char* data_id, void* data, uint32_t size, NVSInterf
 
 //------------------------------------------------------------------------------------
 bool FSManager::checkKey(const char* data_id){
-	#if ESP_PLATFORM == 1
-	uint8_t data=0;
-	auto err = nvs_get_u8(_handle, data_id, (uint8_t*)data);
-	if(err == ESP_ERR_NVS_NOT_FOUND)
+	#if FSManager_NVS_API == 1
+	if(!_handle){
+		DEBUG_TRACE_W(_EXPR_, _MODULE_, "ERR_HND, Handle nulo en <checkKey>");
 		return false;
-	return true;
+	}
+	if(_findDirty(data_id) != _dirty.end()){
+		return true;
+	}
+	// NVS solo localiza la clave si coincide el tipo, por lo que se prueban todos
+	for(int t = NVSInterface::TypeUint8; t < NVSInterface::TypeAny; t++){
+		uint64_t data = 0;
+		uint32_t size = 0;
+		bool scalar = (t != NVSInterface::TypeString && t != NVSInterface::TypeBlob);
+		esp_err_t err = _nvsGet(data_id, scalar? &data : NULL, &size, (NVSInterface::KeyValueType)t);
+		if(err == ESP_OK){
+			return true;
+		}
+	}
+	return false;
 	#elif __MBED__==1
 	//TODO
 	#warning TODO FSManager::checkKey()
@@ -305,21 +395,33 @@ bool FSManager::checkKey(const char* data_id){
 
 
 //------------------------------------------------------------------------------------
-int FSManager::removeKey(const char* data_id){
-	#if ESP_PLATFORM == 1
+int FSManager::_removeKey(const char* data_id){
+	#if FSManager_NVS_API == 1
 	esp_err_t err = ESP_ERR_NVS_INVALID_HANDLE;
 	if(!_handle){
 		DEBUG_TRACE_W(_EXPR_, _MODULE_, "ERR_HND, Handle nulo en <save>");
 		return (int)err;
 	}
+	_invalidateCache(data_id);
+	// Descartamos la clave si estaba pendiente de volcado
+	bool dirty = false;
+	auto it = _findDirty(data_id);
+	if(it != _dirty.end()){
+		_dirty.erase(it);
+		dirty = true;
+	}
 	err = nvs_erase_key(_handle, data_id);
+	if(err == ESP_ERR_NVS_NOT_FOUND && dirty){
+		_error = (int)ESP_OK;
+		return _error;
+	}
 	if(err != ESP_OK){
     	DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_WR Error [%d] al eliminar en id %s", (int)err, data_id);
     	_error = (int)err;
     	return _error;
     }
 
-	err = nvs_commit(_handle);
+	err = _commit();
 	if(err == ESP_OK){
 		DEBUG_TRACE_D(_EXPR_, _MODULE_, "Datos borrados en id %s", data_id);
 		_error = (int)err;
@@ -336,10 +438,125 @@ int FSManager::removeKey(const char* data_id){
 #endif
 }
 
+//------------------------------------------------------------------------------------
+int FSManager::saveBatch(NVSInterface::KeyValueEntry* entries, uint32_t count){
+	#if FSManager_NVS_API == 1
+	esp_err_t err = ESP_ERR_NVS_INVALID_HANDLE;
+	if(!_handle){
+		DEBUG_TRACE_W(_EXPR_, _MODULE_, "ERR_HND, Handle nulo en <saveBatch>");
+		return (int)err;
+	}
+	if(count == 0){
+		return 0;
+	}
+	// En modo write-back las claves solo se actualizan en RAM
+	if(_wb_enabled){
+		return NVSInterface::saveBatch(entries, count);
+	}
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Escribiendo bloque de %d claves...", count);
+	// Guardamos los valores previos con el tipo con el que estan almacenados, que puede diferir del nuevo
+	struct Backup{
+		NVSInterface::KeyValueType type;
+		std::vector<uint8_t> data;
+	};
+	std::vector<Backup> backup(count);
+	for(uint32_t i=0; i<count; i++){
+		if(_nvsFindType(entries[i].data_id, &backup[i].type) != ESP_OK || _nvsReadValue(entries[i].data_id, backup[i].type, backup[i].data) != ESP_OK){
+			backup[i].type = NVSInterface::TypeAny;
+		}
+		_invalidateCache(entries[i].data_id);
+	}
+	uint32_t written = 0;
+	for(; written<count; written++){
+		err = _nvsSet(entries[written].data_id, entries[written].data, entries[written].size, entries[written].type);
+		if(err != ESP_OK){
+			DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_WR Error [%d] al escribir en id %s", (int)err, entries[written].data_id);
+			break;
+		}
+	}
+	if(err == ESP_OK){
+		err = _commit();
+		if(err == ESP_OK){
+			_error = 0;
+			return _error;
+		}
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_COMMIT Error [%d] al escribir bloque de claves", (int)err);
+		written = count - 1;
+	}
+	// Deshacemos en orden inverso para que prevalezca el valor original de claves repetidas. Se elimina primero
+	// lo escrito, sea cual sea su tipo, y se restaura el valor previo con su tipo original. Solo se recorren las
+	// entradas intentadas: las escritas y la que ha fallado
+	for(int32_t i=((written < count)? written : count - 1); i>=0; i--){
+		int erased = 0;
+		while(erased < NVSInterface::TypeAny && nvs_erase_key(_handle, entries[i].data_id) == ESP_OK){
+			erased++;
+		}
+		if(backup[i].type != NVSInterface::TypeAny){
+			_nvsSet(entries[i].data_id, backup[i].data.data(), backup[i].data.size(), backup[i].type);
+		}
+	}
+	_commit();
+	_error = (int)err;
+	return _error;
+	#elif __MBED__==1
+	//TODO
+	#warning TODO FSManager::saveBatch()
+	return -1;
+	#endif
+}
+
+
+//------------------------------------------------------------------------------------
+int FSManager::forEachKey(const char* prefix, NVSInterface::KeyValueType type, Callback<bool(const NVSInterface::KeyInfo&)> visitor){
+	#if FSManager_NVS_API == 1
+	if(!_handle){
+		DEBUG_TRACE_W(_EXPR_, _MODULE_, "ERR_HND, Handle nulo en <forEachKey>");
+		return (int)ESP_ERR_NVS_INVALID_HANDLE;
+	}
+	size_t prefix_len = (prefix)? strlen(prefix) : 0;
+	NVSInterface::KeyInfo info;
+	nvs_entry_info_t entry;
+	int count = 0;
+	nvs_iterator_t it = nvs_entry_find(DEFAULT_NVSInterface_Partition, _name, _nvs_types[type]);
+	while(it != NULL){
+		nvs_entry_info(it, &entry);
+		if(prefix_len == 0 || strncmp(entry.key, prefix, prefix_len) == 0){
+			strcpy(info.key, entry.key);
+			info.type = NVSInterface::TypeAny;
+			for(int t = NVSInterface::TypeUint8; t < NVSInterface::TypeAny; t++){
+				if(_nvs_types[t] == entry.type){
+					info.type = (NVSInterface::KeyValueType)t;
+					break;
+				}
+			}
+			// Las cadenas y blobs requieren consultar su longitud
+			info.size = NVSInterface::valueSize(NULL, 0, info.type);
+			if(info.type == NVSInterface::TypeString || info.type == NVSInterface::TypeBlob){
+				_nvsGet(info.key, NULL, &info.size, info.type);
+			}
+			count++;
+			if(!visitor.call(info)){
+				nvs_release_iterator(it);
+				return count;
+			}
+		}
+		it = nvs_entry_next(it);
+	}
+	return count;
+	#elif __MBED__==1
+	//TODO
+	#warning TODO FSManager::forEachKey()
+	return -1;
+	#endif
+}
+
+
 //------------------------------------------------------------------------------------
 bool FSManager::erase(){
-	#if ESP_PLATFORM == 1
+	#if FSManager_NVS_API == 1
 	_mtx.lock();
+	_dirty.clear();
+	_cache.clear();
 	esp_err_t err = nvs_flash_erase_partition(DEFAULT_NVSInterface_Partition);
 	if (err != ESP_OK) {
 		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_ERASE [%d] al abrir el sistema NVS", err);
@@ -358,3 +575,523 @@ bool FSManager::erase(){
     #endif
 }
 
+
+//------------------------------------------------------------------------------------
+void FSManager::setWriteBack(bool enable, uint32_t flush_delay_ms){
+	_mtx.lock();
+	_wb_delay_ms = flush_delay_ms;
+	_wb_enabled = enable;
+	_mtx.unlock();
+	// con retardo, el volcado al vencer no depende de que se realicen nuevas operaciones
+	if(enable && flush_delay_ms > 0){
+		if(!_wb_th){
+			_wb_stop = false;
+			_wb_th = new Thread(osPriorityBelowNormal, FSManager_WB_STACK_SIZE, NULL, "FSWriteBack");
+			MBED_ASSERT(_wb_th);
+			if(_wb_th->start(callback(this, &FSManager::_wbTask)) != osOK){
+				DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_THREAD, No se puede arrancar el thread de volcado");
+				delete(_wb_th);
+				_wb_th = NULL;
+			}
+		}
+		// se recalcula el instante de volcado con el nuevo retardo
+		_wb_sem.release();
+	}
+	else{
+		_stopWriteBackTask();
+	}
+	// al desactivar el modo, se vuelcan las claves pendientes
+	if(!enable){
+		flush();
+	}
+}
+
+
+//------------------------------------------------------------------------------------
+int FSManager::flush(){
+	#if FSManager_NVS_API == 1
+	_mtx.lock();
+	if(_dirty.empty()){
+		_mtx.unlock();
+		return (int)ESP_OK;
+	}
+	// si no hay sesion abierta, se abre una para el volcado
+	bool own_session = (_handle == 0);
+	if(own_session && !open()){
+		_mtx.unlock();
+		return (int)ESP_ERR_NVS_INVALID_HANDLE;
+	}
+	esp_err_t err = _flushDirty();
+	if(own_session){
+		close();
+	}
+	_mtx.unlock();
+	return (int)err;
+	#elif __MBED__==1
+	//TODO
+	#warning TODO FSManager::flush()
+	return -1;
+	#endif
+}
+
+
+//------------------------------------------------------------------------------------
+void FSManager::setReadCache(uint16_t max_entries, uint16_t max_value_size){
+	_mtx.lock();
+	_cache_max_entries = max_entries;
+	_cache_max_value_size = max_value_size;
+	_cache.clear();
+	_cache_hits = 0;
+	_cache_misses = 0;
+	_mtx.unlock();
+}
+
+
+//------------------------------------------------------------------------------------
+int FSManager::startAsync(uint16_t queue_size, uint32_t stack_size, osPriority priority){
+	if(_async_th){
+		return 0;
+	}
+	_async_max = queue_size;
+	_async_stop = false;
+	_async_th = new Thread(priority, stack_size, NULL, "FSAsync");
+	MBED_ASSERT(_async_th);
+	if(_async_th->start(callback(this, &FSManager::_asyncTask)) != osOK){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_THREAD, No se puede arrancar el thread escritor");
+		delete(_async_th);
+		_async_th = NULL;
+		return -1;
+	}
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Modo asincrono iniciado");
+	return 0;
+}
+
+
+//------------------------------------------------------------------------------------
+void FSManager::stopAsync(){
+	if(!_async_th){
+		return;
+	}
+	drain();
+	_async_stop = true;
+	_async_sem.release();
+	_async_th->join();
+	delete(_async_th);
+	_async_th = NULL;
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Modo asincrono detenido");
+}
+
+
+//------------------------------------------------------------------------------------
+int FSManager::saveAsync(const char* data_id, const void* data, uint32_t size, NVSInterface::KeyValueType type, Callback<void(const char*, int)> done){
+	if(!_async_th){
+		DEBUG_TRACE_W(_EXPR_, _MODULE_, "ERR_ASYNC, Modo asincrono no iniciado en <saveAsync>");
+		return -1;
+	}
+	if(strlen(data_id) >= NVSInterface_KEY_MAX_SIZE){
+		return -1;
+	}
+	uint32_t len = NVSInterface::valueSize(data, size, type);
+	_async_mtx.lock();
+	// Si la clave ya esta encolada, se sustituye su valor
+	auto it = _async_pending.begin();
+	for(; it != _async_pending.end(); ++it){
+		if(strcmp(it->key, data_id) == 0){
+			break;
+		}
+	}
+	if(it == _async_pending.end()){
+		if(_async_pending.size() >= _async_max){
+			_async_mtx.unlock();
+			DEBUG_TRACE_W(_EXPR_, _MODULE_, "ERR_FULL, Cola asincrona llena, id %s descartado", data_id);
+			return -1;
+		}
+		_async_pending.emplace_back();
+		it = std::prev(_async_pending.end());
+		strcpy(it->key, data_id);
+	}
+	else if(it->tokens.size() >= FSManager_ASYNC_MAX_MERGED){
+		_async_mtx.unlock();
+		DEBUG_TRACE_W(_EXPR_, _MODULE_, "ERR_FULL, Clave asincrona saturada, id %s descartado", data_id);
+		return -1;
+	}
+	it->type = type;
+	it->data.assign((const uint8_t*)data, (const uint8_t*)data + len);
+	if(done){
+		it->done.push_back(done);
+	}
+	int token = (int)(++_async_token);
+	it->tokens.push_back((uint32_t)token);
+	_async_mtx.unlock();
+	_async_sem.release();
+	return token;
+}
+
+
+//------------------------------------------------------------------------------------
+int FSManager::getAsyncResult(int token){
+	int result = -1;
+	_async_mtx.lock();
+	if(token > 0 && (uint32_t)token >= _async_known_token && (uint32_t)token <= _async_token){
+		if((uint32_t)token > _async_done_token){
+			result = 1;
+		}
+		else if(_async_failed.find((uint32_t)token) == _async_failed.end()){
+			result = 0;
+		}
+	}
+	_async_mtx.unlock();
+	return result;
+}
+
+
+//------------------------------------------------------------------------------------
+int FSManager::drain(uint32_t timeout_ms){
+	static const uint32_t PollIntervalMs = 10;
+	uint32_t elapsed = 0;
+	for(;;){
+		_async_mtx.lock();
+		bool idle = _async_pending.empty() && !_async_busy;
+		_async_mtx.unlock();
+		if(idle){
+			return 0;
+		}
+		if(timeout_ms != osWaitForever && elapsed >= timeout_ms){
+			return -1;
+		}
+		ThisThread::sleep_for(PollIntervalMs);
+		elapsed += PollIntervalMs;
+	}
+}
+
+
+//------------------------------------------------------------------------------------
+void FSManager::getStats(StorageOpStats* stats){
+	#if StorageStats_ENABLED == 1
+	_stats.snapshot(stats);
+	#else
+	memset(stats, 0, StatCount * sizeof(StorageOpStats));
+	#endif
+}
+
+
+//------------------------------------------------------------------------------------
+void FSManager::resetStats(){
+	#if StorageStats_ENABLED == 1
+	_stats.reset();
+	#endif
+}
+
+
+//------------------------------------------------------------------------------------
+//-- PRIVATE METHODS IMPLEMENTATION --------------------------------------------------
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+void FSManager::_asyncTask(){
+	for(;;){
+		_async_sem.wait(osWaitForever);
+		// Se extraen todas las escrituras pendientes, liberando la cola para los productores
+		std::list<AsyncRequest> batch;
+		_async_mtx.lock();
+		batch.swap(_async_pending);
+		uint32_t last_token = _async_token;
+		_async_busy = !batch.empty();
+		_async_mtx.unlock();
+		if(batch.empty()){
+			if(_async_stop){
+				return;
+			}
+			continue;
+		}
+		std::vector<NVSInterface::KeyValueEntry> entries;
+		entries.reserve(batch.size());
+		for(auto it = batch.begin(); it != batch.end(); ++it){
+			NVSInterface::KeyValueEntry e = {it->key, it->type, it->data.data(), (uint32_t)it->data.size()};
+			entries.push_back(e);
+		}
+		DEBUG_TRACE_D(_EXPR_, _MODULE_, "Aplicando %d escrituras asincronas", (int)entries.size());
+		std::vector<int> results(entries.size(), -1);
+		if(open()){
+			int err = saveBatch(entries.data(), entries.size());
+			for(uint32_t i = 0; i < entries.size(); i++){
+				// si el bloque falla, se reintenta cada clave por separado para obtener su resultado
+				results[i] = (err == 0)? 0 : save(entries[i].data_id, entries[i].data, entries[i].size, entries[i].type);
+			}
+			close();
+		}
+		// se publican los resultados antes de notificar, acotando el registro de errores
+		_async_mtx.lock();
+		uint32_t i = 0;
+		for(auto it = batch.begin(); it != batch.end(); ++it, ++i){
+			if(results[i] != 0){
+				_async_failed.insert(it->tokens.begin(), it->tokens.end());
+			}
+		}
+		while(_async_failed.size() > _async_max){
+			// los tokens hasta el error descartado pasan a tener resultado desconocido
+			_async_known_token = *_async_failed.begin() + 1;
+			_async_failed.erase(_async_failed.begin());
+		}
+		_async_done_token = last_token;
+		_async_mtx.unlock();
+		i = 0;
+		for(auto it = batch.begin(); it != batch.end(); ++it, ++i){
+			for(auto cb = it->done.begin(); cb != it->done.end(); ++cb){
+				cb->call(it->key, results[i]);
+			}
+		}
+		_async_mtx.lock();
+		_async_busy = false;
+		_async_mtx.unlock();
+	}
+}
+
+
+//------------------------------------------------------------------------------------
+void FSManager::_wbTask(){
+	uint32_t wait_ms = osWaitForever;
+	for(;;){
+		_wb_sem.wait(wait_ms);
+		if(_wb_stop){
+			return;
+		}
+		// el mutex espera a que finalice la sesion abierta por otro thread
+		_mtx.lock();
+		if(_wb_enabled && _wb_delay_ms > 0 && !_dirty.empty() && (_now_ms() - _wb_since_ms) >= _wb_delay_ms){
+			flush();
+		}
+		// siguiente vencimiento, si quedan claves pendientes
+		wait_ms = osWaitForever;
+		if(_wb_enabled && _wb_delay_ms > 0 && !_dirty.empty()){
+			uint64_t age = _now_ms() - _wb_since_ms;
+			wait_ms = (age < _wb_delay_ms)? (uint32_t)(_wb_delay_ms - age) : 1;
+		}
+		_mtx.unlock();
+	}
+}
+
+
+//------------------------------------------------------------------------------------
+void FSManager::_stopWriteBackTask(){
+	if(!_wb_th){
+		return;
+	}
+	_wb_stop = true;
+	_wb_sem.release();
+	_wb_th->join();
+	delete(_wb_th);
+	_wb_th = NULL;
+}
+
+
+//------------------------------------------------------------------------------------
+void FSManager::_invalidateCache(const char* data_id){
+	for(auto it = _cache.begin(); it != _cache.end();){
+		if(strcmp(it->key, data_id) == 0){
+			it = _cache.erase(it);
+			continue;
+		}
+		++it;
+	}
+}
+
+
+#if FSManager_NVS_API == 1
+//------------------------------------------------------------------------------------
+esp_err_t FSManager::_nvsSet(const char* data_id, const void* data, uint32_t size, NVSInterface::KeyValueType type){
+    switch(type){
+    	case NVSInterface::TypeUint8:
+    		return nvs_set_u8(_handle, data_id, *(const uint8_t*)data);
+    	case NVSInterface::TypeInt8:
+    		return nvs_set_i8(_handle, data_id, *(const int8_t*)data);
+    	case NVSInterface::TypeUint16:
+    		return nvs_set_u16(_handle, data_id, *(const uint16_t*)data);
+    	case NVSInterface::TypeInt16:
+    		return nvs_set_i16(_handle, data_id, *(const int16_t*)data);
+    	case NVSInterface::TypeUint32:
+    		return nvs_set_u32(_handle, data_id, *(const uint32_t*)data);
+    	case NVSInterface::TypeInt32:
+    		return nvs_set_i32(_handle, data_id, *(const int32_t*)data);
+    	case NVSInterface::TypeUint64:
+    		return nvs_set_u64(_handle, data_id, *(const uint64_t*)data);
+    	case NVSInterface::TypeInt64:
+    		return nvs_set_i64(_handle, data_id, *(const int64_t*)data);
+    	case NVSInterface::TypeString:
+    		return nvs_set_str(_handle, data_id, (const char*)data);
+    	case NVSInterface::TypeBlob:
+    		return nvs_set_blob(_handle, data_id, data, size);
+    	default:
+    		return ESP_ERR_INVALID_ARG;
+    }
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t FSManager::_nvsGet(const char* data_id, void* data, uint32_t* size, NVSInterface::KeyValueType type){
+	size_t len = *size;
+	esp_err_t err;
+	switch(type){
+    	case NVSInterface::TypeUint8:
+    		return nvs_get_u8(_handle, data_id, (uint8_t*)data);
+    	case NVSInterface::TypeInt8:
+    		return nvs_get_i8(_handle, data_id, (int8_t*)data);
+    	case NVSInterface::TypeUint16:
+    		return nvs_get_u16(_handle, data_id, (uint16_t*)data);
+    	case NVSInterface::TypeInt16:
+    		return nvs_get_i16(_handle, data_id, (int16_t*)data);
+    	case NVSInterface::TypeUint32:
+    		return nvs_get_u32(_handle, data_id, (uint32_t*)data);
+    	case NVSInterface::TypeInt32:
+    		return nvs_get_i32(_handle, data_id, (int32_t*)data);
+    	case NVSInterface::TypeUint64:
+    		return nvs_get_u64(_handle, data_id, (uint64_t*)data);
+    	case NVSInterface::TypeInt64:
+    		return nvs_get_i64(_handle, data_id, (int64_t*)data);
+    	case NVSInterface::TypeString:
+    		err = nvs_get_str(_handle, data_id, (char*)data, &len);
+    		*size = len;
+    		return err;
+    	case NVSInterface::TypeBlob:
+    		err = nvs_get_blob(_handle, data_id, data, &len);
+    		*size = len;
+    		return err;
+    	default:
+    		return ESP_ERR_INVALID_ARG;
+    }
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t FSManager::_nvsReadValue(const char* data_id, NVSInterface::KeyValueType type, std::vector<uint8_t>& value){
+	uint32_t size = NVSInterface::valueSize(NULL, 0, type);
+	esp_err_t err;
+	if(type == NVSInterface::TypeString || type == NVSInterface::TypeBlob){
+		// consultamos primero la longitud almacenada
+		err = _nvsGet(data_id, NULL, &size, type);
+		if(err != ESP_OK){
+			return err;
+		}
+	}
+	value.resize(size);
+	err = _nvsGet(data_id, value.data(), &size, type);
+	value.resize(size);
+	return err;
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t FSManager::_nvsFindType(const char* data_id, NVSInterface::KeyValueType* type){
+	nvs_entry_info_t entry;
+	nvs_iterator_t it = nvs_entry_find(DEFAULT_NVSInterface_Partition, _name, NVS_TYPE_ANY);
+	while(it != NULL){
+		nvs_entry_info(it, &entry);
+		if(strcmp(entry.key, data_id) == 0){
+			nvs_release_iterator(it);
+			for(int t = NVSInterface::TypeUint8; t < NVSInterface::TypeAny; t++){
+				if(_nvs_types[t] == entry.type){
+					*type = (NVSInterface::KeyValueType)t;
+					return ESP_OK;
+				}
+			}
+			return ESP_ERR_NVS_TYPE_MISMATCH;
+		}
+		it = nvs_entry_next(it);
+	}
+	return ESP_ERR_NVS_NOT_FOUND;
+}
+
+
+//------------------------------------------------------------------------------------
+bool FSManager::_isUnchanged(const char* data_id, const void* data, uint32_t size, NVSInterface::KeyValueType type){
+	uint32_t len = NVSInterface::valueSize(data, size, type);
+	auto it = _findDirty(data_id);
+	if(it != _dirty.end()){
+		return (it->type == type && it->data.size() == len && memcmp(it->data.data(), data, len) == 0);
+	}
+	for(auto c = _cache.begin(); c != _cache.end(); ++c){
+		if(c->type == type && strcmp(c->key, data_id) == 0){
+			return (c->data.size() == len && memcmp(c->data.data(), data, len) == 0);
+		}
+	}
+	// Los escalares se comparan sin reservar memoria
+	if(type != NVSInterface::TypeString && type != NVSInterface::TypeBlob){
+		uint64_t stored = 0;
+		uint32_t stored_size = len;
+		if(_nvsGet(data_id, &stored, &stored_size, type) != ESP_OK){
+			return false;
+		}
+		return (memcmp(&stored, data, len) == 0);
+	}
+	// En cadenas y blobs se compara primero la longitud y despues el contenido
+	uint32_t stored_size = 0;
+	if(_nvsGet(data_id, NULL, &stored_size, type) != ESP_OK || stored_size != len){
+		return false;
+	}
+	std::vector<uint8_t> stored;
+	if(_nvsReadValue(data_id, type, stored) != ESP_OK){
+		return false;
+	}
+	return (stored.size() == len && memcmp(stored.data(), data, len) == 0);
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t FSManager::_commit(){
+	esp_err_t err = nvs_commit(_handle);
+	_commits++;
+	return err;
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t FSManager::_flushDirty(){
+	if(!_handle){
+		DEBUG_TRACE_W(_EXPR_, _MODULE_, "ERR_HND, Handle nulo en <flush>");
+		return ESP_ERR_NVS_INVALID_HANDLE;
+	}
+	if(_dirty.empty()){
+		return ESP_OK;
+	}
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Volcando %d claves pendientes...", (int)_dirty.size());
+	esp_err_t err = ESP_OK;
+	std::vector<std::list<DirtyKey>::iterator> written;
+	// las claves que fallan permanecen pendientes para el siguiente volcado
+	for(auto it = _dirty.begin(); it != _dirty.end(); ++it){
+		esp_err_t e = _nvsSet(it->key, it->data.data(), it->data.size(), it->type);
+		if(e != ESP_OK){
+			DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_WR Error [%d] al volcar id %s", (int)e, it->key);
+			err = e;
+			continue;
+		}
+		written.push_back(it);
+	}
+	// las claves escritas solo dejan de estar pendientes si el commit es correcto
+	if(!written.empty()){
+		esp_err_t e = _commit();
+		if(e != ESP_OK){
+			DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_COMMIT Error [%d] al volcar claves pendientes", (int)e);
+			err = e;
+		}
+		else{
+			for(auto it = written.begin(); it != written.end(); ++it){
+				_dirty.erase(*it);
+			}
+		}
+	}
+	_wb_since_ms = _now_ms();
+	_error = (int)err;
+	return err;
+}
+
+
+//------------------------------------------------------------------------------------
+std::list<FSManager::DirtyKey>::iterator FSManager::_findDirty(const char* data_id){
+	for(auto it = _dirty.begin(); it != _dirty.end(); ++it){
+		if(strcmp(it->key, data_id) == 0){
+			return it;
+		}
+	}
+	return _dirty.end();
+}
+#endif
@@ -19,8 +19,18 @@
 #include "mbed.h"
 #include "Heap.h"
 #include "NVSInterface.h"
+#include "StorageStats.h"
+#include <list>
+#include <set>
+#include <vector>
 #if ESP_PLATFORM == 1
 #include "FATInterface.h"
+#define FSManager_NVS_API	1
+#else
+#include "NVSFlashSim.h"
+#if NVSFlashSim_ENABLED == 1
+#define FSManager_NVS_API	1
+#endif
 #endif
 #if __MBED__==1
 #include "mdf_api_cortex.h"
@@ -30,6 +40,12 @@
 
 #define FSManager_DEBUG		1
 
+/** Tamanio de pila del thread de volcado diferido del modo write-back */
+#define FSManager_WB_STACK_SIZE		4096
+
+/** Numero maximo de peticiones de <saveAsync> fusionadas sobre una misma clave pendiente */
+#define FSManager_ASYNC_MAX_MERGED	8
+
 
 class FSManager : public NVSInterface{
 
@@ -48,6 +64,9 @@ class FSManager : public NVSInterface{
      */
     FSManager(const char *name, PinName32 mosi=NC, PinName32 miso=NC, PinName32 sclk=NC, PinName32 csel=NC, int freq=0, bool defdbg = false);
     virtual ~FSManager(){
+    	stopAsync();
+    	_stopWriteBackTask();
+    	flush();
     	_static_instance = NULL;
     }
   
@@ -106,6 +125,11 @@ class FSManager : public NVSInterface{
     virtual int restore(const char* data_id, void* data, uint32_t size, NVSInterface::KeyValueType type);
 
 
+    /** Variantes tipadas de <save> y <restore> definidas en NVSInterface */
+    using NVSInterface::save;
+    using NVSInterface::restore;
+
+
     /** checkKey
      *  Chequea si una clave existe
      *  @param data_id Identificador de la clave
@@ -120,6 +144,28 @@ class FSManager : public NVSInterface{
      *  @return cdigo de error
      */
     virtual int removeKey(const char* data_id);
+
+
+    /** saveBatch
+     *  Graba un conjunto de claves en la sesion abierta con un unico nvs_commit. La operacion es atomica: si
+     *  falla la escritura de alguna clave o el commit, se restauran los valores previos, con su tipo original.
+     *  @param entries Array de entradas a grabar
+     *  @param count Numero de entradas
+     *  @return codigo de error
+     */
+    virtual int saveBatch(NVSInterface::KeyValueEntry* entries, uint32_t count);
+
+
+    /** forEachKey
+     *  Recorre las claves del espacio de nombres en la sesion abierta mediante el iterador de entradas de NVS,
+     *  filtrando por prefijo y tipo. Las claves pendientes del modo write-back no se incluyen hasta su volcado.
+     *  @param prefix Prefijo de las claves a recorrer (NULL o "" para todas)
+     *  @param type Tipo de las claves a recorrer (TypeAny para todos)
+     *  @param visitor Callback invocada por cada clave. Si devuelve false se detiene el recorrido
+     *  @return Numero de claves visitadas o codigo de error (<0)
+     */
+    virtual int forEachKey(const char* prefix, NVSInterface::KeyValueType type, Callback<bool(const NVSInterface::KeyInfo&)> visitor);
+
     /**
      * Devuelve la instancia esttica
      * @return
@@ -131,6 +177,143 @@ class FSManager : public NVSInterface{
      * */
     virtual bool erase();
 
+
+    /** setWriteBack
+     *  Activa o desactiva el modo write-back. En este modo <save> mantiene las claves modificadas en RAM,
+     *  fusionando escrituras repetidas sobre una misma clave, y las vuelca a NVS con un unico nvs_commit
+     *  en <close>, en <flush> o al vencer el retardo configurado. Con retardo, un thread de volcado realiza el
+     *  volcado al vencer aunque no haya nuevas operaciones, esperando a que finalice la sesion en curso.
+     *  @param enable Flag para activar o desactivar el modo write-back
+     *  @param flush_delay_ms Tiempo (ms) que las claves permanecen en RAM antes de volcarse. Con 0 se vuelcan en
+     *         cada <close>, sin thread de volcado
+     */
+    void setWriteBack(bool enable, uint32_t flush_delay_ms = 0);
+
+
+    /** flush
+     *  Vuelca a NVS las claves pendientes del modo write-back con un unico nvs_commit. Puede invocarse
+     *  dentro o fuera de una sesion <open>/<close>
+     *  @return codigo de error
+     */
+    virtual int flush();
+
+
+    /** getCommitCount
+     *  Obtiene el numero de nvs_commit realizados desde el arranque
+     *  @return Numero de commits
+     */
+    uint32_t getCommitCount() { return _commits; }
+
+
+    /** setReadCache
+     *  Configura la cache de lectura LRU situada delante de <restore>. Las lecturas repetidas de una misma clave
+     *  y tipo se sirven desde RAM. <save> y <removeKey> invalidan la clave y <erase> vacia la cache.
+     *  @param max_entries Numero maximo de claves en cache. Con 0 se desactiva la cache
+     *  @param max_value_size Tamanio maximo (bytes) de un valor para ser cacheado
+     */
+    void setReadCache(uint16_t max_entries, uint16_t max_value_size = 64);
+
+
+    /** getReadCacheStats
+     *  Obtiene las estadisticas de la cache de lectura
+     *  @param hits Recibe el numero de lecturas servidas desde la cache
+     *  @param misses Recibe el numero de lecturas que han requerido acceso a NVS
+     */
+    void getReadCacheStats(uint32_t* hits, uint32_t* misses) { *hits = _cache_hits; *misses = _cache_misses; }
+
+
+    /** getSuppressedWrites
+     *  Obtiene el numero de escrituras descartadas por <save> al coincidir con el valor ya almacenado
+     *  @return Numero de escrituras suprimidas
+     */
+    uint32_t getSuppressedWrites() { return _suppressed_writes; }
+
+
+    /** StatOp
+     *  Operaciones instrumentadas en <getStats>
+     */
+    enum StatOp{
+    	StatSave,
+    	StatRestore,
+    	StatRemoveKey,
+    	StatOpen,
+    	StatClose,
+    	StatCount
+    };
+
+
+    /** getStats
+     *  Obtiene las estadisticas de cada operacion: invocaciones, bytes, errores e histogramas de latencia
+     *  de espera del mutex y de E/S. Si la instrumentacion esta desactivada (StorageStats_ENABLED=0) se devuelven
+     *  a cero.
+     *  @param stats Array de StatCount elementos que recibe las estadisticas, indexado por StatOp
+     */
+    void getStats(StorageOpStats* stats);
+
+
+    /** resetStats
+     *  Reinicia las estadisticas de las operaciones
+     */
+    void resetStats();
+
+
+    /** startAsync
+     *  Arranca el modo de escritura asincrona. Las escrituras encoladas con <saveAsync> se aplican desde un thread
+     *  escritor dedicado, agrupando en una sesion y un unico nvs_commit todas las pendientes.
+     *  @param queue_size Numero maximo de claves pendientes de escritura
+     *  @param stack_size Tamanio de la pila del thread escritor
+     *  @param priority Prioridad del thread escritor
+     *  @return codigo de error
+     */
+    int startAsync(uint16_t queue_size = 32, uint32_t stack_size = 4096, osPriority priority = osPriorityBelowNormal);
+
+
+    /** stopAsync
+     *  Vuelca las escrituras pendientes y detiene el thread escritor
+     */
+    void stopAsync();
+
+
+    /** saveAsync
+     *  Encola una escritura sin bloquear al llamante en el acceso a flash. Si la clave ya estaba pendiente, se
+     *  sustituye su valor por el nuevo y ambas peticiones se completan con la misma escritura, hasta un maximo de
+     *  FSManager_ASYNC_MAX_MERGED peticiones por clave.
+     *  @param data_id Identificador de los datos a grabar
+     *  @param data Puntero a los datos (se copian al encolar)
+     *  @param size Tamanio de los datos en bytes
+     *  @param type tipo de dato
+     *  @param done Callback invocada desde el thread escritor con la clave y el resultado de la escritura
+     *  @return Token de la peticion (>0) o codigo de error (<0) si la cola o la clave estan llenas o el modo no
+     *          esta activo
+     */
+    int saveAsync(const char* data_id, const void* data, uint32_t size, NVSInterface::KeyValueType type, Callback<void(const char*, int)> done = Callback<void(const char*, int)>());
+
+
+    /** isCompleted
+     *  Chequea si una peticion de <saveAsync> se ha completado correctamente
+     *  @param token Token devuelto por <saveAsync>
+     *  @return true si ya se ha escrito sin errores
+     */
+    bool isCompleted(int token) { return (getAsyncResult(token) == 0); }
+
+
+    /** getAsyncResult
+     *  Obtiene el estado de una peticion de <saveAsync>. Se recuerdan los errores de las ultimas <queue_size>
+     *  peticiones fallidas; las peticiones anteriores a la fallida mas antigua conservada tienen estado desconocido.
+     *  @param token Token devuelto por <saveAsync>
+     *  @return 1 si esta pendiente, 0 si se ha escrito, -1 si ha fallado, el token no es valido o su resultado ya
+     *          no se conserva
+     */
+    int getAsyncResult(int token);
+
+
+    /** drain
+     *  Bloquea al llamante hasta que se hayan aplicado todas las escrituras pendientes
+     *  @param timeout_ms Tiempo maximo de espera
+     *  @return 0 si la cola se ha vaciado, <0 si vence el tiempo de espera
+     */
+    int drain(uint32_t timeout_ms = osWaitForever);
+
 protected:
 
 	/** Flag para habilitar trazas de depuracin por defecto */
@@ -145,13 +328,190 @@ private:
 	// const char* _name;          /// Nombre del sistema de ficheros
 	// int _error;                 /// ltimo error registrado
 
-	#if ESP_PLATFORM == 1
+	#if FSManager_NVS_API == 1
 	nvs_handle _handle;
 	#endif
 
 	/** Flag para indicar el estado del componente */
 	bool _ready;
 
+	/** Clave pendiente de volcado en modo write-back */
+	struct DirtyKey{
+		char key[NVSInterface_KEY_MAX_SIZE];
+		NVSInterface::KeyValueType type;
+		std::vector<uint8_t> data;
+	};
+
+	/** Claves pendientes de volcado en modo write-back */
+	std::list<DirtyKey> _dirty;
+
+	/** Flag para indicar si el modo write-back esta activo */
+	bool _wb_enabled;
+
+	/** Retardo minimo de volcado en modo write-back (ms) */
+	uint32_t _wb_delay_ms;
+
+	/** Instante en el que se marco la primera clave pendiente (ms) */
+	uint64_t _wb_since_ms;
+
+	/** Thread de volcado diferido del modo write-back */
+	Thread* _wb_th;
+
+	/** Semaforo para despertar al thread de volcado al marcar la primera clave pendiente */
+	Semaphore _wb_sem;
+
+	/** Flag de control del thread de volcado */
+	bool _wb_stop;
+
+	/** Tarea del thread de volcado */
+	void _wbTask();
+
+	/** Detiene el thread de volcado si esta en marcha */
+	void _stopWriteBackTask();
+
+	/** Contador de nvs_commit realizados */
+	uint32_t _commits;
+
+	/** Clave almacenada en la cache de lectura */
+	struct CachedKey{
+		char key[NVSInterface_KEY_MAX_SIZE];
+		NVSInterface::KeyValueType type;
+		std::vector<uint8_t> data;
+	};
+
+	/** Cache de lectura ordenada de mas a menos reciente */
+	std::list<CachedKey> _cache;
+
+	/** Numero maximo de claves en la cache de lectura */
+	uint16_t _cache_max_entries;
+
+	/** Tamanio maximo de un valor cacheado */
+	uint16_t _cache_max_value_size;
+
+	/** Estadisticas de la cache de lectura */
+	uint32_t _cache_hits;
+	uint32_t _cache_misses;
+
+	/** Contador de escrituras suprimidas por coincidir con el valor almacenado */
+	uint32_t _suppressed_writes;
+
+	/** Escritura pendiente del modo asincrono */
+	struct AsyncRequest{
+		char key[NVSInterface_KEY_MAX_SIZE];
+		NVSInterface::KeyValueType type;
+		std::vector<uint8_t> data;
+		std::vector<Callback<void(const char*, int)> > done;
+		std::vector<uint32_t> tokens;
+	};
+
+	/** Escrituras pendientes del modo asincrono */
+	std::list<AsyncRequest> _async_pending;
+
+	/** Mutex de acceso a la cola de escrituras asincronas, independiente del acceso a NVS */
+	Mutex _async_mtx;
+
+	/** Semaforo para despertar al thread escritor */
+	Semaphore _async_sem;
+
+	/** Thread escritor del modo asincrono */
+	Thread* _async_th;
+
+	/** Tamanio maximo de la cola de escrituras asincronas */
+	uint16_t _async_max;
+
+	/** Flags de control del thread escritor */
+	bool _async_stop;
+	bool _async_busy;
+
+	/** Ultimo token asignado y ultimo token completado, protegidos por _async_mtx */
+	uint32_t _async_token;
+	uint32_t _async_done_token;
+
+	/** Tokens completados con error, protegidos por _async_mtx */
+	std::set<uint32_t> _async_failed;
+
+	/** Primer token cuyo resultado se conserva, tras descartar los errores mas antiguos */
+	uint32_t _async_known_token;
+
+	/** Tarea del thread escritor */
+	void _asyncTask();
+
+	#if StorageStats_ENABLED == 1
+	/** Estadisticas de las operaciones */
+	StorageStats<StatCount> _stats;
+	#endif
+
+	/** Implementacion de <save>, <restore> y <removeKey> sin instrumentar */
+	int _save(const char* data_id, void* data, uint32_t size, NVSInterface::KeyValueType type);
+	int _restore(const char* data_id, void* data, uint32_t size, NVSInterface::KeyValueType type);
+	int _removeKey(const char* data_id);
+
+	/** Elimina una clave de la cache de lectura, sea cual sea su tipo
+	 *  @param data_id Identificador de la clave
+	 */
+	void _invalidateCache(const char* data_id);
+
+	#if FSManager_NVS_API == 1
+	/** Escribe un valor en NVS en funcion de su tipo, sin realizar commit
+	 *  @param data_id Identificador de la clave
+	 *  @param data Puntero a los datos
+	 *  @param size Tamanio de los datos (solo para TypeBlob)
+	 *  @param type Tipo de dato
+	 *  @return codigo de error
+	 */
+	esp_err_t _nvsSet(const char* data_id, const void* data, uint32_t size, NVSInterface::KeyValueType type);
+
+	/** Lee un valor de NVS en funcion de su tipo
+	 *  @param data_id Identificador de la clave
+	 *  @param data Puntero que recibe los datos
+	 *  @param size Tamanio maximo a leer. Recibe el tamanio leido en TypeString y TypeBlob
+	 *  @param type Tipo de dato
+	 *  @return codigo de error
+	 */
+	esp_err_t _nvsGet(const char* data_id, void* data, uint32_t* size, NVSInterface::KeyValueType type);
+
+	/** Lee el valor completo de una clave de NVS, sea cual sea su longitud
+	 *  @param data_id Identificador de la clave
+	 *  @param type Tipo de dato
+	 *  @param value Recibe el valor leido
+	 *  @return codigo de error
+	 */
+	esp_err_t _nvsReadValue(const char* data_id, NVSInterface::KeyValueType type, std::vector<uint8_t>& value);
+
+	/** Obtiene el tipo con el que esta almacenada una clave en NVS, sea cual sea
+	 *  @param data_id Identificador de la clave
+	 *  @param type Recibe el tipo almacenado
+	 *  @return codigo de error (ESP_ERR_NVS_NOT_FOUND si no existe)
+	 */
+	esp_err_t _nvsFindType(const char* data_id, NVSInterface::KeyValueType* type);
+
+	/** Chequea si un valor coincide con el almacenado, consultando por orden las claves pendientes del modo
+	 *  write-back, la cache de lectura y NVS
+	 *  @param data_id Identificador de la clave
+	 *  @param data Puntero a los datos
+	 *  @param size Tamanio de los datos (solo para TypeBlob)
+	 *  @param type Tipo de dato
+	 *  @return true si el valor no ha cambiado
+	 */
+	bool _isUnchanged(const char* data_id, const void* data, uint32_t size, NVSInterface::KeyValueType type);
+
+	/** Realiza un nvs_commit contabilizandolo
+	 *  @return codigo de error
+	 */
+	esp_err_t _commit();
+
+	/** Vuelca las claves pendientes del modo write-back en la sesion abierta
+	 *  @return codigo de error
+	 */
+	esp_err_t _flushDirty();
+
+	/** Busca una clave pendiente del modo write-back
+	 *  @param data_id Identificador de la clave
+	 *  @return Iterador a la clave o _dirty.end() si no existe
+	 */
+	std::list<DirtyKey>::iterator _findDirty(const char* data_id);
+	#endif
+
 	/** instancia esttica */
 	static FSManager* _static_instance;
 
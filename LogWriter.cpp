@@ -0,0 +1,204 @@
+/*
+ * LogWriter.cpp
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ */
+
+#include "LogWriter.h"
+#include <unistd.h>
+
+
+//------------------------------------------------------------------------------------
+//--- PRIVATE TYPES ------------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+static const char* _MODULE_ = "[LogWriter].....";
+#define _EXPR_	(!IS_ISR())
+
+/** Intervalo de sondeo en las esperas de espacio y durabilidad */
+static const uint32_t PollIntervalMs = 2;
+
+
+//------------------------------------------------------------------------------------
+//-- PUBLIC METHODS IMPLEMENTATION ---------------------------------------------------
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+LogWriter::LogWriter(FATInterface* fat, const char* filename, size_t buffer_size, uint32_t flush_ms, osPriority priority, uint32_t stack_size) :
+		_fat(fat), _fp(NULL), _th(NULL), _kick(0, 1), _size(buffer_size), _active(0), _flushing(false), _stop(false), _flush_ms(flush_ms),
+		_appended(0), _durable(0), _error(0), _records(0), _groups(0) {
+	_buf[0] = new uint8_t[_size];
+	_buf[1] = new uint8_t[_size];
+	MBED_ASSERT(_buf[0] && _buf[1]);
+	_fill[0] = 0;
+	_fill[1] = 0;
+	_fp = _fat->open(filename, "a");
+	if(!_fp){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_OPEN, No se puede abrir %s", filename);
+		return;
+	}
+	// los volcados ya agrupan los datos, se evita el buffer intermedio de stdio
+	setvbuf(_fp, NULL, _IONBF, 0);
+	_th = new Thread(priority, stack_size, NULL, "LogWriter");
+	MBED_ASSERT(_th);
+	if(_th->start(callback(this, &LogWriter::_task)) != osOK){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_THREAD, No se puede arrancar el thread volcador");
+		delete(_th);
+		_th = NULL;
+	}
+}
+
+
+//------------------------------------------------------------------------------------
+LogWriter::~LogWriter(){
+	if(_th){
+		_stop = true;
+		_kick.release();
+		_th->join();
+		delete(_th);
+	}
+	if(_fp){
+		_flushGroup();
+		_fat->close(_fp);
+	}
+	delete[](_buf[0]);
+	delete[](_buf[1]);
+}
+
+
+//------------------------------------------------------------------------------------
+int LogWriter::append(const void* data, size_t len){
+	return _append(data, len, NULL, 0);
+}
+
+
+//------------------------------------------------------------------------------------
+int LogWriter::appendLine(const char* line){
+	// la linea y su fin de linea se aniaden en el mismo grupo
+	return _append(line, strlen(line), "\n", 1);
+}
+
+
+//------------------------------------------------------------------------------------
+int LogWriter::sync(uint32_t timeout_ms){
+	if(!ready()){
+		return -1;
+	}
+	_mtx.lock();
+	uint64_t target = _appended;
+	_mtx.unlock();
+	uint32_t elapsed = 0;
+	for(;;){
+		_mtx.lock();
+		bool done = (_durable >= target);
+		int err = _error;
+		_mtx.unlock();
+		if(done){
+			return err;
+		}
+		if(err != 0 || (timeout_ms != osWaitForever && elapsed >= timeout_ms)){
+			return -1;
+		}
+		_kick.release();
+		ThisThread::sleep_for(PollIntervalMs);
+		elapsed += PollIntervalMs;
+	}
+}
+
+
+//------------------------------------------------------------------------------------
+//-- PRIVATE METHODS IMPLEMENTATION --------------------------------------------------
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+int LogWriter::_append(const void* data, size_t len, const void* tail, size_t tail_len){
+	if(!ready() || len + tail_len > _size){
+		return -1;
+	}
+	_mtx.lock();
+	// si el buffer activo no tiene espacio y el otro se esta volcando, se espera a que quede libre
+	while(_error == 0 && _fill[_active] + len + tail_len > _size){
+		if(!_flushing){
+			_mtx.unlock();
+			_flushGroup();
+		}
+		else{
+			_mtx.unlock();
+			ThisThread::sleep_for(PollIntervalMs);
+		}
+		_mtx.lock();
+	}
+	// tras un volcado fallido no se admiten registros, el log tendria un hueco
+	if(_error != 0){
+		int err = _error;
+		_mtx.unlock();
+		return err;
+	}
+	memcpy(&_buf[_active][_fill[_active]], data, len);
+	if(tail_len > 0){
+		memcpy(&_buf[_active][_fill[_active] + len], tail, tail_len);
+	}
+	_fill[_active] += len + tail_len;
+	_appended += len + tail_len;
+	_records++;
+	bool kick = (_fill[_active] >= _size / 2);
+	_mtx.unlock();
+	if(kick){
+		_kick.release();
+	}
+	return 0;
+}
+
+
+//------------------------------------------------------------------------------------
+void LogWriter::_task(){
+	while(!_stop){
+		// se vuelca al recibir una solicitud o al vencer el tiempo maximo
+		_kick.wait(_flush_ms);
+		_flushGroup();
+	}
+}
+
+
+//------------------------------------------------------------------------------------
+int LogWriter::_flushGroup(){
+	_io_mtx.lock();
+	_mtx.lock();
+	uint8_t staged = _active;
+	size_t len = _fill[staged];
+	if(len == 0 || _error != 0){
+		int err = _error;
+		_mtx.unlock();
+		_io_mtx.unlock();
+		return err;
+	}
+	// los productores continuan sobre el otro buffer mientras se escribe el grupo
+	_active ^= 1;
+	_flushing = true;
+	uint64_t target = _appended;
+	_mtx.unlock();
+
+	int err = 0;
+	if(_fat->write(_buf[staged], sizeof(uint8_t), len, _fp) != len || _fat->flush(_fp, true) != 0){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_WRITE, Error volcando %d bytes", (int)len);
+		err = -1;
+	}
+
+	// el error es permanente: <_durable> no avanza mas alla del grupo fallido
+	_mtx.lock();
+	_fill[staged] = 0;
+	_flushing = false;
+	if(err != 0){
+		_error = err;
+	}
+	else{
+		_durable = target;
+		_groups++;
+	}
+	_mtx.unlock();
+	_io_mtx.unlock();
+	return err;
+}
+
+/**** END OF FILE ****/
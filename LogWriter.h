@@ -0,0 +1,128 @@
+/*
+ * LogWriter.h
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ *
+ *	LogWriter mantiene abierto un archivo de log de la particion FAT y agrupa los registros aniadidos desde distintas
+ *  tareas en un doble buffer. Mientras un buffer recibe nuevos registros, un thread volcador escribe el otro con un
+ *  unico fwrite seguido de fflush y fsync. El volcado se produce al superar un umbral de ocupacion o transcurrido un
+ *  tiempo maximo, de forma que el coste en disco depende del volumen de datos y no del numero de registros.
+ *
+ *  <sync> actua como barrera de durabilidad: espera hasta que todos los registros aniadidos antes de la llamada
+ *  estan en disco. Si un volcado falla, el error es permanente: los registros posteriores se rechazan y <sync> falla,
+ *  ya que el log tendria un hueco. Para continuar, debe crearse un nuevo LogWriter.
+ */
+
+#ifndef __LogWriter__H
+#define __LogWriter__H
+
+#include "mbed.h"
+#include "FATInterface.h"
+
+
+/** Tamanio por defecto de cada uno de los dos buffers */
+#define LogWriter_DEFAULT_BUFFER_SIZE	4096
+
+/** Tiempo maximo por defecto que un registro permanece en RAM antes de volcarse */
+#define LogWriter_DEFAULT_FLUSH_MS		1000
+
+
+class LogWriter{
+  public:
+
+    /** Constructor
+     *  Abre el archivo en modo append y arranca el thread volcador
+     *  @param fat Particion FAT
+     *  @param filename Archivo de log
+     *  @param buffer_size Tamanio de cada buffer. El volcado se solicita al alcanzar la mitad de ocupacion
+     *  @param flush_ms Tiempo maximo de permanencia de un registro en RAM
+     *  @param priority Prioridad del thread volcador
+     *  @param stack_size Tamanio de pila del thread volcador
+     */
+	LogWriter(FATInterface* fat, const char* filename, size_t buffer_size = LogWriter_DEFAULT_BUFFER_SIZE, uint32_t flush_ms = LogWriter_DEFAULT_FLUSH_MS,
+			  osPriority priority = osPriorityBelowNormal, uint32_t stack_size = 4096);
+
+    /** Destructor
+     *  Vuelca los registros pendientes, detiene el thread y cierra el archivo
+     */
+	virtual ~LogWriter();
+
+	/** ready
+	 *  Chequea si el archivo esta abierto y el thread volcador en marcha
+	 *  @return true si esta listo
+	 */
+	bool ready() { return (_fp != NULL && _th != NULL); }
+
+	/** append
+	 *  Aniade un registro al buffer activo. Si ambos buffers estan ocupados, espera a que finalice el volcado en curso
+	 *  @param data Datos del registro
+	 *  @param len Tamanio (no puede superar el tamanio del buffer)
+	 *  @return 0 (correcto), <0 (codigo de error, tambien tras un volcado fallido)
+	 */
+	int append(const void* data, size_t len);
+
+	/** appendLine
+	 *  Aniade una linea de texto terminada en '\n'
+	 *  @param line Linea sin fin de linea
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int appendLine(const char* line);
+
+	/** sync
+	 *  Barrera de durabilidad. Solicita un volcado inmediato y espera a que los registros aniadidos antes de la
+	 *  llamada esten en disco
+	 *  @param timeout_ms Tiempo maximo de espera
+	 *  @return 0 (correcto), <0 si vence el tiempo de espera o ha fallado algun volcado
+	 */
+	int sync(uint32_t timeout_ms = osWaitForever);
+
+	/** getCounters
+	 *  Obtiene el numero de registros aniadidos y de volcados realizados
+	 *  @param records Recibe el numero de registros
+	 *  @param groups Recibe el numero de volcados
+	 */
+	void getCounters(uint32_t* records, uint32_t* groups) { *records = _records; *groups = _groups; }
+
+  private:
+
+	/** Copia un registro en el buffer activo, esperando espacio si es necesario
+	 *  @param data Datos del registro
+	 *  @param len Tamanio
+	 *  @param tail Datos aniadidos a continuacion en el mismo registro (NULL si no hay)
+	 *  @param tail_len Tamanio de tail
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int _append(const void* data, size_t len, const void* tail, size_t tail_len);
+
+	/** Tarea del thread volcador */
+	void _task();
+
+	/** Vuelca el buffer activo, intercambiandolo con el libre
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int _flushGroup();
+
+	FATInterface* _fat;
+	FILE* _fp;
+	Thread* _th;
+	Mutex _mtx;						/* Acceso a los buffers y contadores */
+	Mutex _io_mtx;					/* Serializa los volcados */
+	Semaphore _kick;				/* Solicitud de volcado */
+	uint8_t* _buf[2];
+	size_t _fill[2];
+	size_t _size;
+	uint8_t _active;				/* Buffer que recibe los registros */
+	bool _flushing;					/* El buffer inactivo esta siendo volcado */
+	bool _stop;
+	uint32_t _flush_ms;
+	uint64_t _appended;				/* Bytes aniadidos desde la apertura */
+	uint64_t _durable;				/* Bytes volcados a disco desde la apertura */
+	int _error;						/* Error del primer volcado fallido (permanente) */
+	uint32_t _records;
+	uint32_t _groups;
+};
+
+#endif /*__LogWriter__H */
+
+/**** END OF FILE ****/
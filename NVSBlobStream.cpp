@@ -0,0 +1,228 @@
+/*
+ * NVSBlobStream.cpp
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ */
+
+#include "NVSBlobStream.h"
+#include "FATPlatform.h"
+
+
+//------------------------------------------------------------------------------------
+//--- PRIVATE TYPES ------------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+static const char* _MODULE_ = "[BlobStream]....";
+#define _EXPR_	(!IS_ISR())
+
+
+//------------------------------------------------------------------------------------
+//-- NVSBlobStream -------------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+NVSBlobStream::NVSBlobStream(NVSInterface* nvs, const char* key) : _nvs(nvs), _buf(NULL), _chunk_size(0), _total(0), _crc(0), _chunk(0), _gen(0), _error(0) {
+	if(strlen(key) > NVSBlobStream_MAX_KEY_LENGTH){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_KEY, Clave %s demasiado larga", key);
+		_key[0] = 0;
+		_error = -1;
+		return;
+	}
+	strcpy(_key, key);
+}
+
+
+//------------------------------------------------------------------------------------
+NVSBlobStream::~NVSBlobStream(){
+	delete[](_buf);
+}
+
+
+//------------------------------------------------------------------------------------
+void NVSBlobStream::_chunkKey(uint16_t index, char* chunk_key){
+	snprintf(chunk_key, NVSInterface_KEY_MAX_SIZE, "%s.%03x", _key, ((_gen)? NVSBlobStream_GENERATION_BIT : 0) | (index & NVSBlobStream_MAX_CHUNKS));
+}
+
+
+//------------------------------------------------------------------------------------
+//-- NVSBlobWriter -------------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+NVSBlobWriter::NVSBlobWriter(NVSInterface* nvs, const char* key, uint16_t chunk_size) : NVSBlobStream(nvs, key), _fill(0), _old_chunks(0) {
+	_chunk_size = chunk_size;
+	if(_error == 0 && _chunk_size == 0){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_CHUNK, Tamanio de fragmento nulo para %s", _key);
+		_error = -1;
+	}
+	if(_error == 0){
+		_buf = new uint8_t[_chunk_size];
+		MBED_ASSERT(_buf);
+		// los fragmentos se graban en la generacion que no utiliza el manifiesto vigente
+		Manifest old;
+		if(_nvs->restore(_key, &old, sizeof(Manifest), NVSInterface::TypeBlob) == 0 && old.magic == ManifestMagic){
+			_old_chunks = old.num_chunks;
+			_gen = (old.generation & 1) ^ 1;
+		}
+	}
+}
+
+
+//------------------------------------------------------------------------------------
+int NVSBlobWriter::write(const void* data, uint32_t size){
+	if(_error != 0){
+		return _error;
+	}
+	const uint8_t* src = (const uint8_t*)data;
+	uint32_t done = 0;
+	while(done < size){
+		uint32_t len = _chunk_size - _fill;
+		if(len > size - done){
+			len = size - done;
+		}
+		memcpy(&_buf[_fill], &src[done], len);
+		_fill += len;
+		done += len;
+		if(_fill == _chunk_size && _flushChunk() != 0){
+			return _error;
+		}
+	}
+	return (int)done;
+}
+
+
+//------------------------------------------------------------------------------------
+int NVSBlobWriter::finish(){
+	if(_error != 0){
+		return _error;
+	}
+	if(_fill > 0 && _flushChunk() != 0){
+		return _error;
+	}
+	// El manifiesto pasa a referenciar la nueva generacion en una unica escritura
+	Manifest manifest;
+	memset(&manifest, 0, sizeof(Manifest));
+	manifest.magic = ManifestMagic;
+	manifest.total_size = _total;
+	manifest.chunk_size = _chunk_size;
+	manifest.num_chunks = _chunk;
+	manifest.crc = _crc;
+	manifest.generation = _gen;
+	_error = _nvs->save(_key, &manifest, sizeof(Manifest), NVSInterface::TypeBlob);
+	if(_error != 0){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_WR, Error [%d] al grabar manifiesto de %s", _error, _key);
+		return _error;
+	}
+	// Se eliminan los fragmentos sobrantes de una escritura interrumpida en esta generacion...
+	char chunk_key[NVSInterface_KEY_MAX_SIZE];
+	for(uint16_t i = _chunk; i <= NVSBlobStream_MAX_CHUNKS; i++){
+		_chunkKey(i, chunk_key);
+		if(!_nvs->checkKey(chunk_key)){
+			break;
+		}
+		_nvs->removeKey(chunk_key);
+	}
+	// ...y los de la generacion anterior
+	_gen ^= 1;
+	for(uint16_t i = 0; i < _old_chunks; i++){
+		_chunkKey(i, chunk_key);
+		_nvs->removeKey(chunk_key);
+	}
+	_gen ^= 1;
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Blob %s grabado: %d bytes en %d fragmentos", _key, _total, _chunk);
+	return 0;
+}
+
+
+//------------------------------------------------------------------------------------
+int NVSBlobWriter::_flushChunk(){
+	if(_chunk >= NVSBlobStream_MAX_CHUNKS){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_SIZE, Blob %s excede el numero maximo de fragmentos", _key);
+		_error = -1;
+		return _error;
+	}
+	char chunk_key[NVSInterface_KEY_MAX_SIZE];
+	_chunkKey(_chunk, chunk_key);
+	_error = _nvs->save(chunk_key, _buf, _fill, NVSInterface::TypeBlob);
+	if(_error != 0){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_WR, Error [%d] al grabar fragmento %s", _error, chunk_key);
+		return _error;
+	}
+	_crc = FATPlatform::crc32(_crc, _buf, _fill);
+	_total += _fill;
+	_fill = 0;
+	_chunk++;
+	return 0;
+}
+
+
+//------------------------------------------------------------------------------------
+//-- NVSBlobReader -------------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+NVSBlobReader::NVSBlobReader(NVSInterface* nvs, const char* key) : NVSBlobStream(nvs, key), _offset(0), _chunk_len(0), _chunk_pos(0) {
+	if(_error != 0){
+		return;
+	}
+	_error = _nvs->restore(_key, &_manifest, sizeof(Manifest), NVSInterface::TypeBlob);
+	if(_error != 0 || _manifest.magic != ManifestMagic){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_MANIFEST, Manifiesto de %s no valido", _key);
+		_error = (_error != 0)? _error : -1;
+		return;
+	}
+	// los fragmentos deben poder contener el tamanio total declarado
+	if(_manifest.chunk_size == 0 || (uint32_t)_manifest.chunk_size * _manifest.num_chunks < _manifest.total_size){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_MANIFEST, Fragmentos de %s no validos", _key);
+		_error = -1;
+		return;
+	}
+	_total = _manifest.total_size;
+	_chunk_size = _manifest.chunk_size;
+	_gen = _manifest.generation & 1;
+	_buf = new uint8_t[_chunk_size];
+	MBED_ASSERT(_buf);
+}
+
+
+//------------------------------------------------------------------------------------
+int NVSBlobReader::read(void* data, uint32_t size){
+	if(_error != 0){
+		return _error;
+	}
+	uint8_t* dst = (uint8_t*)data;
+	uint32_t done = 0;
+	while(done < size && _offset < _total){
+		// Se carga el siguiente fragmento cuando se ha consumido el actual
+		if(_chunk_pos == _chunk_len){
+			char chunk_key[NVSInterface_KEY_MAX_SIZE];
+			_chunkKey(_chunk, chunk_key);
+			_chunk_len = (_total - _offset < _chunk_size)? (_total - _offset) : _chunk_size;
+			_error = _nvs->restore(chunk_key, _buf, _chunk_len, NVSInterface::TypeBlob);
+			if(_error != 0){
+				DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_RD, Error [%d] al leer fragmento %s", _error, chunk_key);
+				return _error;
+			}
+			_crc = FATPlatform::crc32(_crc, _buf, _chunk_len);
+			_chunk_pos = 0;
+			_chunk++;
+		}
+		uint32_t len = _chunk_len - _chunk_pos;
+		if(len > size - done){
+			len = size - done;
+		}
+		memcpy(&dst[done], &_buf[_chunk_pos], len);
+		_chunk_pos += len;
+		_offset += len;
+		done += len;
+	}
+	if(_offset == _total && _chunk_pos == _chunk_len && _crc != _manifest.crc){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_CRC, Contenido de %s corrupto", _key);
+		_error = -1;
+		return _error;
+	}
+	return (int)done;
+}
+
+/**** END OF FILE ****/
@@ -0,0 +1,165 @@
+/*
+ * NVSBlobStream.h
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ *
+ *	NVSBlobStream permite grabar y recuperar blobs de gran tamanio sobre cualquier NVSInterface, dividiendolos en
+ *  fragmentos numerados secuencialmente y un manifiesto. De esta forma el consumo de RAM queda acotado al tamanio de
+ *  un fragmento, independientemente del tamanio total del blob.
+ *
+ *  Las claves utilizadas son:
+ *  	<key>		Manifiesto con el tamanio total, tamanio de fragmento, numero de fragmentos, CRC32 y generacion
+ *  	<key>.NNN	Fragmento NNN (hexadecimal) del contenido. El bit NVSBlobStream_GENERATION_BIT indica la generacion
+ *
+ *  Al reescribir un blob, los fragmentos se graban en la generacion que no referencia el manifiesto vigente y el
+ *  cambio de contenido se produce al grabar el nuevo manifiesto. Si la escritura se interrumpe antes, el blob
+ *  anterior sigue intacto.
+ *
+ *  Las operaciones deben realizarse dentro de una sesion <open>/<close> del NVSInterface utilizado.
+ */
+
+#ifndef __NVSBlobStream__H
+#define __NVSBlobStream__H
+
+#include "mbed.h"
+#include "NVSInterface.h"
+
+
+/** Longitud maxima de la clave base, reservando espacio para el sufijo de fragmento ".NNN" */
+#define NVSBlobStream_MAX_KEY_LENGTH		(NVSInterface_KEY_MAX_SIZE - 5)
+
+/** Tamanio por defecto de cada fragmento */
+#define NVSBlobStream_DEFAULT_CHUNK_SIZE	1024
+
+/** Numero maximo de fragmentos por blob */
+#define NVSBlobStream_MAX_CHUNKS			0x7FF
+
+/** Bit del indice de fragmento que distingue las dos generaciones de un blob */
+#define NVSBlobStream_GENERATION_BIT		0x800
+
+
+class NVSBlobStream{
+  public:
+
+	/** Manifest
+	 * 	Manifiesto almacenado en la clave base
+	 */
+	struct Manifest{
+		uint32_t magic;
+		uint32_t total_size;
+		uint16_t chunk_size;
+		uint16_t num_chunks;
+		uint32_t crc;
+		uint8_t generation;
+		uint8_t reserved[3];
+	};
+
+	static const uint32_t ManifestMagic = 0x424C4F42;	// "BLOB"
+
+  protected:
+
+    /** Constructor
+     *  @param nvs Interfaz NVS sobre la que operar
+     *  @param key Clave base del blob
+     */
+	NVSBlobStream(NVSInterface* nvs, const char* key);
+	virtual ~NVSBlobStream();
+
+	/** Obtiene la clave de un fragmento de la generacion en curso
+	 *  @param index Indice del fragmento
+	 *  @param chunk_key Recibe la clave
+	 */
+	void _chunkKey(uint16_t index, char* chunk_key);
+
+	NVSInterface* _nvs;
+	char _key[NVSBlobStream_MAX_KEY_LENGTH + 1];
+	uint8_t* _buf;
+	uint16_t _chunk_size;
+	uint32_t _total;
+	uint32_t _crc;
+	uint16_t _chunk;
+	uint8_t _gen;
+	int _error;
+};
+
+
+class NVSBlobWriter : public NVSBlobStream{
+  public:
+
+    /** Constructor
+     *  Prepara la escritura de un blob. El contenido previo se sustituye al invocar <finish>
+     *  @param nvs Interfaz NVS sobre la que operar
+     *  @param key Clave base del blob (max NVSBlobStream_MAX_KEY_LENGTH caracteres)
+     *  @param chunk_size Tamanio de cada fragmento (>0). Con 0 el escritor queda en error
+     */
+	NVSBlobWriter(NVSInterface* nvs, const char* key, uint16_t chunk_size = NVSBlobStream_DEFAULT_CHUNK_SIZE);
+	virtual ~NVSBlobWriter(){}
+
+	/** write
+	 *  Aniade datos al blob, grabando cada fragmento a medida que se completa
+	 *  @param data Datos a grabar
+	 *  @param size Tamanio de los datos
+	 *  @return Numero de bytes aceptados o codigo de error (<0)
+	 */
+	int write(const void* data, uint32_t size);
+
+	/** finish
+	 *  Graba el ultimo fragmento y el manifiesto, que pasa a referenciar la nueva generacion, y elimina los
+	 *  fragmentos de la generacion anterior
+	 *  @return codigo de error (0=OK)
+	 */
+	int finish();
+
+  private:
+
+	/** Graba el fragmento en curso */
+	int _flushChunk();
+
+	uint32_t _fill;
+	uint16_t _old_chunks;
+};
+
+
+class NVSBlobReader : public NVSBlobStream{
+  public:
+
+    /** Constructor
+     *  Prepara la lectura de un blob, cargando su manifiesto
+     *  @param nvs Interfaz NVS sobre la que operar
+     *  @param key Clave base del blob
+     */
+	NVSBlobReader(NVSInterface* nvs, const char* key);
+	virtual ~NVSBlobReader(){}
+
+	/** ready
+	 *  Chequea si el manifiesto se ha cargado correctamente
+	 *  @return true si el blob es legible
+	 */
+	bool ready() { return _error == 0; }
+
+	/** size
+	 *  Obtiene el tamanio total del blob
+	 *  @return Tamanio en bytes
+	 */
+	uint32_t size() { return _total; }
+
+	/** read
+	 *  Lee el siguiente tramo del blob. Al alcanzar el final se verifica el CRC del contenido completo
+	 *  @param data Buffer que recibe los datos
+	 *  @param size Tamanio del buffer
+	 *  @return Numero de bytes leidos, 0 al final del blob o codigo de error (<0)
+	 */
+	int read(void* data, uint32_t size);
+
+  private:
+
+	Manifest _manifest;
+	uint32_t _offset;
+	uint32_t _chunk_len;
+	uint32_t _chunk_pos;
+};
+
+#endif /*__NVSBlobStream__H */
+
+/**** END OF FILE ****/
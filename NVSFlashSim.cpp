@@ -0,0 +1,993 @@
+/*
+ * NVSFlashSim.cpp
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ */
+
+#include "NVSFlashSim.h"
+
+#if NVSFlashSim_ENABLED == 1
+
+
+//------------------------------------------------------------------------------------
+//--- PRIVATE TYPES ------------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+static const char* _MODULE_ = "[NVSFlashSim]...";
+#define _EXPR_	(!IS_ISR())
+
+/** Desplazamientos dentro de una pagina y de una entrada */
+static const uint32_t PageBitmapOffset = 32;
+static const uint32_t EntryKeyOffset = 8;
+static const uint32_t EntryDataOffset = 24;
+
+/** Particiones simuladas */
+std::list<NVSFlashSim*> NVSFlashSim::_partitions;
+
+/** Handle abierto con nvs_open_from_partition */
+struct SimHandle{
+	NVSFlashSim* part;
+	uint8_t ns;
+	bool readonly;
+	bool used;
+};
+
+/** Iterador de nvs_entry_find, sobre una copia de las claves de la particion */
+struct nvs_opaque_iterator_t{
+	std::vector<nvs_entry_info_t> entries;
+	uint32_t pos;
+};
+
+/** Handles abiertos (el handle es el indice + 1) */
+static std::vector<SimHandle> s_handles;
+
+/** Mutex de acceso a la lista de particiones y de handles */
+static Mutex s_mtx;
+
+
+//------------------------------------------------------------------------------------
+static bool _isVarType(uint8_t type){
+	return (type == NVS_TYPE_STR || type == NVS_TYPE_BLOB);
+}
+
+
+//------------------------------------------------------------------------------------
+static bool _getHandle(nvs_handle handle, SimHandle* h){
+	s_mtx.lock();
+	bool valid = (handle > 0 && handle <= s_handles.size() && s_handles[handle - 1].used);
+	if(valid){
+		*h = s_handles[handle - 1];
+	}
+	s_mtx.unlock();
+	return valid;
+}
+
+
+//------------------------------------------------------------------------------------
+static esp_err_t _set(nvs_handle handle, const char* key, nvs_type_t type, const void* data, size_t len){
+	SimHandle h;
+	if(!_getHandle(handle, &h)){
+		return ESP_ERR_NVS_INVALID_HANDLE;
+	}
+	if(h.readonly){
+		return ESP_ERR_NVS_READ_ONLY;
+	}
+	return h.part->setItem(h.ns, type, key, data, len);
+}
+
+
+//------------------------------------------------------------------------------------
+static esp_err_t _get(nvs_handle handle, const char* key, nvs_type_t type, void* data, size_t* len){
+	SimHandle h;
+	if(!_getHandle(handle, &h)){
+		return ESP_ERR_NVS_INVALID_HANDLE;
+	}
+	return h.part->getItem(h.ns, type, key, data, len);
+}
+
+
+//------------------------------------------------------------------------------------
+//-- PUBLIC METHODS IMPLEMENTATION ---------------------------------------------------
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+NVSFlashSim::NVSFlashSim(const char* label, const Config& cfg) : _cfg(cfg), _ready(false), _fp(NULL), _active(-1), _seq(0), _commit_err(ESP_OK) {
+	strncpy(_label, label, NVS_KEY_NAME_MAX_SIZE - 1);
+	_label[NVS_KEY_NAME_MAX_SIZE - 1] = 0;
+	memset(&_counters, 0, sizeof(Counters));
+}
+
+
+//------------------------------------------------------------------------------------
+NVSFlashSim::Config NVSFlashSim::defaultConfig(){
+	Config cfg;
+	cfg.num_pages = NVSFlashSim_DEFAULT_PAGES;
+	cfg.filename = NULL;
+	cfg.read_us = 0;
+	cfg.program_us = 0;
+	cfg.erase_us = 0;
+	cfg.commit_us = 0;
+	cfg.sleep = false;
+	return cfg;
+}
+
+
+//------------------------------------------------------------------------------------
+NVSFlashSim* NVSFlashSim::configure(const char* label, const Config& cfg){
+	MBED_ASSERT(cfg.num_pages >= 2);
+	NVSFlashSim* part = getPartition(label);
+	part->lock();
+	if(part->_ready){
+		DEBUG_TRACE_W(_EXPR_, _MODULE_, "Particion %s ya inicializada, se mantiene su geometria", label);
+		part->_cfg.read_us = cfg.read_us;
+		part->_cfg.program_us = cfg.program_us;
+		part->_cfg.erase_us = cfg.erase_us;
+		part->_cfg.commit_us = cfg.commit_us;
+		part->_cfg.sleep = cfg.sleep;
+	}
+	else{
+		part->_cfg = cfg;
+		part->_flash.clear();
+		if(part->_fp){
+			fclose(part->_fp);
+			part->_fp = NULL;
+		}
+	}
+	part->unlock();
+	return part;
+}
+
+
+//------------------------------------------------------------------------------------
+NVSFlashSim* NVSFlashSim::getPartition(const char* label){
+	s_mtx.lock();
+	for(auto it = _partitions.begin(); it != _partitions.end(); ++it){
+		if(strncmp((*it)->_label, label, NVS_KEY_NAME_MAX_SIZE - 1) == 0){
+			s_mtx.unlock();
+			return *it;
+		}
+	}
+	NVSFlashSim* part = new NVSFlashSim(label, defaultConfig());
+	MBED_ASSERT(part);
+	_partitions.push_back(part);
+	s_mtx.unlock();
+	return part;
+}
+
+
+//------------------------------------------------------------------------------------
+void NVSFlashSim::getCounters(Counters* counters){
+	_mtx.lock();
+	*counters = _counters;
+	_mtx.unlock();
+}
+
+
+//------------------------------------------------------------------------------------
+void NVSFlashSim::resetCounters(){
+	_mtx.lock();
+	uint32_t max_page_erases = _counters.max_page_erases;
+	memset(&_counters, 0, sizeof(Counters));
+	_counters.max_page_erases = max_page_erases;
+	_key_counters.clear();
+	_mtx.unlock();
+}
+
+
+//------------------------------------------------------------------------------------
+int NVSFlashSim::forEachKey(Callback<bool(const KeyCounters&)> visitor){
+	_mtx.lock();
+	int count = 0;
+	for(auto it = _key_counters.begin(); it != _key_counters.end(); ++it){
+		count++;
+		if(!visitor.call(*it)){
+			break;
+		}
+	}
+	_mtx.unlock();
+	return count;
+}
+
+
+//------------------------------------------------------------------------------------
+uint32_t NVSFlashSim::getFreeEntries(){
+	_mtx.lock();
+	uint32_t free_entries = 0;
+	uint16_t empty_pages = 0;
+	for(uint16_t p = 0; p < _pages.size(); p++){
+		if(_pages[p].state == PageEmpty){
+			empty_pages++;
+			continue;
+		}
+		free_entries += _pages[p].erased + (NVSFlashSim_ENTRIES_PER_PAGE - _pages[p].next_free);
+	}
+	// una pagina vacia queda siempre en reserva para liberar paginas
+	if(empty_pages > 1){
+		free_entries += (empty_pages - 1) * NVSFlashSim_ENTRIES_PER_PAGE;
+	}
+	_mtx.unlock();
+	return free_entries;
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t NVSFlashSim::init(){
+	_mtx.lock();
+	if(_ready){
+		_mtx.unlock();
+		return ESP_OK;
+	}
+	uint32_t size = _cfg.num_pages * NVSFlashSim_PAGE_SIZE;
+	if(_flash.size() != size){
+		_flash.assign(size, 0xFF);
+		_page_erases.assign(_cfg.num_pages, 0);
+		if(_cfg.filename){
+			// se carga la imagen existente o se crea una nueva borrada
+			_fp = fopen(_cfg.filename, "r+b");
+			if(_fp){
+				if(fread(_flash.data(), 1, size, _fp) != size){
+					DEBUG_TRACE_W(_EXPR_, _MODULE_, "Imagen %s incompleta, resto borrado", _cfg.filename);
+				}
+			}
+			else{
+				_fp = fopen(_cfg.filename, "w+b");
+				if(!_fp){
+					DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_FILE, No se puede crear la imagen %s", _cfg.filename);
+					_mtx.unlock();
+					return ESP_FAIL;
+				}
+			}
+			fseek(_fp, 0, SEEK_SET);
+			fwrite(_flash.data(), 1, size, _fp);
+			fflush(_fp);
+		}
+	}
+	_scan();
+	uint16_t empty_pages = 0;
+	for(uint16_t p = 0; p < _pages.size(); p++){
+		empty_pages += (_pages[p].state == PageEmpty)? 1 : 0;
+	}
+	if(empty_pages == 0){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_NO_FREE_PAGES en particion %s", _label);
+		_mtx.unlock();
+		return ESP_ERR_NVS_NO_FREE_PAGES;
+	}
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Particion %s: %d paginas, %d claves", _label, _cfg.num_pages, (int)_items.size());
+	_ready = true;
+	_mtx.unlock();
+	return ESP_OK;
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t NVSFlashSim::erase(){
+	_mtx.lock();
+	if(_flash.empty()){
+		_mtx.unlock();
+		return init();
+	}
+	for(uint16_t p = 0; p < _cfg.num_pages; p++){
+		_erasePage(p);
+	}
+	_scan();
+	_mtx.unlock();
+	return ESP_OK;
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t NVSFlashSim::openNamespace(const char* name, bool create, uint8_t* ns){
+	if(strlen(name) >= NVS_KEY_NAME_MAX_SIZE){
+		return ESP_ERR_NVS_KEY_TOO_LONG;
+	}
+	_mtx.lock();
+	if(!_ready){
+		_mtx.unlock();
+		return ESP_ERR_NVS_NOT_INITIALIZED;
+	}
+	uint8_t next = 1;
+	for(auto it = _namespaces.begin(); it != _namespaces.end(); ++it){
+		if(strcmp(it->name, name) == 0){
+			*ns = it->index;
+			_mtx.unlock();
+			return ESP_OK;
+		}
+		next = (it->index >= next)? it->index + 1 : next;
+	}
+	if(!create){
+		_mtx.unlock();
+		return ESP_ERR_NVS_NOT_FOUND;
+	}
+	if(next == 0xFF){
+		_mtx.unlock();
+		return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+	}
+	// los namespaces se registran como claves U8 en el namespace 0
+	esp_err_t err = _setItem(0, NVS_TYPE_U8, name, &next, sizeof(uint8_t));
+	if(err == ESP_OK){
+		_namespaces.emplace_back();
+		strcpy(_namespaces.back().name, name);
+		_namespaces.back().index = next;
+		*ns = next;
+	}
+	_mtx.unlock();
+	return err;
+}
+
+
+//------------------------------------------------------------------------------------
+bool NVSFlashSim::namespaceName(uint8_t ns, char* name){
+	for(auto it = _namespaces.begin(); it != _namespaces.end(); ++it){
+		if(it->index == ns){
+			strcpy(name, it->name);
+			return true;
+		}
+	}
+	name[0] = 0;
+	return false;
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t NVSFlashSim::setItem(uint8_t ns, nvs_type_t type, const char* key, const void* data, size_t len){
+	_mtx.lock();
+	esp_err_t err = (_ready)? _setItem(ns, type, key, data, len) : ESP_ERR_NVS_NOT_INITIALIZED;
+	_mtx.unlock();
+	return err;
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t NVSFlashSim::getItem(uint8_t ns, nvs_type_t type, const char* key, void* data, size_t* len){
+	if(strlen(key) >= NVS_KEY_NAME_MAX_SIZE){
+		return ESP_ERR_NVS_KEY_TOO_LONG;
+	}
+	_mtx.lock();
+	if(!_ready){
+		_mtx.unlock();
+		return ESP_ERR_NVS_NOT_INITIALIZED;
+	}
+	auto it = _find(ns, type, key);
+	if(it == _items.end()){
+		_mtx.unlock();
+		return ESP_ERR_NVS_NOT_FOUND;
+	}
+	uint8_t entry[NVSFlashSim_ENTRY_SIZE];
+	_read(_entryOffset(it->page, it->entry), entry, NVSFlashSim_ENTRY_SIZE);
+	if(!_isVarType(type)){
+		memcpy(data, &entry[EntryDataOffset], *len);
+		_mtx.unlock();
+		return ESP_OK;
+	}
+	uint16_t size;
+	memcpy(&size, &entry[EntryDataOffset], sizeof(uint16_t));
+	if(data == NULL){
+		*len = size;
+		_mtx.unlock();
+		return ESP_OK;
+	}
+	if(*len < size){
+		_mtx.unlock();
+		return ESP_ERR_NVS_INVALID_LENGTH;
+	}
+	_read(_entryOffset(it->page, it->entry + 1), data, size);
+	*len = size;
+	_mtx.unlock();
+	return ESP_OK;
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t NVSFlashSim::eraseItem(uint8_t ns, const char* key){
+	_mtx.lock();
+	if(!_ready){
+		_mtx.unlock();
+		return ESP_ERR_NVS_NOT_INITIALIZED;
+	}
+	auto it = _find(ns, NVS_TYPE_ANY, key);
+	if(it == _items.end()){
+		_mtx.unlock();
+		return ESP_ERR_NVS_NOT_FOUND;
+	}
+	KeyCounters* kc = _keyCounters(ns, key);
+	uint32_t bytes = _counters.bytes_programmed;
+	_eraseEntries(it);
+	kc->erases++;
+	kc->bytes_programmed += _counters.bytes_programmed - bytes;
+	_mtx.unlock();
+	return ESP_OK;
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t NVSFlashSim::eraseNamespace(uint8_t ns){
+	_mtx.lock();
+	if(!_ready){
+		_mtx.unlock();
+		return ESP_ERR_NVS_NOT_INITIALIZED;
+	}
+	for(auto it = _items.begin(); it != _items.end();){
+		auto next = std::next(it);
+		if(it->ns == ns){
+			KeyCounters* kc = _keyCounters(ns, it->key);
+			uint32_t bytes = _counters.bytes_programmed;
+			_eraseEntries(it);
+			kc->erases++;
+			kc->bytes_programmed += _counters.bytes_programmed - bytes;
+		}
+		it = next;
+	}
+	_mtx.unlock();
+	return ESP_OK;
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t NVSFlashSim::commit(){
+	_mtx.lock();
+	_counters.commits++;
+	_delay(_cfg.commit_us);
+	esp_err_t err = _commit_err;
+	_mtx.unlock();
+	return err;
+}
+
+
+//------------------------------------------------------------------------------------
+//-- PRIVATE METHODS IMPLEMENTATION --------------------------------------------------
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+void NVSFlashSim::_read(uint32_t offset, void* data, uint32_t len){
+	memcpy(data, &_flash[offset], len);
+	_counters.reads++;
+	_counters.bytes_read += len;
+	_delay(_cfg.read_us * ((len + NVSFlashSim_ENTRY_SIZE - 1) / NVSFlashSim_ENTRY_SIZE));
+}
+
+
+//------------------------------------------------------------------------------------
+void NVSFlashSim::_program(uint32_t offset, const void* data, uint32_t len){
+	const uint8_t* src = (const uint8_t*)data;
+	for(uint32_t i = 0; i < len; i++){
+		// la programacion solo puede pasar bits de 1 a 0
+		MBED_ASSERT((_flash[offset + i] & src[i]) == src[i]);
+		_flash[offset + i] &= src[i];
+	}
+	if(_fp){
+		fseek(_fp, offset, SEEK_SET);
+		fwrite(&_flash[offset], 1, len, _fp);
+		fflush(_fp);
+	}
+	_counters.programs++;
+	_counters.bytes_programmed += len;
+	_delay(_cfg.program_us * ((len + NVSFlashSim_ENTRY_SIZE - 1) / NVSFlashSim_ENTRY_SIZE));
+}
+
+
+//------------------------------------------------------------------------------------
+void NVSFlashSim::_erasePage(uint16_t page){
+	uint32_t offset = page * NVSFlashSim_PAGE_SIZE;
+	memset(&_flash[offset], 0xFF, NVSFlashSim_PAGE_SIZE);
+	if(_fp){
+		fseek(_fp, offset, SEEK_SET);
+		fwrite(&_flash[offset], 1, NVSFlashSim_PAGE_SIZE, _fp);
+		fflush(_fp);
+	}
+	_page_erases[page]++;
+	_counters.page_erases++;
+	_counters.max_page_erases = (_page_erases[page] > _counters.max_page_erases)? _page_erases[page] : _counters.max_page_erases;
+	_delay(_cfg.erase_us);
+}
+
+
+//------------------------------------------------------------------------------------
+void NVSFlashSim::_delay(uint32_t us){
+	_counters.busy_us += us;
+	if(_cfg.sleep && us > 0){
+		wait_us(us);
+	}
+}
+
+
+//------------------------------------------------------------------------------------
+uint8_t NVSFlashSim::_entryState(uint16_t page, uint8_t entry){
+	uint8_t bits = _flash[page * NVSFlashSim_PAGE_SIZE + PageBitmapOffset + entry / 4];
+	return (bits >> ((entry % 4) * 2)) & 3;
+}
+
+
+//------------------------------------------------------------------------------------
+void NVSFlashSim::_setEntryState(uint16_t page, uint8_t entry, uint8_t span, EntryState state){
+	// el mapa de estados se modifica en RAM y se programan solo las palabras afectadas
+	uint32_t offset = page * NVSFlashSim_PAGE_SIZE + PageBitmapOffset;
+	uint8_t bitmap[32];
+	memcpy(bitmap, &_flash[offset], sizeof(bitmap));
+	for(uint8_t e = entry; e < entry + span; e++){
+		bitmap[e / 4] &= ~((~state & 3) << ((e % 4) * 2));
+	}
+	for(uint32_t w = 0; w < sizeof(bitmap); w += 4){
+		if(memcmp(&bitmap[w], &_flash[offset + w], 4) != 0){
+			_program(offset + w, &bitmap[w], 4);
+		}
+	}
+}
+
+
+//------------------------------------------------------------------------------------
+void NVSFlashSim::_setPageState(uint16_t page, uint32_t state){
+	_program(page * NVSFlashSim_PAGE_SIZE, &state, sizeof(uint32_t));
+	_pages[page].state = state;
+}
+
+
+//------------------------------------------------------------------------------------
+void NVSFlashSim::_activatePage(uint16_t page){
+	uint8_t header[32];
+	memset(header, 0xFF, sizeof(header));
+	uint32_t state = PageActive;
+	uint32_t seq = ++_seq;
+	memcpy(&header[0], &state, sizeof(uint32_t));
+	memcpy(&header[4], &seq, sizeof(uint32_t));
+	_program(page * NVSFlashSim_PAGE_SIZE, header, sizeof(header));
+	_pages[page].state = PageActive;
+	_pages[page].seq = seq;
+	_pages[page].next_free = 0;
+	_pages[page].erased = 0;
+	_active = page;
+}
+
+
+//------------------------------------------------------------------------------------
+void NVSFlashSim::_scan(){
+	_pages.assign(_cfg.num_pages, PageInfo());
+	_items.clear();
+	_namespaces.clear();
+	_active = -1;
+	_seq = 0;
+	for(uint16_t p = 0; p < _cfg.num_pages; p++){
+		PageInfo& pi = _pages[p];
+		_read(p * NVSFlashSim_PAGE_SIZE, &pi.state, sizeof(uint32_t));
+		_read(p * NVSFlashSim_PAGE_SIZE + 4, &pi.seq, sizeof(uint32_t));
+		pi.next_free = 0;
+		pi.erased = 0;
+		if(pi.state == PageEmpty){
+			pi.seq = 0;
+			continue;
+		}
+		_seq = (pi.seq > _seq)? pi.seq : _seq;
+		// la pagina activa es la de mayor secuencia, las demas se consideran llenas
+		if(pi.state == PageActive){
+			if(_active >= 0 && _pages[_active].seq > pi.seq){
+				pi.state = PageFull;
+			}
+			else{
+				if(_active >= 0){
+					_pages[_active].state = PageFull;
+				}
+				_active = p;
+			}
+		}
+		for(uint8_t e = 0; e < NVSFlashSim_ENTRIES_PER_PAGE;){
+			uint8_t st = _entryState(p, e);
+			if(st == EntryEmpty){
+				e++;
+				continue;
+			}
+			if(st != EntryWritten){
+				pi.erased++;
+				pi.next_free = e + 1;
+				e++;
+				continue;
+			}
+			uint8_t entry[NVSFlashSim_ENTRY_SIZE];
+			_read(_entryOffset(p, e), entry, NVSFlashSim_ENTRY_SIZE);
+			Item item;
+			item.ns = entry[0];
+			item.type = entry[1];
+			item.span = (entry[2] > 0)? entry[2] : 1;
+			memcpy(item.key, &entry[EntryKeyOffset], NVS_KEY_NAME_MAX_SIZE);
+			item.key[NVS_KEY_NAME_MAX_SIZE - 1] = 0;
+			item.page = p;
+			item.entry = e;
+			_items.push_back(item);
+			if(item.ns == 0){
+				_namespaces.emplace_back();
+				strcpy(_namespaces.back().name, item.key);
+				_namespaces.back().index = entry[EntryDataOffset];
+			}
+			e += item.span;
+			pi.next_free = e;
+		}
+	}
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t NVSFlashSim::_reserve(uint8_t span){
+	// cada liberacion compacta una pagina llena distinta, de modo que basta una pasada por las paginas
+	uint16_t collections = 0;
+	for(;;){
+		if(_active >= 0 && _pages[_active].next_free + span <= NVSFlashSim_ENTRIES_PER_PAGE){
+			return ESP_OK;
+		}
+		if(_active >= 0){
+			_setPageState(_active, PageFull);
+			_active = -1;
+		}
+		int32_t first_empty = -1;
+		uint16_t empty_pages = 0;
+		for(uint16_t p = 0; p < _pages.size(); p++){
+			if(_pages[p].state == PageEmpty){
+				first_empty = (first_empty < 0)? p : first_empty;
+				empty_pages++;
+			}
+		}
+		// se reserva siempre una pagina vacia para poder liberar paginas llenas
+		if(empty_pages > 1){
+			_activatePage(first_empty);
+			continue;
+		}
+		// solo se libera si alguna pagina, una vez compactada, puede alojar las entradas solicitadas
+		bool fits = false;
+		for(uint16_t p = 0; p < _pages.size() && !fits; p++){
+			const PageInfo& pi = _pages[p];
+			fits = (pi.state == PageFull && (pi.next_free - pi.erased) + span <= NVSFlashSim_ENTRIES_PER_PAGE);
+		}
+		if(!fits || collections++ >= _pages.size()){
+			DEBUG_TRACE_W(_EXPR_, _MODULE_, "ERR_NOT_ENOUGH_SPACE en particion %s para %d entradas", _label, span);
+			return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+		}
+		esp_err_t err = _collect();
+		if(err != ESP_OK){
+			return err;
+		}
+	}
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t NVSFlashSim::_collect(){
+	int32_t spare = -1;
+	int32_t victim = -1;
+	for(uint16_t p = 0; p < _pages.size(); p++){
+		const PageInfo& pi = _pages[p];
+		if(pi.state == PageEmpty){
+			spare = (spare < 0)? p : spare;
+			continue;
+		}
+		// pagina llena mas antigua con entradas recuperables
+		bool reclaimable = (pi.erased > 0 || pi.next_free < NVSFlashSim_ENTRIES_PER_PAGE);
+		if(pi.state == PageFull && reclaimable && (victim < 0 || pi.seq < _pages[victim].seq)){
+			victim = p;
+		}
+	}
+	if(spare < 0 || victim < 0){
+		DEBUG_TRACE_W(_EXPR_, _MODULE_, "ERR_NOT_ENOUGH_SPACE en particion %s", _label);
+		return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+	}
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Liberando pagina %d (%d entradas borradas)", victim, _pages[victim].erased);
+	_setPageState(victim, PageFreeing);
+	_activatePage(spare);
+	std::vector<uint8_t> entries(NVSFlashSim_PAGE_SIZE);
+	for(auto it = _items.begin(); it != _items.end(); ++it){
+		if(it->page != victim){
+			continue;
+		}
+		uint32_t len = it->span * NVSFlashSim_ENTRY_SIZE;
+		_read(_entryOffset(it->page, it->entry), entries.data(), len);
+		KeyCounters* kc = _keyCounters(it->ns, it->key);
+		uint32_t bytes = _counters.bytes_programmed;
+		it->page = _active;
+		it->entry = _pages[_active].next_free;
+		_writeEntries(*it, entries.data());
+		kc->relocations++;
+		kc->bytes_programmed += _counters.bytes_programmed - bytes;
+		_counters.relocations++;
+	}
+	_erasePage(victim);
+	_pages[victim].state = PageEmpty;
+	_pages[victim].seq = 0;
+	_pages[victim].next_free = 0;
+	_pages[victim].erased = 0;
+	return ESP_OK;
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t NVSFlashSim::_setItem(uint8_t ns, nvs_type_t type, const char* key, const void* data, size_t len){
+	if(strlen(key) >= NVS_KEY_NAME_MAX_SIZE){
+		return ESP_ERR_NVS_KEY_TOO_LONG;
+	}
+	if(_isVarType(type) && len > NVSFlashSim_MAX_VALUE_SIZE){
+		return ESP_ERR_NVS_VALUE_TOO_LONG;
+	}
+	_counters.user_bytes += len;
+	// como en ESP NVS, no se reescribe un valor identico al almacenado
+	auto old = _find(ns, type, key);
+	if(old != _items.end() && _isEqual(*old, data, len)){
+		_counters.skipped++;
+		return ESP_OK;
+	}
+	uint8_t span = (_isVarType(type))? 1 + (len + NVSFlashSim_ENTRY_SIZE - 1) / NVSFlashSim_ENTRY_SIZE : 1;
+	KeyCounters* kc = _keyCounters(ns, key);
+	uint32_t bytes = _counters.bytes_programmed;
+	esp_err_t err = _reserve(span);
+	if(err != ESP_OK){
+		return err;
+	}
+	std::vector<uint8_t> entries(span * NVSFlashSim_ENTRY_SIZE, 0xFF);
+	entries[0] = ns;
+	entries[1] = type;
+	entries[2] = span;
+	memset(&entries[4], 0, sizeof(uint32_t));
+	memset(&entries[EntryKeyOffset], 0, NVS_KEY_NAME_MAX_SIZE);
+	memcpy(&entries[EntryKeyOffset], key, strlen(key));
+	if(_isVarType(type)){
+		uint16_t size = len;
+		memcpy(&entries[EntryDataOffset], &size, sizeof(uint16_t));
+		memset(&entries[EntryDataOffset + 4], 0, sizeof(uint32_t));
+		memcpy(&entries[NVSFlashSim_ENTRY_SIZE], data, len);
+	}
+	else{
+		memcpy(&entries[EntryDataOffset], data, len);
+	}
+	Item item;
+	item.ns = ns;
+	item.type = type;
+	item.span = span;
+	strcpy(item.key, key);
+	item.page = _active;
+	item.entry = _pages[_active].next_free;
+	_writeEntries(item, entries.data());
+	// la entrada anterior se borra tras escribir la nueva, que ya puede haber sido reubicada
+	old = _find(ns, type, key);
+	if(old != _items.end()){
+		_eraseEntries(old);
+		kc->erases++;
+	}
+	_items.push_back(item);
+	kc->writes++;
+	kc->bytes_programmed += _counters.bytes_programmed - bytes;
+	return ESP_OK;
+}
+
+
+//------------------------------------------------------------------------------------
+bool NVSFlashSim::_isEqual(const Item& item, const void* data, size_t len){
+	uint8_t entry[NVSFlashSim_ENTRY_SIZE];
+	_read(_entryOffset(item.page, item.entry), entry, NVSFlashSim_ENTRY_SIZE);
+	if(!_isVarType(item.type)){
+		return (memcmp(&entry[EntryDataOffset], data, len) == 0);
+	}
+	uint16_t size;
+	memcpy(&size, &entry[EntryDataOffset], sizeof(uint16_t));
+	if(size != len){
+		return false;
+	}
+	std::vector<uint8_t> stored(size);
+	_read(_entryOffset(item.page, item.entry + 1), stored.data(), size);
+	return (memcmp(stored.data(), data, len) == 0);
+}
+
+
+//------------------------------------------------------------------------------------
+void NVSFlashSim::_writeEntries(const Item& item, const uint8_t* entries){
+	_program(_entryOffset(item.page, item.entry), entries, item.span * NVSFlashSim_ENTRY_SIZE);
+	_setEntryState(item.page, item.entry, item.span, EntryWritten);
+	_pages[item.page].next_free = item.entry + item.span;
+}
+
+
+//------------------------------------------------------------------------------------
+void NVSFlashSim::_eraseEntries(std::list<Item>::iterator it){
+	_setEntryState(it->page, it->entry, it->span, EntryErased);
+	_pages[it->page].erased += it->span;
+	_items.erase(it);
+}
+
+
+//------------------------------------------------------------------------------------
+std::list<NVSFlashSim::Item>::iterator NVSFlashSim::_find(uint8_t ns, uint8_t type, const char* key){
+	for(auto it = _items.begin(); it != _items.end(); ++it){
+		if(it->ns == ns && (type == NVS_TYPE_ANY || it->type == type) && strcmp(it->key, key) == 0){
+			return it;
+		}
+	}
+	return _items.end();
+}
+
+
+//------------------------------------------------------------------------------------
+NVSFlashSim::KeyCounters* NVSFlashSim::_keyCounters(uint8_t ns, const char* key){
+	char ns_name[NVS_KEY_NAME_MAX_SIZE];
+	namespaceName(ns, ns_name);
+	for(auto it = _key_counters.begin(); it != _key_counters.end(); ++it){
+		if(strcmp(it->ns, ns_name) == 0 && strcmp(it->key, key) == 0){
+			return &(*it);
+		}
+	}
+	_key_counters.emplace_back();
+	KeyCounters& kc = _key_counters.back();
+	memset(&kc, 0, sizeof(KeyCounters));
+	strcpy(kc.ns, ns_name);
+	strncpy(kc.key, key, NVS_KEY_NAME_MAX_SIZE - 1);
+	return &kc;
+}
+
+
+//------------------------------------------------------------------------------------
+//-- API NVS -------------------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+esp_err_t nvs_flash_init(){
+	return nvs_flash_init_partition(NVS_DEFAULT_PART_NAME);
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t nvs_flash_erase(){
+	return nvs_flash_erase_partition(NVS_DEFAULT_PART_NAME);
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t nvs_flash_init_partition(const char* part_name){
+	return NVSFlashSim::getPartition(part_name)->init();
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t nvs_flash_erase_partition(const char* part_name){
+	return NVSFlashSim::getPartition(part_name)->erase();
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t nvs_open(const char* name, nvs_open_mode open_mode, nvs_handle* out_handle){
+	return nvs_open_from_partition(NVS_DEFAULT_PART_NAME, name, open_mode, out_handle);
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t nvs_open_from_partition(const char* part_name, const char* name, nvs_open_mode open_mode, nvs_handle* out_handle){
+	NVSFlashSim* part = NVSFlashSim::getPartition(part_name);
+	uint8_t ns;
+	esp_err_t err = part->openNamespace(name, (open_mode == NVS_READWRITE), &ns);
+	if(err != ESP_OK){
+		return err;
+	}
+	s_mtx.lock();
+	uint32_t i = 0;
+	for(; i < s_handles.size() && s_handles[i].used; i++);
+	if(i == s_handles.size()){
+		s_handles.emplace_back();
+	}
+	s_handles[i].part = part;
+	s_handles[i].ns = ns;
+	s_handles[i].readonly = (open_mode == NVS_READONLY);
+	s_handles[i].used = true;
+	*out_handle = i + 1;
+	s_mtx.unlock();
+	return ESP_OK;
+}
+
+
+//------------------------------------------------------------------------------------
+void nvs_close(nvs_handle handle){
+	s_mtx.lock();
+	if(handle > 0 && handle <= s_handles.size()){
+		s_handles[handle - 1].used = false;
+	}
+	s_mtx.unlock();
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t nvs_commit(nvs_handle handle){
+	SimHandle h;
+	return (_getHandle(handle, &h))? h.part->commit() : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t nvs_erase_key(nvs_handle handle, const char* key){
+	SimHandle h;
+	if(!_getHandle(handle, &h)){
+		return ESP_ERR_NVS_INVALID_HANDLE;
+	}
+	return (h.readonly)? ESP_ERR_NVS_READ_ONLY : h.part->eraseItem(h.ns, key);
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t nvs_erase_all(nvs_handle handle){
+	SimHandle h;
+	if(!_getHandle(handle, &h)){
+		return ESP_ERR_NVS_INVALID_HANDLE;
+	}
+	return (h.readonly)? ESP_ERR_NVS_READ_ONLY : h.part->eraseNamespace(h.ns);
+}
+
+
+//------------------------------------------------------------------------------------
+esp_err_t nvs_set_u8(nvs_handle handle, const char* key, uint8_t value){ return _set(handle, key, NVS_TYPE_U8, &value, sizeof(value)); }
+esp_err_t nvs_set_i8(nvs_handle handle, const char* key, int8_t value){ return _set(handle, key, NVS_TYPE_I8, &value, sizeof(value)); }
+esp_err_t nvs_set_u16(nvs_handle handle, const char* key, uint16_t value){ return _set(handle, key, NVS_TYPE_U16, &value, sizeof(value)); }
+esp_err_t nvs_set_i16(nvs_handle handle, const char* key, int16_t value){ return _set(handle, key, NVS_TYPE_I16, &value, sizeof(value)); }
+esp_err_t nvs_set_u32(nvs_handle handle, const char* key, uint32_t value){ return _set(handle, key, NVS_TYPE_U32, &value, sizeof(value)); }
+esp_err_t nvs_set_i32(nvs_handle handle, const char* key, int32_t value){ return _set(handle, key, NVS_TYPE_I32, &value, sizeof(value)); }
+esp_err_t nvs_set_u64(nvs_handle handle, const char* key, uint64_t value){ return _set(handle, key, NVS_TYPE_U64, &value, sizeof(value)); }
+esp_err_t nvs_set_i64(nvs_handle handle, const char* key, int64_t value){ return _set(handle, key, NVS_TYPE_I64, &value, sizeof(value)); }
+esp_err_t nvs_set_str(nvs_handle handle, const char* key, const char* value){ return _set(handle, key, NVS_TYPE_STR, value, strlen(value) + 1); }
+esp_err_t nvs_set_blob(nvs_handle handle, const char* key, const void* value, size_t length){ return _set(handle, key, NVS_TYPE_BLOB, value, length); }
+
+
+//------------------------------------------------------------------------------------
+esp_err_t nvs_get_u8(nvs_handle handle, const char* key, uint8_t* out_value){ size_t len = sizeof(*out_value); return _get(handle, key, NVS_TYPE_U8, out_value, &len); }
+esp_err_t nvs_get_i8(nvs_handle handle, const char* key, int8_t* out_value){ size_t len = sizeof(*out_value); return _get(handle, key, NVS_TYPE_I8, out_value, &len); }
+esp_err_t nvs_get_u16(nvs_handle handle, const char* key, uint16_t* out_value){ size_t len = sizeof(*out_value); return _get(handle, key, NVS_TYPE_U16, out_value, &len); }
+esp_err_t nvs_get_i16(nvs_handle handle, const char* key, int16_t* out_value){ size_t len = sizeof(*out_value); return _get(handle, key, NVS_TYPE_I16, out_value, &len); }
+esp_err_t nvs_get_u32(nvs_handle handle, const char* key, uint32_t* out_value){ size_t len = sizeof(*out_value); return _get(handle, key, NVS_TYPE_U32, out_value, &len); }
+esp_err_t nvs_get_i32(nvs_handle handle, const char* key, int32_t* out_value){ size_t len = sizeof(*out_value); return _get(handle, key, NVS_TYPE_I32, out_value, &len); }
+esp_err_t nvs_get_u64(nvs_handle handle, const char* key, uint64_t* out_value){ size_t len = sizeof(*out_value); return _get(handle, key, NVS_TYPE_U64, out_value, &len); }
+esp_err_t nvs_get_i64(nvs_handle handle, const char* key, int64_t* out_value){ size_t len = sizeof(*out_value); return _get(handle, key, NVS_TYPE_I64, out_value, &len); }
+esp_err_t nvs_get_str(nvs_handle handle, const char* key, char* out_value, size_t* length){ return _get(handle, key, NVS_TYPE_STR, out_value, length); }
+esp_err_t nvs_get_blob(nvs_handle handle, const char* key, void* out_value, size_t* length){ return _get(handle, key, NVS_TYPE_BLOB, out_value, length); }
+
+
+//------------------------------------------------------------------------------------
+nvs_iterator_t nvs_entry_find(const char* part_name, const char* namespace_name, nvs_type_t type){
+	NVSFlashSim* part = NVSFlashSim::getPartition(part_name);
+	nvs_iterator_t it = new nvs_opaque_iterator_t();
+	MBED_ASSERT(it);
+	it->pos = 0;
+	part->lock();
+	const std::list<NVSFlashSim::Item>& items = part->items();
+	for(auto i = items.begin(); i != items.end(); ++i){
+		nvs_entry_info_t info;
+		if(i->ns == 0 || (type != NVS_TYPE_ANY && i->type != type) || !part->namespaceName(i->ns, info.namespace_name)){
+			continue;
+		}
+		if(namespace_name && strcmp(namespace_name, info.namespace_name) != 0){
+			continue;
+		}
+		strcpy(info.key, i->key);
+		info.type = (nvs_type_t)i->type;
+		it->entries.push_back(info);
+	}
+	part->unlock();
+	if(it->entries.empty()){
+		delete(it);
+		return NULL;
+	}
+	return it;
+}
+
+
+//------------------------------------------------------------------------------------
+nvs_iterator_t nvs_entry_next(nvs_iterator_t iterator){
+	if(++iterator->pos >= iterator->entries.size()){
+		delete(iterator);
+		return NULL;
+	}
+	return iterator;
+}
+
+
+//------------------------------------------------------------------------------------
+void nvs_entry_info(nvs_iterator_t iterator, nvs_entry_info_t* out_info){
+	*out_info = iterator->entries[iterator->pos];
+}
+
+
+//------------------------------------------------------------------------------------
+void nvs_release_iterator(nvs_iterator_t iterator){
+	delete(iterator);
+}
+
+#endif
+
+/**** END OF FILE ****/
@@ -0,0 +1,377 @@
+/*
+ * NVSFlashSim.h
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ *
+ *	NVSFlashSim es una implementacion en proceso de la API NVS de ESP-IDF (nvs_flash_init, nvs_open_from_partition,
+ *  nvs_set_xxx, nvs_get_xxx, nvs_commit, nvs_entry_find...) para compilaciones en el host. Permite ejecutar
+ *  FSManager en el host y medir el desgaste y la latencia de los patrones de uso antes de llevarlos al dispositivo.
+ *
+ *  La flash simulada se organiza como en ESP NVS:
+ *  - Paginas de 4096 bytes con cabecera de 32 bytes, mapa de estados de 32 bytes (2 bits por entrada) y 126
+ *    entradas de 32 bytes.
+ *  - Cada valor ocupa una entrada (ns, tipo, span, clave, 8 bytes de dato). Las cadenas y blobs ocupan ademas
+ *    tantas entradas como requieran sus datos, contiguas en la misma pagina (maximo 4000 bytes).
+ *  - Las escrituras se anaden en la pagina activa y marcan como borrada la entrada anterior. Al llenarse la
+ *    particion, se libera la pagina llena mas antigua con entradas borradas, reubicando sus entradas validas en la
+ *    pagina libre de reserva.
+ *  - La programacion solo puede pasar bits de 1 a 0. El borrado de pagina los devuelve a 1.
+ *
+ *  La flash reside en RAM o en un archivo (imagen persistente entre ejecuciones). Cada lectura, programacion y
+ *  borrado acumula una latencia configurable, que puede ademas aplicarse con esperas reales.
+ *  No se simulan cortes de alimentacion ni CRC de entradas.
+ */
+
+#ifndef __NVSFlashSim__H
+#define __NVSFlashSim__H
+
+#include "mbed.h"
+
+/** El simulador solo se habilita por defecto en compilaciones para el host (Linux). En los dispositivos mbed la
+ *  flash en RAM perderia los datos en cada reinicio, por lo que debe habilitarse explicitamente.
+ */
+#if !defined(NVSFlashSim_ENABLED)
+#if defined(__linux__) && ESP_PLATFORM != 1 && !defined(__MBED__)
+#define NVSFlashSim_ENABLED		1
+#else
+#define NVSFlashSim_ENABLED		0
+#endif
+#endif
+
+#if NVSFlashSim_ENABLED == 1
+
+#include <list>
+#include <vector>
+
+
+//------------------------------------------------------------------------------------
+//-- API NVS (compatible con nvs.h y nvs_flash.h de ESP-IDF) -------------------------
+//------------------------------------------------------------------------------------
+
+#if !defined(ESP_OK)
+typedef int esp_err_t;
+#define ESP_OK								0
+#define ESP_FAIL							-1
+#endif
+#if !defined(ESP_ERR_INVALID_ARG)
+#define ESP_ERR_INVALID_ARG					0x102
+#endif
+
+#define ESP_ERR_NVS_BASE					0x1100
+#define ESP_ERR_NVS_NOT_INITIALIZED			(ESP_ERR_NVS_BASE + 0x01)
+#define ESP_ERR_NVS_NOT_FOUND				(ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_TYPE_MISMATCH			(ESP_ERR_NVS_BASE + 0x03)
+#define ESP_ERR_NVS_READ_ONLY				(ESP_ERR_NVS_BASE + 0x04)
+#define ESP_ERR_NVS_NOT_ENOUGH_SPACE		(ESP_ERR_NVS_BASE + 0x05)
+#define ESP_ERR_NVS_INVALID_NAME			(ESP_ERR_NVS_BASE + 0x06)
+#define ESP_ERR_NVS_INVALID_HANDLE			(ESP_ERR_NVS_BASE + 0x07)
+#define ESP_ERR_NVS_KEY_TOO_LONG			(ESP_ERR_NVS_BASE + 0x09)
+#define ESP_ERR_NVS_INVALID_LENGTH			(ESP_ERR_NVS_BASE + 0x0c)
+#define ESP_ERR_NVS_NO_FREE_PAGES			(ESP_ERR_NVS_BASE + 0x0d)
+#define ESP_ERR_NVS_VALUE_TOO_LONG			(ESP_ERR_NVS_BASE + 0x0e)
+
+#define NVS_DEFAULT_PART_NAME				"nvs"
+#define NVS_KEY_NAME_MAX_SIZE				16
+
+typedef uint32_t nvs_handle;
+typedef uint32_t nvs_handle_t;
+
+typedef enum{
+	NVS_READONLY,
+	NVS_READWRITE
+}nvs_open_mode;
+
+typedef enum{
+	NVS_TYPE_U8 = 0x01,
+	NVS_TYPE_I8 = 0x11,
+	NVS_TYPE_U16 = 0x02,
+	NVS_TYPE_I16 = 0x12,
+	NVS_TYPE_U32 = 0x04,
+	NVS_TYPE_I32 = 0x14,
+	NVS_TYPE_U64 = 0x08,
+	NVS_TYPE_I64 = 0x18,
+	NVS_TYPE_STR = 0x21,
+	NVS_TYPE_BLOB = 0x42,
+	NVS_TYPE_ANY = 0xff
+}nvs_type_t;
+
+typedef struct{
+	char namespace_name[NVS_KEY_NAME_MAX_SIZE];
+	char key[NVS_KEY_NAME_MAX_SIZE];
+	nvs_type_t type;
+}nvs_entry_info_t;
+
+typedef struct nvs_opaque_iterator_t* nvs_iterator_t;
+
+esp_err_t nvs_flash_init();
+esp_err_t nvs_flash_erase();
+esp_err_t nvs_flash_init_partition(const char* part_name);
+esp_err_t nvs_flash_erase_partition(const char* part_name);
+esp_err_t nvs_open(const char* name, nvs_open_mode open_mode, nvs_handle* out_handle);
+esp_err_t nvs_open_from_partition(const char* part_name, const char* name, nvs_open_mode open_mode, nvs_handle* out_handle);
+void nvs_close(nvs_handle handle);
+esp_err_t nvs_commit(nvs_handle handle);
+esp_err_t nvs_erase_key(nvs_handle handle, const char* key);
+esp_err_t nvs_erase_all(nvs_handle handle);
+esp_err_t nvs_set_u8(nvs_handle handle, const char* key, uint8_t value);
+esp_err_t nvs_set_i8(nvs_handle handle, const char* key, int8_t value);
+esp_err_t nvs_set_u16(nvs_handle handle, const char* key, uint16_t value);
+esp_err_t nvs_set_i16(nvs_handle handle, const char* key, int16_t value);
+esp_err_t nvs_set_u32(nvs_handle handle, const char* key, uint32_t value);
+esp_err_t nvs_set_i32(nvs_handle handle, const char* key, int32_t value);
+esp_err_t nvs_set_u64(nvs_handle handle, const char* key, uint64_t value);
+esp_err_t nvs_set_i64(nvs_handle handle, const char* key, int64_t value);
+esp_err_t nvs_set_str(nvs_handle handle, const char* key, const char* value);
+esp_err_t nvs_set_blob(nvs_handle handle, const char* key, const void* value, size_t length);
+esp_err_t nvs_get_u8(nvs_handle handle, const char* key, uint8_t* out_value);
+esp_err_t nvs_get_i8(nvs_handle handle, const char* key, int8_t* out_value);
+esp_err_t nvs_get_u16(nvs_handle handle, const char* key, uint16_t* out_value);
+esp_err_t nvs_get_i16(nvs_handle handle, const char* key, int16_t* out_value);
+esp_err_t nvs_get_u32(nvs_handle handle, const char* key, uint32_t* out_value);
+esp_err_t nvs_get_i32(nvs_handle handle, const char* key, int32_t* out_value);
+esp_err_t nvs_get_u64(nvs_handle handle, const char* key, uint64_t* out_value);
+esp_err_t nvs_get_i64(nvs_handle handle, const char* key, int64_t* out_value);
+esp_err_t nvs_get_str(nvs_handle handle, const char* key, char* out_value, size_t* length);
+esp_err_t nvs_get_blob(nvs_handle handle, const char* key, void* out_value, size_t* length);
+nvs_iterator_t nvs_entry_find(const char* part_name, const char* namespace_name, nvs_type_t type);
+nvs_iterator_t nvs_entry_next(nvs_iterator_t iterator);
+void nvs_entry_info(nvs_iterator_t iterator, nvs_entry_info_t* out_info);
+void nvs_release_iterator(nvs_iterator_t iterator);
+
+
+//------------------------------------------------------------------------------------
+//-- SIMULADOR -----------------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+#define NVSFlashSim_PAGE_SIZE				4096
+#define NVSFlashSim_ENTRY_SIZE				32
+#define NVSFlashSim_ENTRIES_PER_PAGE		126
+#define NVSFlashSim_MAX_VALUE_SIZE			((NVSFlashSim_ENTRIES_PER_PAGE - 1) * NVSFlashSim_ENTRY_SIZE)
+#define NVSFlashSim_DEFAULT_PAGES			6		//Particion de 24KB (0x6000)
+
+
+class NVSFlashSim{
+  public:
+
+	/** Config
+	 *  Configuracion de una particion simulada
+	 */
+	struct Config{
+		uint16_t num_pages;			/// Numero de paginas de la particion (minimo 2)
+		const char* filename;		/// Archivo de la imagen de flash, NULL para mantenerla en RAM
+		uint32_t read_us;			/// Latencia de lectura por entrada de 32 bytes
+		uint32_t program_us;		/// Latencia de programacion por entrada de 32 bytes o palabra de estado
+		uint32_t erase_us;			/// Latencia de borrado de pagina
+		uint32_t commit_us;			/// Latencia de nvs_commit
+		bool sleep;					/// Flag para aplicar las latencias como esperas reales (wait_us)
+	};
+
+	/** Counters
+	 *  Contadores de operaciones sobre la flash simulada
+	 */
+	struct Counters{
+		uint32_t page_erases;		/// Borrados de pagina
+		uint32_t max_page_erases;	/// Borrados de la pagina mas desgastada
+		uint32_t programs;			/// Operaciones de programacion (entradas y palabras de estado)
+		uint32_t bytes_programmed;	/// Bytes programados en flash
+		uint32_t user_bytes;		/// Bytes escritos por la aplicacion (nvs_set_xxx)
+		uint32_t reads;				/// Operaciones de lectura
+		uint32_t bytes_read;		/// Bytes leidos de flash
+		uint32_t relocations;		/// Entradas reubicadas al liberar paginas
+		uint32_t skipped;			/// Escrituras descartadas por coincidir con el valor almacenado
+		uint32_t commits;			/// Llamadas a nvs_commit
+		uint64_t busy_us;			/// Tiempo acumulado de acceso a la flash
+	};
+
+	/** KeyCounters
+	 *  Contadores de una clave, obtenidos en <forEachKey>
+	 */
+	struct KeyCounters{
+		char ns[NVS_KEY_NAME_MAX_SIZE];		/// Namespace
+		char key[NVS_KEY_NAME_MAX_SIZE];	/// Clave
+		uint32_t writes;					/// Escrituras programadas
+		uint32_t erases;					/// Borrados (por sobreescritura o nvs_erase_key)
+		uint32_t bytes_programmed;			/// Bytes programados, incluyendo cabeceras y reubicaciones
+		uint32_t relocations;				/// Veces que ha sido reubicada al liberar paginas
+	};
+
+
+	/** configure
+	 *  Configura una particion simulada, creandola si no existe. Debe invocarse antes de nvs_flash_init_partition
+	 *  @param label Nombre de la particion
+	 *  @param cfg Configuracion
+	 *  @return Particion
+	 */
+	static NVSFlashSim* configure(const char* label, const Config& cfg);
+
+
+	/** getPartition
+	 *  Obtiene una particion simulada, creandola con la configuracion por defecto si no existe
+	 *  @param label Nombre de la particion
+	 *  @return Particion
+	 */
+	static NVSFlashSim* getPartition(const char* label);
+
+
+	/** defaultConfig
+	 *  Obtiene la configuracion por defecto: NVSFlashSim_DEFAULT_PAGES paginas en RAM sin latencia
+	 *  @return Configuracion
+	 */
+	static Config defaultConfig();
+
+
+	/** getCounters
+	 *  Obtiene los contadores de la particion
+	 *  @param counters Recibe los contadores
+	 */
+	void getCounters(Counters* counters);
+
+
+	/** resetCounters
+	 *  Reinicia los contadores globales y por clave. El desgaste por pagina se conserva
+	 */
+	void resetCounters();
+
+
+	/** forEachKey
+	 *  Recorre los contadores por clave
+	 *  @param visitor Callback invocada por cada clave. Si devuelve false se detiene el recorrido
+	 *  @return Numero de claves visitadas
+	 */
+	int forEachKey(Callback<bool(const KeyCounters&)> visitor);
+
+
+	/** getPageErases
+	 *  Obtiene el numero de borrados de una pagina
+	 *  @param page Indice de pagina
+	 *  @return Borrados acumulados desde la creacion de la particion
+	 */
+	uint32_t getPageErases(uint16_t page) { return (page < _cfg.num_pages)? _page_erases[page] : 0; }
+
+
+	/** getFreeEntries
+	 *  Obtiene el numero de entradas libres, incluyendo las borradas recuperables
+	 *  @return Entradas libres
+	 */
+	uint32_t getFreeEntries();
+
+
+	/** setCommitError
+	 *  Fuerza el resultado de las siguientes llamadas a nvs_commit, para simular fallos de la flash
+	 *  @param err Codigo devuelto por nvs_commit (ESP_OK restablece el funcionamiento normal)
+	 */
+	void setCommitError(esp_err_t err) { _commit_err = err; }
+
+
+	/** Operaciones de la API NVS */
+	esp_err_t init();
+	esp_err_t erase();
+	esp_err_t openNamespace(const char* name, bool create, uint8_t* ns);
+	esp_err_t setItem(uint8_t ns, nvs_type_t type, const char* key, const void* data, size_t len);
+	esp_err_t getItem(uint8_t ns, nvs_type_t type, const char* key, void* data, size_t* len);
+	esp_err_t eraseItem(uint8_t ns, const char* key);
+	esp_err_t eraseNamespace(uint8_t ns);
+	esp_err_t commit();
+	bool isReady() { return _ready; }
+
+	/** Entrada del indice de claves en RAM */
+	struct Item{
+		uint8_t ns;
+		uint8_t type;
+		uint8_t span;
+		char key[NVS_KEY_NAME_MAX_SIZE];
+		uint16_t page;
+		uint8_t entry;
+	};
+
+	/** Obtiene el indice de claves (acceso bajo <lock>) */
+	const std::list<Item>& items() { return _items; }
+
+	/** Obtiene el nombre de un namespace a partir de su indice */
+	bool namespaceName(uint8_t ns, char* name);
+
+	void lock() { _mtx.lock(); }
+	void unlock() { _mtx.unlock(); }
+
+	const char* getLabel() { return _label; }
+
+  private:
+
+	/** Estados de pagina, segun ESP NVS */
+	enum PageState{
+		PageEmpty = 0xFFFFFFFF,
+		PageActive = 0xFFFFFFFE,
+		PageFull = 0xFFFFFFFC,
+		PageFreeing = 0xFFFFFFF8,
+	};
+
+	/** Estados de entrada (2 bits) */
+	enum EntryState{
+		EntryEmpty = 3,
+		EntryWritten = 2,
+		EntryErased = 0,
+	};
+
+	/** Namespace registrado en la particion */
+	struct Namespace{
+		char name[NVS_KEY_NAME_MAX_SIZE];
+		uint8_t index;
+	};
+
+	/** Estado en RAM de una pagina */
+	struct PageInfo{
+		uint32_t state;
+		uint32_t seq;
+		uint8_t next_free;
+		uint8_t erased;
+	};
+
+	NVSFlashSim(const char* label, const Config& cfg);
+
+	char _label[NVS_KEY_NAME_MAX_SIZE];
+	Config _cfg;
+	bool _ready;
+	Mutex _mtx;
+	std::vector<uint8_t> _flash;
+	FILE* _fp;
+	std::vector<PageInfo> _pages;
+	std::vector<uint32_t> _page_erases;
+	std::list<Item> _items;
+	std::list<Namespace> _namespaces;
+	std::list<KeyCounters> _key_counters;
+	int32_t _active;
+	uint32_t _seq;
+	Counters _counters;
+	esp_err_t _commit_err;
+
+	/** Operaciones primitivas sobre la flash, contabilizadas */
+	void _read(uint32_t offset, void* data, uint32_t len);
+	void _program(uint32_t offset, const void* data, uint32_t len);
+	void _erasePage(uint16_t page);
+	void _delay(uint32_t us);
+
+	uint32_t _entryOffset(uint16_t page, uint8_t entry) { return page * NVSFlashSim_PAGE_SIZE + 64 + entry * NVSFlashSim_ENTRY_SIZE; }
+	uint8_t _entryState(uint16_t page, uint8_t entry);
+	void _setEntryState(uint16_t page, uint8_t entry, uint8_t span, EntryState state);
+	void _setPageState(uint16_t page, uint32_t state);
+
+	void _scan();
+	esp_err_t _reserve(uint8_t span);
+	esp_err_t _collect();
+	void _activatePage(uint16_t page);
+	esp_err_t _setItem(uint8_t ns, nvs_type_t type, const char* key, const void* data, size_t len);
+	bool _isEqual(const Item& item, const void* data, size_t len);
+	void _writeEntries(const Item& item, const uint8_t* entries);
+	void _eraseEntries(std::list<Item>::iterator it);
+	std::list<Item>::iterator _find(uint8_t ns, uint8_t type, const char* key);
+	KeyCounters* _keyCounters(uint8_t ns, const char* key);
+
+	static std::list<NVSFlashSim*> _partitions;
+};
+
+#endif
+
+#endif /*__NVSFlashSim__H */
+
+/**** END OF FILE ****/
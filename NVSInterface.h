@@ -12,8 +12,10 @@
 #define __NVSInterface__H
 
 #include "mbed.h"
+#include <type_traits>
 
 #define DEFAULT_NVSInterface_Partition	(const char*)"nvs_key"
+#define NVSInterface_KEY_MAX_SIZE		16		//Longitud maxima de una clave, incluyendo el terminador
 
 class NVSInterface{
   public:
@@ -31,7 +33,27 @@ class NVSInterface{
 		TypeUint64,//!< TypeUint64
 		TypeInt64, //!< TypeInt64
 		TypeString,//!< TypeString
-		TypeBlob   //!< TypeBlob
+		TypeBlob,  //!< TypeBlob
+		TypeAny    //!< TypeAny (solo como filtro en <forEachKey>)
+	};
+
+	/** KeyInfo
+	 * 	Informacion de una clave almacenada, obtenida en <forEachKey>
+	 */
+	struct KeyInfo{
+		char key[NVSInterface_KEY_MAX_SIZE];	/// Identificador de la clave
+		KeyValueType type;						/// Tipo de dato
+		uint32_t size;							/// Tamanio almacenado en bytes
+	};
+
+	/** KeyValueEntry
+	 * 	Entrada de una operacion en bloque <saveBatch>/<restoreBatch>
+	 */
+	struct KeyValueEntry{
+		const char* data_id;	/// Identificador de la clave
+		KeyValueType type;		/// Tipo de dato
+		void* data;				/// Puntero a los datos
+		uint32_t size;			/// Tamanio de los datos en bytes
 	};
               
     /** Constructor
@@ -112,11 +134,175 @@ class NVSInterface{
      */
     virtual int removeKey(const char* data_id) = 0;
 
+
+    /** saveBatch
+     *  Graba un conjunto de claves en una misma sesion. La implementacion por defecto invoca <save> en cada
+     *  entrada y se detiene en el primer error, sin deshacer las claves ya grabadas.
+     *  @param entries Array de entradas a grabar
+     *  @param count Numero de entradas
+     *  @return codigo de error (0=OK)
+     */
+    virtual int saveBatch(KeyValueEntry* entries, uint32_t count){
+    	for(uint32_t i=0; i<count; i++){
+    		int err = save(entries[i].data_id, entries[i].data, entries[i].size, entries[i].type);
+    		if(err != 0){
+    			return err;
+    		}
+    	}
+    	return 0;
+    }
+
+
+    /** restoreBatch
+     *  Recupera un conjunto de claves en una misma sesion. Se detiene en el primer error.
+     *  @param entries Array de entradas a recuperar
+     *  @param count Numero de entradas
+     *  @return codigo de error (0=OK)
+     */
+    virtual int restoreBatch(KeyValueEntry* entries, uint32_t count){
+    	for(uint32_t i=0; i<count; i++){
+    		int err = restore(entries[i].data_id, entries[i].data, entries[i].size, entries[i].type);
+    		if(err != 0){
+    			return err;
+    		}
+    	}
+    	return 0;
+    }
+
+    /** forEachKey
+     *  Recorre las claves almacenadas, filtrando por prefijo y tipo. La informacion de cada clave se entrega en
+     *  una estructura reutilizada, sin reservas de memoria por entrada. La implementacion por defecto no soporta
+     *  la enumeracion de claves.
+     *  @param prefix Prefijo de las claves a recorrer (NULL o "" para todas)
+     *  @param type Tipo de las claves a recorrer (TypeAny para todos)
+     *  @param visitor Callback invocada por cada clave. Si devuelve false se detiene el recorrido
+     *  @return Numero de claves visitadas o <0 si hay error
+     */
+    virtual int forEachKey(const char* prefix, KeyValueType type, Callback<bool(const KeyInfo&)> visitor){
+    	return -1;
+    }
+
     /** erase
      * Borra la particion
      * @return true|false
      * */
     virtual bool erase() = 0;
+
+
+    /** valueSize
+     *  Obtiene el tamanio que ocupa un valor en funcion de su tipo
+     *  @param data Puntero a los datos (solo se consulta en TypeString)
+     *  @param size Tamanio indicado por el llamante (TypeBlob, o TypeString si data es NULL)
+     *  @param type Tipo de dato
+     *  @return Tamanio en bytes
+     */
+    static uint32_t valueSize(const void* data, uint32_t size, KeyValueType type){
+    	switch(type){
+    		case TypeUint8:
+    		case TypeInt8:
+    			return 1;
+    		case TypeUint16:
+    		case TypeInt16:
+    			return 2;
+    		case TypeUint32:
+    		case TypeInt32:
+    			return 4;
+    		case TypeUint64:
+    		case TypeInt64:
+    			return 8;
+    		case TypeString:
+    			return (data != NULL)? strlen((const char*)data) + 1 : size;
+    		default:
+    			return size;
+    	}
+    }
+
+
+    /** typeOf
+     *  Obtiene en tiempo de compilacion el KeyValueType asociado a un tipo C++. Los enteros se asocian a su tipo
+     *  nativo y el resto de tipos trivialmente copiables (estructuras, arrays, float...) a TypeBlob
+     *  @return Tipo de dato
+     */
+    static constexpr KeyValueType typeOf(const bool*) { return TypeUint8; }
+    static constexpr KeyValueType typeOf(const uint8_t*) { return TypeUint8; }
+    static constexpr KeyValueType typeOf(const int8_t*) { return TypeInt8; }
+    static constexpr KeyValueType typeOf(const uint16_t*) { return TypeUint16; }
+    static constexpr KeyValueType typeOf(const int16_t*) { return TypeInt16; }
+    static constexpr KeyValueType typeOf(const uint32_t*) { return TypeUint32; }
+    static constexpr KeyValueType typeOf(const int32_t*) { return TypeInt32; }
+    static constexpr KeyValueType typeOf(const uint64_t*) { return TypeUint64; }
+    static constexpr KeyValueType typeOf(const int64_t*) { return TypeInt64; }
+    template<typename T>
+    static constexpr KeyValueType typeOf(const T*) { return TypeBlob; }
+
+
+    /** save
+     *  Graba un valor tipado. El tipo de dato y su tamanio se resuelven en tiempo de compilacion, de forma que un
+     *  tipo no almacenable (punteros, clases no trivialmente copiables) se detecta al compilar. Es solo una
+     *  comprobacion de tipos: el valor se graba mediante el <save> virtual, por lo que el coste es el mismo y la
+     *  implementacion sigue seleccionando la operacion segun el KeyValueType en tiempo de ejecucion.
+     *  @param data_id Identificador de los datos a grabar
+     *  @param value Valor a grabar
+     *  @return codigo de error
+     */
+    template<typename T>
+    int save(const char* data_id, const T& value){
+    	static_assert(std::is_trivially_copyable<T>::value && !std::is_pointer<T>::value, "Tipo no almacenable en NVS");
+    	return save(data_id, (void*)&value, sizeof(T), typeOf((const T*)0));
+    }
+
+
+    /** save
+     *  Graba una cadena de caracteres terminada en 0
+     *  @param data_id Identificador de los datos a grabar
+     *  @param str Cadena a grabar
+     *  @return codigo de error
+     */
+    int save(const char* data_id, const char* str){
+    	return save(data_id, (void*)str, strlen(str) + 1, TypeString);
+    }
+    int save(const char* data_id, char* str){
+    	return save(data_id, (const char*)str);
+    }
+
+
+    /** restore
+     *  Recupera un valor tipado. El tipo de dato y su tamanio se resuelven en tiempo de compilacion y el valor se
+     *  recupera mediante el <restore> virtual, con el mismo coste
+     *  @param data_id Identificador de los datos a recuperar
+     *  @param value Recibe el valor recuperado
+     *  @return codigo de error
+     */
+    template<typename T>
+    int restore(const char* data_id, T& value){
+    	static_assert(std::is_trivially_copyable<T>::value && !std::is_pointer<T>::value, "Tipo no almacenable en NVS");
+    	return restore(data_id, (void*)&value, sizeof(T), typeOf((const T*)0));
+    }
+
+
+    /** restore
+     *  Recupera una cadena de caracteres en un buffer de tamanio conocido en tiempo de compilacion
+     *  @param data_id Identificador de los datos a recuperar
+     *  @param str Buffer que recibe la cadena
+     *  @return codigo de error
+     */
+    template<size_t N>
+    int restore(const char* data_id, char (&str)[N]){
+    	return restore(data_id, (void*)str, N, TypeString);
+    }
+
+
+    /** restore
+     *  Recupera una cadena de caracteres
+     *  @param data_id Identificador de los datos a recuperar
+     *  @param str Buffer que recibe la cadena
+     *  @param size Tamanio del buffer
+     *  @return codigo de error
+     */
+    int restore(const char* data_id, char* str, uint32_t size){
+    	return restore(data_id, (void*)str, size, TypeString);
+    }
+
   protected:
 
     const char* _name;          /// Nombre del sistema de ficheros
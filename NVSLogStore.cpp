@@ -0,0 +1,475 @@
+/*
+ * NVSLogStore.cpp
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ */
+
+#include "NVSLogStore.h"
+#include <vector>
+
+
+//------------------------------------------------------------------------------------
+//--- PRIVATE TYPES ------------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+static const char* _MODULE_ = "[LogStore]......";
+#define _EXPR_	(_defdbg && !IS_ISR())
+
+/** Tamanio del buffer de pila utilizado para copiar y verificar registros */
+static const uint32_t CopyBufferSize = 128;
+
+
+//------------------------------------------------------------------------------------
+//-- PUBLIC METHODS IMPLEMENTATION ---------------------------------------------------
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+NVSLogStore::NVSLogStore(const char* name, FATInterface* fat, bool defdbg) : NVSInterface(name), _cp_sem(0, 1) {
+	_defdbg = defdbg;
+	_ready = false;
+	_fat = fat;
+	_fp = NULL;
+	_log_size = 0;
+	_live_size = 0;
+	_live_ratio = NVSLogStore_DEFAULT_LIVE_RATIO;
+	_compacting = false;
+	_log_gen = 0;
+	_cp_th = NULL;
+	_cp_stop = false;
+	snprintf(_log_file, MAX_PATH_NAME_LENGTH, "%s.kvl", name);
+	snprintf(_tmp_file, MAX_PATH_NAME_LENGTH, "%s.kvt", name);
+	_mtx.lock();
+	init();
+	_mtx.unlock();
+}
+
+
+//------------------------------------------------------------------------------------
+NVSLogStore::~NVSLogStore(){
+	stopCompaction();
+	if(_fp){
+		_fat->close(_fp);
+	}
+}
+
+
+//------------------------------------------------------------------------------------
+int NVSLogStore::init(){
+	if(!_fat || !_fat->isReady()){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_FAT, Particion FAT no disponible");
+		return -1;
+	}
+	// Recuperacion de una compactacion interrumpida
+	if(_fat->fileExists(_tmp_file)){
+		if(!_fat->fileExists(_log_file)){
+			DEBUG_TRACE_W(_EXPR_, _MODULE_, "Recuperando log compactado %s", _tmp_file);
+			_fat->renameFile(_tmp_file, _log_file);
+		}
+		else{
+			_fat->eraseFile(_tmp_file);
+		}
+	}
+	_fp = _fat->open(_log_file, "r+b");
+	if(!_fp){
+		_fp = _fat->open(_log_file, "w+b");
+	}
+	if(!_fp){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_OPEN, No se puede abrir el log %s", _log_file);
+		return -1;
+	}
+	uint32_t valid_end = _replay();
+	fseek(_fp, 0, SEEK_END);
+	uint32_t file_size = ftell(_fp);
+	_log_size = valid_end;
+	_ready = true;
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Log %s: %d claves, %d/%d bytes vigentes", _log_file, (int)_index.size(), _live_size, _log_size);
+	// Un registro incompleto al final del log se descarta reescribiendo los vigentes
+	if(valid_end < file_size){
+		DEBUG_TRACE_W(_EXPR_, _MODULE_, "Log %s truncado en %d (%d bytes), compactando", _log_file, valid_end, file_size);
+		return compact();
+	}
+	return 0;
+}
+
+
+//------------------------------------------------------------------------------------
+bool NVSLogStore::open(){
+	_mtx.lock();
+	if(!_ready){
+		_mtx.unlock();
+		return false;
+	}
+	return true;
+}
+
+
+//------------------------------------------------------------------------------------
+void NVSLogStore::close(){
+	if(_fp){
+		_fat->flush(_fp);
+	}
+	_mtx.unlock();
+}
+
+
+//------------------------------------------------------------------------------------
+int NVSLogStore::compactIfNeeded(){
+	_mtx.lock();
+	bool needed = _needsCompaction();
+	_mtx.unlock();
+	if(!needed){
+		return 0;
+	}
+	int err = compact();
+	return (err == 0)? 1 : err;
+}
+
+
+//------------------------------------------------------------------------------------
+int NVSLogStore::startCompaction(uint32_t stack_size, osPriority priority){
+	if(_cp_th){
+		return 0;
+	}
+	_cp_stop = false;
+	_cp_th = new Thread(priority, stack_size, NULL, "LogCompact");
+	MBED_ASSERT(_cp_th);
+	if(_cp_th->start(callback(this, &NVSLogStore::_compactTask)) != osOK){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_THREAD, No se puede arrancar el thread de compactacion");
+		delete(_cp_th);
+		_cp_th = NULL;
+		return -1;
+	}
+	// el umbral puede haberse cruzado antes de arrancar el thread
+	_cp_sem.release();
+	return 0;
+}
+
+
+//------------------------------------------------------------------------------------
+void NVSLogStore::stopCompaction(){
+	if(!_cp_th){
+		return;
+	}
+	_cp_stop = true;
+	_cp_sem.release();
+	_cp_th->join();
+	delete(_cp_th);
+	_cp_th = NULL;
+}
+
+
+//------------------------------------------------------------------------------------
+int NVSLogStore::save(const char* data_id, void* data, uint32_t size, NVSInterface::KeyValueType type){
+	if(strlen(data_id) >= NVSInterface_KEY_MAX_SIZE || type >= NVSInterface::TypeAny){
+		_error = -1;
+		return _error;
+	}
+	_mtx.lock();
+	_error = _append(data_id, data, NVSInterface::valueSize(data, size, type), type, 0);
+	_mtx.unlock();
+	return _error;
+}
+
+
+//------------------------------------------------------------------------------------
+int NVSLogStore::restore(const char* data_id, void* data, uint32_t size, NVSInterface::KeyValueType type){
+	_mtx.lock();
+	auto it = _index.find(data_id);
+	if(it == _index.end() || it->second.type != type){
+		_mtx.unlock();
+		_error = -1;
+		return _error;
+	}
+	IndexEntry& e = it->second;
+	if(size < e.size && (type == NVSInterface::TypeString || type == NVSInterface::TypeBlob)){
+		_mtx.unlock();
+		_error = -1;
+		return _error;
+	}
+	fseek(_fp, e.offset + sizeof(RecordHeader) + it->first.length(), SEEK_SET);
+	_error = (_fat->read(data, 1, e.size, _fp) == e.size)? 0 : -1;
+	_mtx.unlock();
+	return _error;
+}
+
+
+//------------------------------------------------------------------------------------
+bool NVSLogStore::checkKey(const char* data_id){
+	_mtx.lock();
+	bool exists = (_index.find(data_id) != _index.end());
+	_mtx.unlock();
+	return exists;
+}
+
+
+//------------------------------------------------------------------------------------
+int NVSLogStore::removeKey(const char* data_id){
+	_mtx.lock();
+	if(_index.find(data_id) == _index.end()){
+		_mtx.unlock();
+		_error = -1;
+		return _error;
+	}
+	_error = _append(data_id, NULL, 0, NVSInterface::TypeBlob, FlagDeleted);
+	_mtx.unlock();
+	return _error;
+}
+
+
+//------------------------------------------------------------------------------------
+int NVSLogStore::forEachKey(const char* prefix, NVSInterface::KeyValueType type, Callback<bool(const NVSInterface::KeyInfo&)> visitor){
+	size_t prefix_len = (prefix)? strlen(prefix) : 0;
+	NVSInterface::KeyInfo info;
+	int count = 0;
+	_mtx.lock();
+	for(auto it = _index.begin(); it != _index.end(); ++it){
+		if(type != NVSInterface::TypeAny && type != it->second.type){
+			continue;
+		}
+		if(prefix_len > 0 && strncmp(it->first.c_str(), prefix, prefix_len) != 0){
+			continue;
+		}
+		strcpy(info.key, it->first.c_str());
+		info.type = it->second.type;
+		info.size = it->second.size;
+		count++;
+		if(!visitor.call(info)){
+			break;
+		}
+	}
+	_mtx.unlock();
+	return count;
+}
+
+
+//------------------------------------------------------------------------------------
+bool NVSLogStore::erase(){
+	_mtx.lock();
+	if(_fp){
+		_fat->close(_fp);
+	}
+	_fp = _fat->open(_log_file, "w+b");
+	_index.clear();
+	_log_size = 0;
+	_live_size = 0;
+	// una compactacion en curso no puede sustituir el log borrado
+	_log_gen++;
+	_ready = (_fp != NULL);
+	_mtx.unlock();
+	return _ready;
+}
+
+
+//------------------------------------------------------------------------------------
+int NVSLogStore::compact(){
+	// Fase 1: se fija el tramo a copiar y la posicion de los registros vigentes en el
+	_mtx.lock();
+	if(_compacting || !_fp){
+		DEBUG_TRACE_W(_EXPR_, _MODULE_, "ERR_COMPACT, Log %s no disponible o compactacion en curso", _log_file);
+		_mtx.unlock();
+		return -1;
+	}
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Compactando log %s: %d/%d bytes vigentes", _log_file, _live_size, _log_size);
+	FILE* tmp = _fat->open(_tmp_file, "wb");
+	if(!tmp){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_OPEN, No se puede crear %s", _tmp_file);
+		_mtx.unlock();
+		return -1;
+	}
+	_compacting = true;
+	uint32_t gen = _log_gen;
+	uint32_t end = _log_size;
+	std::vector<std::pair<std::string, IndexEntry> > live(_index.begin(), _index.end());
+	_mtx.unlock();
+
+	// Fase 2: copia de los registros vigentes, intercalada con las operaciones de otros threads
+	std::unordered_map<std::string, uint32_t> moved;
+	uint32_t offset = 0;
+	int err = 0;
+	for(auto it = live.begin(); it != live.end() && err == 0; ++it){
+		uint32_t len = _recordSize(it->first.length(), it->second.size);
+		err = _copyRange(tmp, it->second.offset, len, gen);
+		moved[it->first] = offset;
+		offset += len;
+	}
+
+	// Fase 3: con el mutex tomado, se copian los registros aniadidos durante la fase 2 y se sustituye el log
+	_mtx.lock();
+	uint32_t tail = _log_size - end;
+	if(err == 0){
+		err = _copyRange(tmp, end, tail, gen);
+	}
+	// el log compactado debe estar en la flash antes de eliminar el original
+	if(err == 0 && _fat->flush(tmp, true) != 0){
+		err = -1;
+	}
+	_fat->close(tmp);
+	if(err != 0){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_COMPACT, Error copiando registros vigentes");
+		_fat->eraseFile(_tmp_file);
+		_compacting = false;
+		_mtx.unlock();
+		return err;
+	}
+	_fat->close(_fp);
+	_fat->eraseFile(_log_file);
+	_fat->renameFile(_tmp_file, _log_file);
+	_fp = _fat->open(_log_file, "r+b");
+	_ready = (_fp != NULL);
+	// Los registros copiados en la fase 2 cambian a su nueva posicion y los de la fase 3 se desplazan
+	for(auto it = _index.begin(); it != _index.end(); ++it){
+		it->second.offset = (it->second.offset >= end)? (it->second.offset - end + offset) : moved[it->first];
+	}
+	_log_size = offset + tail;
+	_compacting = false;
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Log %s compactado a %d bytes", _log_file, _log_size);
+	_mtx.unlock();
+	return _ready? 0 : -1;
+}
+
+
+//------------------------------------------------------------------------------------
+//-- PRIVATE METHODS IMPLEMENTATION --------------------------------------------------
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+int NVSLogStore::_append(const char* data_id, const void* data, uint32_t size, NVSInterface::KeyValueType type, uint8_t flags){
+	if(!_fp){
+		return -1;
+	}
+	RecordHeader hdr;
+	memset(&hdr, 0, sizeof(RecordHeader));
+	hdr.magic = RecordMagic;
+	hdr.type = (uint8_t)type;
+	hdr.flags = flags;
+	hdr.key_len = strlen(data_id);
+	hdr.value_len = size;
+	hdr.crc = FATPlatform::crc32(0, (const uint8_t*)&hdr, sizeof(RecordHeader));
+	hdr.crc = FATPlatform::crc32(hdr.crc, (const uint8_t*)data_id, hdr.key_len);
+	if(size > 0){
+		hdr.crc = FATPlatform::crc32(hdr.crc, (const uint8_t*)data, size);
+	}
+	fseek(_fp, _log_size, SEEK_SET);
+	if(_fat->write(&hdr, 1, sizeof(RecordHeader), _fp) != sizeof(RecordHeader) ||
+	   _fat->write(data_id, 1, hdr.key_len, _fp) != hdr.key_len ||
+	   (size > 0 && _fat->write(data, 1, size, _fp) != size)){
+		DEBUG_TRACE_E(_EXPR_, _MODULE_, "ERR_WR, Error al escribir id %s", data_id);
+		// los registros posteriores se escriben sobre el registro incompleto
+		return -1;
+	}
+	// Se actualiza el indice y el balance de datos vigentes
+	auto it = _index.find(data_id);
+	if(it != _index.end()){
+		_live_size -= _recordSize(hdr.key_len, it->second.size);
+	}
+	if(flags & FlagDeleted){
+		if(it != _index.end()){
+			_index.erase(it);
+		}
+	}
+	else{
+		IndexEntry e = {_log_size, size, type};
+		_index[data_id] = e;
+		_live_size += _recordSize(hdr.key_len, size);
+	}
+	_log_size += _recordSize(hdr.key_len, size);
+	// al cruzar el umbral se despierta al thread de compactacion, si esta arrancado
+	if(_cp_th && _needsCompaction()){
+		_cp_sem.release();
+	}
+	return 0;
+}
+
+
+//------------------------------------------------------------------------------------
+bool NVSLogStore::_needsCompaction(){
+	return (_ready && _live_ratio != 0 && _log_size >= NVSLogStore_MIN_COMPACT_SIZE && ((uint64_t)_live_size * 100) < ((uint64_t)_log_size * _live_ratio));
+}
+
+
+//------------------------------------------------------------------------------------
+int NVSLogStore::_copyRange(FILE* dst, uint32_t from, uint32_t len, uint32_t gen){
+	uint8_t buf[CopyBufferSize];
+	while(len > 0){
+		uint32_t n = (len < CopyBufferSize)? len : CopyBufferSize;
+		_mtx.lock();
+		bool ok = (_fp != NULL && gen == _log_gen && fseek(_fp, from, SEEK_SET) == 0 && _fat->read(buf, 1, n, _fp) == n);
+		_mtx.unlock();
+		if(!ok || _fat->write(buf, 1, n, dst) != n){
+			return -1;
+		}
+		from += n;
+		len -= n;
+	}
+	return 0;
+}
+
+
+//------------------------------------------------------------------------------------
+void NVSLogStore::_compactTask(){
+	for(;;){
+		_cp_sem.wait(osWaitForever);
+		if(_cp_stop){
+			return;
+		}
+		if(compactIfNeeded() < 0){
+			DEBUG_TRACE_W(_EXPR_, _MODULE_, "ERR_COMPACT, Compactacion en segundo plano fallida en %s", _log_file);
+		}
+	}
+}
+
+
+//------------------------------------------------------------------------------------
+uint32_t NVSLogStore::_replay(){
+	uint8_t buf[CopyBufferSize];
+	char key[NVSInterface_KEY_MAX_SIZE];
+	uint32_t offset = 0;
+	_index.clear();
+	_live_size = 0;
+	fseek(_fp, 0, SEEK_SET);
+	for(;;){
+		RecordHeader hdr;
+		if(_fat->read(&hdr, 1, sizeof(RecordHeader), _fp) != sizeof(RecordHeader)){
+			break;
+		}
+		if(hdr.magic != RecordMagic || hdr.key_len == 0 || hdr.key_len >= NVSInterface_KEY_MAX_SIZE || hdr.type >= NVSInterface::TypeAny){
+			break;
+		}
+		uint32_t crc = hdr.crc;
+		hdr.crc = 0;
+		uint32_t calc = FATPlatform::crc32(0, (const uint8_t*)&hdr, sizeof(RecordHeader));
+		if(_fat->read(key, 1, hdr.key_len, _fp) != hdr.key_len){
+			break;
+		}
+		key[hdr.key_len] = 0;
+		calc = FATPlatform::crc32(calc, (const uint8_t*)key, hdr.key_len);
+		uint32_t pending = hdr.value_len;
+		while(pending > 0){
+			uint32_t n = (pending < CopyBufferSize)? pending : CopyBufferSize;
+			if(_fat->read(buf, 1, n, _fp) != n){
+				break;
+			}
+			calc = FATPlatform::crc32(calc, buf, n);
+			pending -= n;
+		}
+		if(pending > 0 || calc != crc){
+			break;
+		}
+		// Registro valido, se aplica sobre el indice
+		auto it = _index.find(key);
+		if(it != _index.end()){
+			_live_size -= _recordSize(hdr.key_len, it->second.size);
+			_index.erase(it);
+		}
+		if(!(hdr.flags & FlagDeleted)){
+			IndexEntry e = {offset, hdr.value_len, (NVSInterface::KeyValueType)hdr.type};
+			_index[key] = e;
+			_live_size += _recordSize(hdr.key_len, hdr.value_len);
+		}
+		offset += _recordSize(hdr.key_len, hdr.value_len);
+	}
+	return offset;
+}
+
+/**** END OF FILE ****/
@@ -0,0 +1,195 @@
+/*
+ * NVSLogStore.h
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ *
+ *	NVSLogStore es una implementacion de NVSInterface sobre un archivo de la particion FAT, orientada a claves con
+ *  alta tasa de actualizacion (contadores, estado de telemetria...).
+ *
+ *  Cada escritura se aniade como un registro al final de un archivo log, por lo que tiene coste constante y es
+ *  secuencial. Un indice hash en RAM asocia cada clave con la posicion de su ultimo valor. Al arrancar se reconstruye
+ *  el indice recorriendo el log y descartando los registros incompletos. Cuando la proporcion de datos vigentes cae
+ *  por debajo de un umbral, el log se compacta reescribiendo solo los registros vigentes. La compactacion no se
+ *  realiza en <close>, sino en un thread de baja prioridad (ver <startCompaction>) al cruzar el umbral, o cuando
+ *  la aplicacion invoca <compactIfNeeded>.
+ *
+ *  La compactacion copia los registros vigentes tomando el mutex del almacen solo durante la lectura de cada bloque,
+ *  por lo que las operaciones concurrentes se intercalan con la copia. Los registros aniadidos mientras tanto se
+ *  copian al final, ya con el mutex tomado durante toda la sustitucion del log, cuyo coste es proporcional a lo
+ *  escrito durante la copia y no al total de datos vigentes.
+ *
+ *  Formato de registro: [RecordHeader][clave][valor]
+ */
+
+#ifndef __NVSLogStore__H
+#define __NVSLogStore__H
+
+#include "mbed.h"
+#include "NVSInterface.h"
+#include "FATInterface.h"
+#include <string>
+#include <unordered_map>
+
+
+/** Porcentaje minimo de datos vigentes en el log antes de compactarlo */
+#define NVSLogStore_DEFAULT_LIVE_RATIO		50
+
+/** Tamanio minimo del log para considerar su compactacion */
+#define NVSLogStore_MIN_COMPACT_SIZE		4096
+
+/** Tamanio de la pila del thread de compactacion */
+#define NVSLogStore_COMPACT_STACK_SIZE		4096
+
+
+class NVSLogStore : public NVSInterface{
+
+  public:
+
+    /** Constructor
+     *  Crea el almacen clave-valor sobre un archivo log en la particion FAT
+     *  @param name Nombre del almacen, utilizado como nombre del archivo log
+     *  @param fat Particion FAT sobre la que opera
+     *  @param defdbg Flag para activar o desactivar el canal de depuracion por defecto
+     */
+	NVSLogStore(const char* name, FATInterface* fat, bool defdbg = false);
+	virtual ~NVSLogStore();
+
+    /** init
+     *  Abre el archivo log y reconstruye el indice en RAM
+     *  @return 0 (correcto), <0 (codigo de error)
+     */
+	virtual int init();
+
+	virtual bool ready() { return _ready; }
+
+    /** Abre una sesion de operaciones en bloque
+     * @return True: sesion abierta
+     */
+	virtual bool open();
+
+    /** Cierra la sesion, volcando los registros escritos
+     */
+	virtual void close();
+
+	virtual int save(const char* data_id, void* data, uint32_t size, NVSInterface::KeyValueType type);
+	virtual int restore(const char* data_id, void* data, uint32_t size, NVSInterface::KeyValueType type);
+	virtual bool checkKey(const char* data_id);
+	virtual int removeKey(const char* data_id);
+	virtual int forEachKey(const char* prefix, NVSInterface::KeyValueType type, Callback<bool(const NVSInterface::KeyInfo&)> visitor);
+	virtual bool erase();
+
+	/** Variantes tipadas de <save> y <restore> definidas en NVSInterface */
+	using NVSInterface::save;
+	using NVSInterface::restore;
+
+	/** compact
+	 *  Reescribe el log conservando unicamente los registros vigentes
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int compact();
+
+	/** compactIfNeeded
+	 *  Compacta el log si la proporcion de datos vigentes ha caido por debajo del umbral (ver <setCompactRatio>)
+	 *  @return 1 (compactado), 0 (no requerido), <0 (codigo de error)
+	 */
+	int compactIfNeeded();
+
+	/** startCompaction
+	 *  Arranca el thread de compactacion en segundo plano. Cada escritura que deja los datos vigentes por debajo del
+	 *  umbral lo despierta y este invoca <compactIfNeeded>
+	 *  @param stack_size Tamanio de la pila del thread
+	 *  @param priority Prioridad del thread
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int startCompaction(uint32_t stack_size = NVSLogStore_COMPACT_STACK_SIZE, osPriority priority = osPriorityLow);
+
+	/** stopCompaction
+	 *  Detiene el thread de compactacion, esperando a que finalice la compactacion en curso
+	 */
+	void stopCompaction();
+
+	/** setCompactRatio
+	 *  Configura el porcentaje minimo de datos vigentes por debajo del cual <compactIfNeeded> compacta el log
+	 *  @param live_ratio Porcentaje (0 desactiva la compactacion automatica)
+	 */
+	void setCompactRatio(uint8_t live_ratio) { _live_ratio = live_ratio; }
+
+	/** Obtiene el tamanio del log y de los datos vigentes
+	 */
+	uint32_t getLogSize() { return _log_size; }
+	uint32_t getLiveSize() { return _live_size; }
+
+  protected:
+
+	/** Cabecera de cada registro */
+	struct RecordHeader{
+		uint16_t magic;
+		uint8_t type;
+		uint8_t flags;
+		uint8_t key_len;
+		uint8_t reserved[3];
+		uint32_t value_len;
+		uint32_t crc;
+	};
+
+	static const uint16_t RecordMagic = 0x4B56;
+	static const uint8_t FlagDeleted = 0x01;
+
+	/** Entrada del indice en RAM */
+	struct IndexEntry{
+		uint32_t offset;	/// Posicion del registro en el log
+		uint32_t size;		/// Tamanio del valor
+		NVSInterface::KeyValueType type;
+	};
+
+	/** Aniade un registro al final del log
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int _append(const char* data_id, const void* data, uint32_t size, NVSInterface::KeyValueType type, uint8_t flags);
+
+	/** Recorre el log reconstruyendo el indice
+	 *  @return Posicion del final de la ultima entrada valida
+	 */
+	uint32_t _replay();
+
+	/** Comprueba si los datos vigentes han caido por debajo del umbral de compactacion */
+	bool _needsCompaction();
+
+	/** Copia un tramo del log en <dst>, tomando el mutex durante la lectura de cada bloque
+	 *  @param gen Generacion del log en la que se inicio la copia, que se aborta si el log se borra
+	 *  @return 0 (correcto), <0 (codigo de error)
+	 */
+	int _copyRange(FILE* dst, uint32_t from, uint32_t len, uint32_t gen);
+
+	/** Tarea del thread de compactacion */
+	void _compactTask();
+
+	/** Obtiene el tamanio que ocupa un registro en el log */
+	static uint32_t _recordSize(uint32_t key_len, uint32_t value_len) { return sizeof(RecordHeader) + key_len + value_len; }
+
+	bool _defdbg;
+	bool _ready;
+	Mutex _mtx;
+	FATInterface* _fat;
+	FILE* _fp;
+	char _log_file[MAX_PATH_NAME_LENGTH];
+	char _tmp_file[MAX_PATH_NAME_LENGTH];
+	std::unordered_map<std::string, IndexEntry> _index;
+	uint32_t _log_size;
+	uint32_t _live_size;
+	uint8_t _live_ratio;
+
+	/** Compactacion en curso y generacion del log, que se incrementa en cada <erase> */
+	bool _compacting;
+	uint32_t _log_gen;
+
+	/** Thread de compactacion en segundo plano, el semaforo que lo despierta y su flag de parada */
+	Thread* _cp_th;
+	Semaphore _cp_sem;
+	bool _cp_stop;
+};
+
+#endif /*__NVSLogStore__H */
+
+/**** END OF FILE ****/
@@ -0,0 +1,189 @@
+/*
+ * StorageStats.h
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ *
+ *	StorageStats proporciona contadores e histogramas de latencia por operacion para los modulos de almacenamiento
+ *  (FSManager, FATInterface). Cada operacion registra numero de invocaciones, bytes, errores, y dos histogramas
+ *  logaritmicos: tiempo de espera del mutex y tiempo de E/S.
+ *
+ *  Los contadores se actualizan con operaciones atomicas, sin mutex propio, ya que las operaciones de un modulo se
+ *  pueden registrar desde varios threads con distintos locks (ej: los locks por stream de FATInterface).
+ *
+ *  La instrumentacion se elimina en compilacion definiendo StorageStats_ENABLED a 0, en cuyo caso las macros
+ *  STATS_xxx no generan codigo.
+ */
+
+#ifndef __StorageStats__H
+#define __StorageStats__H
+
+#include "mbed.h"
+#if ESP_PLATFORM == 1
+#include "esp_timer.h"
+#endif
+
+#if !defined(StorageStats_ENABLED)
+#define StorageStats_ENABLED		1
+#endif
+
+
+/** Numero de intervalos del histograma. El intervalo i agrupa latencias en [2^(i-1), 2^i) us */
+#define StorageStats_NUM_BUCKETS	24
+
+
+/** StorageHistogram
+ * 	Histograma logaritmico de latencias en microsegundos
+ */
+struct StorageHistogram{
+	uint32_t buckets[StorageStats_NUM_BUCKETS];
+	uint32_t max_us;
+
+	/** Registra una latencia de forma atomica
+	 *  @param us Latencia en microsegundos
+	 */
+	void add(uint32_t us){
+		uint8_t i = (us == 0)? 0 : (32 - __builtin_clz(us));
+		__atomic_fetch_add(&buckets[(i < StorageStats_NUM_BUCKETS)? i : (StorageStats_NUM_BUCKETS - 1)], 1, __ATOMIC_RELAXED);
+		uint32_t max = __atomic_load_n(&max_us, __ATOMIC_RELAXED);
+		while(us > max && !__atomic_compare_exchange_n(&max_us, &max, us, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+		}
+	}
+
+	/** Copia el histograma leyendo cada contador de forma atomica
+	 *  @param dest Histograma destino
+	 */
+	void load(StorageHistogram* dest) const{
+		for(uint8_t i = 0; i < StorageStats_NUM_BUCKETS; i++){
+			dest->buckets[i] = __atomic_load_n(&buckets[i], __ATOMIC_RELAXED);
+		}
+		dest->max_us = __atomic_load_n(&max_us, __ATOMIC_RELAXED);
+	}
+
+	/** Reinicia el histograma de forma atomica */
+	void clear(){
+		for(uint8_t i = 0; i < StorageStats_NUM_BUCKETS; i++){
+			__atomic_store_n(&buckets[i], 0, __ATOMIC_RELAXED);
+		}
+		__atomic_store_n(&max_us, 0, __ATOMIC_RELAXED);
+	}
+
+	/** Obtiene una cota superior del percentil indicado
+	 *  @param pct Percentil (1..100)
+	 *  @return Latencia en microsegundos
+	 */
+	uint32_t percentile(uint8_t pct) const{
+		uint32_t total = 0;
+		for(uint8_t i = 0; i < StorageStats_NUM_BUCKETS; i++){
+			total += buckets[i];
+		}
+		uint32_t target = ((uint64_t)total * pct + 99) / 100;
+		uint32_t acc = 0;
+		for(uint8_t i = 0; i < StorageStats_NUM_BUCKETS && total > 0; i++){
+			acc += buckets[i];
+			if(acc >= target){
+				uint32_t upper = (1UL << i);
+				return (upper < max_us)? upper : max_us;
+			}
+		}
+		return max_us;
+	}
+};
+
+
+/** StorageOpStats
+ * 	Estadisticas de una operacion
+ */
+struct StorageOpStats{
+	uint32_t count;			/// Numero de invocaciones
+	uint32_t errors;		/// Numero de invocaciones con error
+	uint64_t bytes;			/// Bytes transferidos
+	StorageHistogram wait;	/// Tiempo de espera del mutex
+	StorageHistogram io;	/// Tiempo de E/S, una vez adquirido el mutex
+
+	uint32_t p50() const { return io.percentile(50); }
+	uint32_t p99() const { return io.percentile(99); }
+	uint32_t max() const { return io.max_us; }
+};
+
+
+/** StorageStats
+ * 	Tabla de estadisticas de N operaciones
+ */
+template<uint8_t N>
+class StorageStats{
+  public:
+
+	StorageStats(){
+		reset();
+	}
+
+	/** Obtiene el tiempo actual en microsegundos */
+	static uint32_t now_us(){
+		#if ESP_PLATFORM == 1
+		return (uint32_t)esp_timer_get_time();
+		#else
+		return us_ticker_read();
+		#endif
+	}
+
+	/** Registra una operacion
+	 *  @param op Operacion
+	 *  @param t_start Instante de inicio, antes de solicitar el mutex
+	 *  @param t_locked Instante en el que se adquirio el mutex
+	 *  @param bytes Bytes transferidos
+	 *  @param error Flag para indicar si la operacion fallo
+	 */
+	void record(uint8_t op, uint32_t t_start, uint32_t t_locked, uint32_t bytes, bool error){
+		uint32_t t_end = now_us();
+		StorageOpStats& s = _ops[op];
+		__atomic_fetch_add(&s.count, 1, __ATOMIC_RELAXED);
+		if(error){
+			__atomic_fetch_add(&s.errors, 1, __ATOMIC_RELAXED);
+		}
+		__atomic_fetch_add(&s.bytes, (uint64_t)bytes, __ATOMIC_RELAXED);
+		s.wait.add(t_locked - t_start);
+		s.io.add(t_end - t_locked);
+	}
+
+	/** Copia las estadisticas de todas las operaciones. Cada contador se lee de forma atomica, aunque el conjunto
+	 *  puede incluir parcialmente una operacion registrada durante la copia
+	 *  @param stats Array de N elementos que recibe las estadisticas
+	 */
+	void snapshot(StorageOpStats* stats){
+		for(uint8_t i = 0; i < N; i++){
+			stats[i].count = __atomic_load_n(&_ops[i].count, __ATOMIC_RELAXED);
+			stats[i].errors = __atomic_load_n(&_ops[i].errors, __ATOMIC_RELAXED);
+			stats[i].bytes = __atomic_load_n(&_ops[i].bytes, __ATOMIC_RELAXED);
+			_ops[i].wait.load(&stats[i].wait);
+			_ops[i].io.load(&stats[i].io);
+		}
+	}
+
+	/** Reinicia las estadisticas */
+	void reset(){
+		for(uint8_t i = 0; i < N; i++){
+			__atomic_store_n(&_ops[i].count, 0, __ATOMIC_RELAXED);
+			__atomic_store_n(&_ops[i].errors, 0, __ATOMIC_RELAXED);
+			__atomic_store_n(&_ops[i].bytes, 0, __ATOMIC_RELAXED);
+			_ops[i].wait.clear();
+			_ops[i].io.clear();
+		}
+	}
+
+  private:
+	StorageOpStats _ops[N];
+};
+
+
+#if StorageStats_ENABLED == 1
+#define STATS_TIMESTAMP(t)							uint32_t t = StorageStats<1>::now_us()
+#define STATS_RECORD(st, op, t0, t1, bytes, err)	(st).record(op, t0, t1, bytes, err)
+#else
+#define STATS_TIMESTAMP(t)
+#define STATS_RECORD(st, op, t0, t1, bytes, err)
+#endif
+
+#endif /*__StorageStats__H */
+
+/**** END OF FILE ****/
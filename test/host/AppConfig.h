@@ -0,0 +1,21 @@
+/*
+ * AppConfig.h
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ *
+ *	Configuracion de la aplicacion para los test en el host. FAT_PATH excede MAX_PATH_NAME_LENGTH para que el caso
+ *  "CREA FATINTERFACE ERROR" compruebe el fallo de creacion.
+ */
+
+#ifndef __HOST_AppConfig__H
+#define __HOST_AppConfig__H
+
+#define FAT_PARTITION_NAME		"fat_error"
+#define FAT_PATH				"fat_error/path_que_excede_la_longitud_maxima_de_la_particion"
+#define FAT_MAX_FILES			2
+#define ERROR_FILENAME			"error.log"
+
+#endif /*__HOST_AppConfig__H */
+
+/**** END OF FILE ****/
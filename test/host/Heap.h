@@ -0,0 +1,21 @@
+/*
+ * Heap.h
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ *
+ *	Sustituto del modulo Heap para los test en el host (sin trazas de memoria).
+ */
+
+#ifndef __HOST_Heap__H
+#define __HOST_Heap__H
+
+class Heap{
+  public:
+	template<typename T>
+	static void setDebugLevel(T level){}
+};
+
+#endif /*__HOST_Heap__H */
+
+/**** END OF FILE ****/
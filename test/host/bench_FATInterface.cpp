@@ -0,0 +1,103 @@
+/*
+ * bench_FATInterface.cpp
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ *
+ *	Benchmark multi-thread de FATInterface en el host. Con 1, 2, 4 y 8 threads, cada uno escribe su propio archivo
+ *  y a continuacion lo relee contando lineas, todos sobre la misma instancia de FATInterface. Muestra el tiempo y
+ *  el rendimiento agregado de cada configuracion para evaluar la contencion entre streams:
+ *
+ *    bench_FATInterface [lineas_por_thread]
+ *
+ *  Devuelve 0 si todos los archivos contienen las lineas esperadas.
+ */
+
+#include "mbed.h"
+#include "FATInterface.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/** Numero maximo de threads del benchmark */
+static const int MaxThreads = 8;
+
+
+/** Trabajo de cada thread: escritura y relectura de un archivo propio */
+struct BenchJob{
+	FATInterface* fat;
+	char name[32];
+	int lines;
+	int errors;
+	size_t bytes;
+
+	void run(){
+		errors = 0;
+		bytes = 0;
+		FILE* f = fat->open(name, "w");
+		if(!f){
+			errors++;
+			return;
+		}
+		char line[64];
+		for(int i=0;i<lines;i++){
+			int len = sprintf(line, "%s,%d,telemetria\n", name, i);
+			if(fat->write(line, sizeof(char), len, f) != (size_t)len){
+				errors++;
+			}
+			bytes += len;
+		}
+		fat->close(f);
+		f = fat->open(name, "r");
+		if(!f){
+			errors++;
+			return;
+		}
+		if(fat->getLineCount(f) != (size_t)lines){
+			errors++;
+		}
+		fat->close(f);
+		// se contabiliza la escritura y la relectura
+		bytes *= 2;
+		fat->eraseFile(name);
+	}
+};
+
+
+//------------------------------------------------------------------------------------
+int main(int argc, char* argv[]){
+	int lines = (argc > 1)? atoi(argv[1]) : 2000;
+	FATInterface* fat = new FATInterface("bench", "bench", MaxThreads, true);
+	if(!fat->isReady()){
+		printf("ERR_MOUNT, No se puede montar la particion del benchmark\n");
+		return 1;
+	}
+	int errors = 0;
+	BenchJob jobs[MaxThreads];
+	Thread* th[MaxThreads];
+	printf("threads  lineas/thread  tiempo_us  KB/s\n");
+	for(int n = 1; n <= MaxThreads; n *= 2){
+		uint32_t t0 = us_ticker_read();
+		for(int i=0;i<n;i++){
+			jobs[i].fat = fat;
+			jobs[i].lines = lines;
+			sprintf(jobs[i].name, "bench_%d.txt", i);
+			th[i] = new Thread(osPriorityNormal, 4096, NULL, "FATBench");
+			th[i]->start(callback(&jobs[i], &BenchJob::run));
+		}
+		size_t bytes = 0;
+		for(int i=0;i<n;i++){
+			th[i]->join();
+			delete(th[i]);
+			errors += jobs[i].errors;
+			bytes += jobs[i].bytes;
+		}
+		uint32_t elapsed = us_ticker_read() - t0;
+		printf("%7d  %13d  %9u  %u\n", n, lines, elapsed, (unsigned)((elapsed > 0)? (uint64_t)bytes * 1000000 / 1024 / elapsed : 0));
+	}
+	delete(fat);
+	if(errors){
+		printf("ERR_BENCH, %d errores\n", errors);
+	}
+	return (errors == 0)? 0 : 1;
+}
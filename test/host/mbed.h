@@ -0,0 +1,204 @@
+/*
+ * mbed.h
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ *
+ *	Adaptacion minima de la API mbed/RTOS para ejecutar los test en el host (Linux). Solo incluye lo que utilizan
+ *  los modulos del componente: Mutex recursivo, Semaphore, Thread, ThisThread, Callback, us_ticker_read, wait_us y
+ *  las macros de trazas. Mutex y Thread se implementan sobre std::recursive_mutex y std::thread.
+ */
+
+#ifndef __HOST_MBED__H
+#define __HOST_MBED__H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+//------------------------------------------------------------------------------------
+//-- PLATAFORMA ----------------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+typedef int PinName32;
+#define NC									0
+
+#define IS_ISR()							(false)
+#define MBED_ASSERT(expr)					assert(expr)
+
+/** Trazas de depuracion por la salida estandar */
+#define DEBUG_TRACE_HOST(lvl, expr, mod, ...)	do{ if(expr){ printf("[%s] %s ", lvl, mod); printf(__VA_ARGS__); printf("\r\n"); } }while(0);
+#define DEBUG_TRACE_E(expr, mod, ...)		DEBUG_TRACE_HOST("E", expr, mod, __VA_ARGS__)
+#define DEBUG_TRACE_W(expr, mod, ...)		DEBUG_TRACE_HOST("W", expr, mod, __VA_ARGS__)
+#define DEBUG_TRACE_I(expr, mod, ...)		DEBUG_TRACE_HOST("I", expr, mod, __VA_ARGS__)
+#define DEBUG_TRACE_D(expr, mod, ...)		DEBUG_TRACE_HOST("D", expr, mod, __VA_ARGS__)
+
+
+/** Tiempo monotono en microsegundos */
+static inline uint32_t us_ticker_read(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+/** Espera activa en microsegundos */
+static inline void wait_us(int us){
+	usleep(us);
+}
+
+
+//------------------------------------------------------------------------------------
+//-- CALLBACK ------------------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+template<typename F> class Callback;
+
+template<typename R, typename... A>
+class Callback<R(A...)>{
+  public:
+	Callback(){}
+	Callback(R (*fn)(A...)){
+		if(fn){
+			_f = fn;
+		}
+	}
+	template<typename T>
+	Callback(T* obj, R (T::*method)(A...)){
+		_f = [obj, method](A... args){ return (obj->*method)(args...); };
+	}
+	R call(A... args) const { return _f(args...); }
+	R operator()(A... args) const { return _f(args...); }
+	explicit operator bool() const { return (bool)_f; }
+
+  private:
+	std::function<R(A...)> _f;
+};
+
+template<typename T, typename R, typename... A>
+Callback<R(A...)> callback(T* obj, R (T::*method)(A...)){
+	return Callback<R(A...)>(obj, method);
+}
+
+template<typename R, typename... A>
+Callback<R(A...)> callback(R (*fn)(A...)){
+	return Callback<R(A...)>(fn);
+}
+
+
+//------------------------------------------------------------------------------------
+//-- RTOS ----------------------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+typedef enum{
+	osPriorityLow = 8,
+	osPriorityBelowNormal = 16,
+	osPriorityNormal = 24,
+	osPriorityAboveNormal = 32,
+	osPriorityHigh = 40,
+}osPriority;
+
+typedef int32_t osStatus;
+#define osOK								0
+#define osErrorResource						-3
+#define osWaitForever						0xFFFFFFFFU
+
+
+class Mutex{
+  public:
+	osStatus lock(){ _m.lock(); return osOK; }
+	bool trylock(){ return _m.try_lock(); }
+	osStatus unlock(){ _m.unlock(); return osOK; }
+
+  private:
+	std::recursive_mutex _m;
+};
+
+
+class Semaphore{
+  public:
+	Semaphore(int32_t count = 0, uint16_t max_count = 0xFFFF) : _count(count), _max(max_count){}
+
+	/** Espera un token
+	 *  @param millisec Tiempo maximo de espera
+	 *  @return Tokens disponibles antes de la espera (0 si vence el tiempo)
+	 */
+	int32_t wait(uint32_t millisec = osWaitForever){
+		std::unique_lock<std::mutex> lck(_m);
+		if(millisec == osWaitForever){
+			_cv.wait(lck, [this]{ return _count > 0; });
+		}
+		else if(!_cv.wait_for(lck, std::chrono::milliseconds(millisec), [this]{ return _count > 0; })){
+			return 0;
+		}
+		return _count--;
+	}
+
+	osStatus release(){
+		{
+			std::lock_guard<std::mutex> lck(_m);
+			if(_count >= _max){
+				return osErrorResource;
+			}
+			_count++;
+		}
+		_cv.notify_one();
+		return osOK;
+	}
+
+  private:
+	std::mutex _m;
+	std::condition_variable _cv;
+	int32_t _count;
+	int32_t _max;
+};
+
+
+class Thread{
+  public:
+	Thread(osPriority priority = osPriorityNormal, uint32_t stack_size = 0, unsigned char* stack_mem = NULL, const char* name = NULL){}
+	~Thread(){
+		if(_th.joinable()){
+			_th.detach();
+		}
+	}
+
+	osStatus start(Callback<void()> task){
+		if(_th.joinable()){
+			return osErrorResource;
+		}
+		_th = std::thread([task]{ task(); });
+		return osOK;
+	}
+
+	osStatus join(){
+		if(_th.joinable()){
+			_th.join();
+		}
+		return osOK;
+	}
+
+  private:
+	std::thread _th;
+};
+
+
+namespace ThisThread{
+	inline void sleep_for(uint32_t millisec){
+		std::this_thread::sleep_for(std::chrono::milliseconds(millisec));
+	}
+}
+
+#endif /*__HOST_MBED__H */
+
+/**** END OF FILE ****/
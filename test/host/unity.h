@@ -0,0 +1,78 @@
+/*
+ * unity.h
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ *
+ *	Adaptacion minima de Unity para ejecutar los test en el host. TEST_CASE registra cada caso en el orden en el
+ *  que aparece en el archivo y unity_host.cpp los ejecuta secuencialmente. Las comprobaciones que fallan lanzan
+ *  una excepcion que aborta el caso en curso, por lo que solo deben utilizarse desde el hilo del test.
+ */
+
+#ifndef __HOST_UNITY__H
+#define __HOST_UNITY__H
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+
+/** Fallo de una comprobacion */
+struct UnityHostFailure{
+	const char* file;
+	int line;
+	char msg[160];
+};
+
+/** Registro de un caso de test */
+struct UnityHostCase{
+	UnityHostCase(const char* name, const char* desc, void (*fn)());
+	const char* name;
+	const char* desc;
+	void (*fn)();
+	UnityHostCase* next;
+};
+
+void unityHostFail(const char* file, int line, const char* fmt, ...);
+
+
+#define UNITY_HOST_JOIN_(a, b)				a##b
+#define UNITY_HOST_JOIN(a, b)				UNITY_HOST_JOIN_(a, b)
+
+#define TEST_CASE(name_, desc_)	\
+	static void UNITY_HOST_JOIN(unity_test_, __LINE__)(); \
+	static UnityHostCase UNITY_HOST_JOIN(unity_case_, __LINE__)(name_, desc_, UNITY_HOST_JOIN(unity_test_, __LINE__)); \
+	static void UNITY_HOST_JOIN(unity_test_, __LINE__)()
+
+#define TEST_FAIL_MESSAGE(msg)				unityHostFail(__FILE__, __LINE__, "%s", msg)
+#define TEST_ASSERT_MESSAGE(cond, msg)		do{ if(!(cond)){ unityHostFail(__FILE__, __LINE__, "%s", msg); } }while(0)
+#define TEST_ASSERT(cond)					TEST_ASSERT_MESSAGE(cond, #cond)
+#define TEST_ASSERT_TRUE(cond)				TEST_ASSERT_MESSAGE(cond, "Expected TRUE: " #cond)
+#define TEST_ASSERT_FALSE(cond)				TEST_ASSERT_MESSAGE(!(cond), "Expected FALSE: " #cond)
+#define TEST_ASSERT_NULL(ptr)				TEST_ASSERT_MESSAGE((ptr) == NULL, "Expected NULL: " #ptr)
+#define TEST_ASSERT_NOT_NULL(ptr)			TEST_ASSERT_MESSAGE((ptr) != NULL, "Expected not NULL: " #ptr)
+
+#define TEST_ASSERT_EQUAL(expected, actual)	do{ \
+	long long e_ = (long long)(expected), a_ = (long long)(actual); \
+	if(e_ != a_){ unityHostFail(__FILE__, __LINE__, "Expected %lld Was %lld", e_, a_); } \
+	}while(0)
+
+#define TEST_ASSERT_NOT_EQUAL(expected, actual)	do{ \
+	long long e_ = (long long)(expected), a_ = (long long)(actual); \
+	if(e_ == a_){ unityHostFail(__FILE__, __LINE__, "Expected Not-Equal %lld", e_); } \
+	}while(0)
+
+#define TEST_ASSERT_EQUAL_FLOAT(expected, actual)	do{ \
+	double e_ = (double)(expected), a_ = (double)(actual); \
+	if(fabs(e_ - a_) > fabs(e_) * 1e-5){ unityHostFail(__FILE__, __LINE__, "Expected %f Was %f", e_, a_); } \
+	}while(0)
+
+#define TEST_ASSERT_EQUAL_STRING(expected, actual)	do{ \
+	const char* e_ = (expected); const char* a_ = (actual); \
+	if(e_ == NULL || a_ == NULL || strcmp(e_, a_) != 0){ \
+		unityHostFail(__FILE__, __LINE__, "Expected '%s' Was '%s'", e_? e_ : "(null)", a_? a_ : "(null)"); } \
+	}while(0)
+
+#endif /*__HOST_UNITY__H */
+
+/**** END OF FILE ****/
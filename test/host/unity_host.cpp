@@ -0,0 +1,83 @@
+/*
+ * unity_host.cpp
+ *
+ *  Created on: Oct 2026
+ *      Author: raulMrello
+ *
+ *	Ejecuta en el host los casos registrados con TEST_CASE. Sin argumentos se ejecutan todos; con argumentos, solo
+ *  aquellos cuyo nombre o descripcion (ej: [FATInterface]) contiene alguno de ellos.
+ *  Devuelve 0 si todos los casos son correctos.
+ */
+
+#include "unity.h"
+#include <stdarg.h>
+
+
+static UnityHostCase* _first = NULL;
+static UnityHostCase* _last = NULL;
+
+
+//------------------------------------------------------------------------------------
+UnityHostCase::UnityHostCase(const char* name, const char* desc, void (*fn)()) : name(name), desc(desc), fn(fn), next(NULL){
+	if(_last){
+		_last->next = this;
+	}
+	else{
+		_first = this;
+	}
+	_last = this;
+}
+
+
+//------------------------------------------------------------------------------------
+void unityHostFail(const char* file, int line, const char* fmt, ...){
+	UnityHostFailure f;
+	f.file = file;
+	f.line = line;
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(f.msg, sizeof(f.msg), fmt, args);
+	va_end(args);
+	throw f;
+}
+
+
+//------------------------------------------------------------------------------------
+static bool _selected(const UnityHostCase* tc, int argc, char** argv){
+	if(argc < 2){
+		return true;
+	}
+	for(int i = 1; i < argc; i++){
+		if(strstr(tc->name, argv[i]) || strstr(tc->desc, argv[i])){
+			return true;
+		}
+	}
+	return false;
+}
+
+
+//------------------------------------------------------------------------------------
+int main(int argc, char** argv){
+	int tests = 0, failures = 0;
+	for(UnityHostCase* tc = _first; tc; tc = tc->next){
+		if(!_selected(tc, argc, argv)){
+			continue;
+		}
+		tests++;
+		printf("Running %s...\r\n", tc->name);
+		fflush(stdout);
+		try{
+			tc->fn();
+			printf("%s:PASS\r\n", tc->name);
+		}
+		catch(const UnityHostFailure& f){
+			failures++;
+			printf("%s:%d:%s:FAIL: %s\r\n", f.file, f.line, tc->name, f.msg);
+		}
+		fflush(stdout);
+	}
+	printf("-----------------------\r\n%d Tests %d Failures 0 Ignored\r\n%s\r\n", tests, failures, (failures == 0)? "OK" : "FAIL");
+	return (failures == 0)? 0 : 1;
+}
+
+/**** END OF FILE ****/
@@ -12,12 +12,21 @@
 
 #include "unity.h"
 #include "FATInterface.h"
+#include "NVSLogStore.h"
+#include "FATLineReader.h"
+#include "FATLineIndex.h"
+#include "LogWriter.h"
+#include "FATRotatingLog.h"
+#include "FATAsyncIO.h"
+#include "FATRingFile.h"
+#include "FATSeriesStore.h"
 #include "mbed.h"
 #include "AppConfig.h"
 #include "Heap.h"
+#include <atomic>
 
 
-#if ESP_PLATFORM == 1 || (__MBED__ == 1 && defined(ENABLE_TEST_DEBUGGING) && defined(ENABLE_TEST_FATInterface))
+#if ESP_PLATFORM == 1 || (__MBED__ == 1 && defined(ENABLE_TEST_DEBUGGING) && defined(ENABLE_TEST_FATInterface)) || defined(ENABLE_TEST_HOST)
 
 /** Requerido para test unitarios ESP-MDF */
 #if ESP_PLATFORM == 1
@@ -47,10 +56,12 @@ static FATInterface* fat = NULL;
 //------------------------------------------------------------------------------------
 
 
+#if ESP_PLATFORM == 1 || __MBED__ == 1
 //------------------------------------------------------------------------------------
 TEST_CASE("RESET_______________________", "[FATInterface]") {
 	esp_restart();
 }
+#endif
 
 
 //------------------------------------------------------------------------------------
@@ -60,6 +71,8 @@ TEST_CASE("CREA FATINTERFACE ERROR_____", "[FATInterface]") {
 	TEST_ASSERT_NOT_NULL(fat);
 	TEST_ASSERT_FALSE(fat->isReady());
 	DEBUG_TRACE_D(_EXPR_, _MODULE_, "FAT Filesystem no creado... OK!");
+	delete(fat);
+	fat = NULL;
 }
 
 
@@ -181,7 +194,7 @@ TEST_CASE("LISTA ARCHIVOS EN DIR_______", "[FATInterface]") {
 	fat->close(f);
 
 	std::list<const char*> files;
-	int count = fat->listFolder("stm32", files);
+	int count = fat->listFolder("stm32", &files);
 	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Encontrados %d archivos en /stm32", count);
 
 	for(auto i = files.begin(); i!=files.end(); ++i){
@@ -194,6 +207,878 @@ TEST_CASE("LISTA ARCHIVOS EN DIR_______", "[FATInterface]") {
 
 
 
+//------------------------------------------------------------------------------------
+TEST_CASE("NVSLOGSTORE SOBRE FAT_______", "[FATInterface]") {
+	TEST_ASSERT_NOT_NULL(fat);
+	NVSLogStore* kv = new NVSLogStore("kvtest", fat);
+	TEST_ASSERT_TRUE(kv->ready());
+	TEST_ASSERT_TRUE(kv->erase());
+	TEST_ASSERT_TRUE(kv->open());
+	uint32_t t0 = FATPlatform::now_us();
+	for(uint32_t i=0;i<1000;i++){
+		TEST_ASSERT_EQUAL(0, kv->save("counter", i));
+	}
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "1000 escrituras en %d us", (uint32_t)FATPlatform::now_us() - t0);
+	TEST_ASSERT_EQUAL(0, kv->save("name", "logstore"));
+	kv->close();
+	// la compactacion, solicitada en inactividad, mantiene solo los registros vigentes
+	TEST_ASSERT_TRUE(kv->getLiveSize() < kv->getLogSize());
+	TEST_ASSERT_EQUAL(1, kv->compactIfNeeded());
+	TEST_ASSERT_EQUAL(kv->getLiveSize(), kv->getLogSize());
+	TEST_ASSERT_EQUAL(0, kv->compactIfNeeded());
+	delete(kv);
+
+	// el indice se reconstruye a partir del log
+	kv = new NVSLogStore("kvtest", fat);
+	uint32_t counter = 0;
+	char name[16] = {0};
+	TEST_ASSERT_TRUE(kv->open());
+	TEST_ASSERT_EQUAL(0, kv->restore("counter", counter));
+	TEST_ASSERT_EQUAL(0, kv->restore("name", name));
+	kv->close();
+	TEST_ASSERT_EQUAL(999, counter);
+	TEST_ASSERT_EQUAL_STRING("logstore", name);
+	delete(kv);
+}
+
+
+//------------------------------------------------------------------------------------
+TEST_CASE("NVSLOGSTORE COMPACT. FONDO__", "[FATInterface]") {
+	TEST_ASSERT_NOT_NULL(fat);
+	NVSLogStore* kv = new NVSLogStore("kvback", fat);
+	TEST_ASSERT_TRUE(kv->ready());
+	TEST_ASSERT_TRUE(kv->erase());
+	TEST_ASSERT_EQUAL(0, kv->save("name", "logstore"));
+	TEST_ASSERT_EQUAL(0, kv->startCompaction());
+	// las escrituras continuan mientras el thread compacta el log al cruzar el umbral
+	uint32_t rec_size = kv->getLogSize();
+	for(uint32_t i=0;i<3000;i++){
+		TEST_ASSERT_EQUAL(0, kv->save("counter", i));
+		if(i == 0){
+			rec_size = kv->getLogSize() - rec_size;
+		}
+	}
+	// sin invocar <compactIfNeeded>, el thread deja el log por debajo del umbral
+	uint32_t t0 = FATPlatform::now_us();
+	while(((uint64_t)kv->getLiveSize() * 100) < ((uint64_t)kv->getLogSize() * NVSLogStore_DEFAULT_LIVE_RATIO) && kv->getLogSize() >= NVSLogStore_MIN_COMPACT_SIZE && (FATPlatform::now_us() - t0) < 2000000){
+		ThisThread::sleep_for(10);
+	}
+	kv->stopCompaction();
+	TEST_ASSERT_TRUE(kv->getLogSize() < 3000 * rec_size);
+	TEST_ASSERT_EQUAL(0, kv->compactIfNeeded());
+	uint32_t counter = 0;
+	char name[16] = {0};
+	TEST_ASSERT_EQUAL(0, kv->restore("counter", counter));
+	TEST_ASSERT_EQUAL(0, kv->restore("name", name));
+	TEST_ASSERT_EQUAL(2999, counter);
+	TEST_ASSERT_EQUAL_STRING("logstore", name);
+	delete(kv);
+
+	// el log sustituido en segundo plano reconstruye el mismo indice
+	kv = new NVSLogStore("kvback", fat);
+	counter = 0;
+	TEST_ASSERT_EQUAL(0, kv->restore("counter", counter));
+	TEST_ASSERT_EQUAL(2999, counter);
+	TEST_ASSERT_EQUAL(0, kv->restore("name", name));
+	TEST_ASSERT_EQUAL_STRING("logstore", name);
+	TEST_ASSERT_TRUE(kv->erase());
+	delete(kv);
+}
+
+
+
+
+//------------------------------------------------------------------------------------
+/** Implementacion original de readLine, con una lectura por byte, como referencia del benchmark */
+static size_t readLineBytewise(char* result, size_t max_len, FILE* stream){
+	size_t s = 0;
+	do{
+		size_t count = fat->read(&result[s], sizeof(char), 1, stream);
+		if(count == 0){
+			break;
+		}
+		s += count;
+	}while(result[s-1] != '\n' && s < max_len);
+	result[s] = 0;
+	return s;
+}
+
+TEST_CASE("LECTURA DE LINEAS EN BLOQUE_", "[FATInterface]") {
+	TEST_ASSERT_NOT_NULL(fat);
+	static const int NumLines = 2000;
+	FILE *f = fat->open("bench.txt","w");
+	TEST_ASSERT_NOT_NULL(f);
+	char chunk[128];
+	for(int i=0;i<NumLines;i++){
+		sprintf(chunk, "%d,sensor,%d,%d\r\n", i, i*3, i*7);
+		fat->write(chunk, sizeof(char), strlen(chunk), f);
+	}
+	fat->close(f);
+
+	// referencia: lectura byte a byte
+	f = fat->open("bench.txt","r");
+	TEST_ASSERT_NOT_NULL(f);
+	uint32_t t0 = FATPlatform::now_us();
+	int count = 0;
+	while(readLineBytewise(chunk, sizeof(chunk)-1, f) > 0){
+		count++;
+	}
+	uint32_t t_bytewise = FATPlatform::now_us() - t0;
+	fat->close(f);
+	TEST_ASSERT_EQUAL(NumLines, count);
+
+	// readLine
+	f = fat->open("bench.txt","r");
+	TEST_ASSERT_NOT_NULL(f);
+	t0 = FATPlatform::now_us();
+	count = 0;
+	while(fat->readLine(chunk, sizeof(chunk)-1, f) > 0){
+		count++;
+	}
+	uint32_t t_readline = FATPlatform::now_us() - t0;
+	fat->close(f);
+	TEST_ASSERT_EQUAL(NumLines, count);
+
+	// FATLineReader
+	f = fat->open("bench.txt","r");
+	TEST_ASSERT_NOT_NULL(f);
+	t0 = FATPlatform::now_us();
+	FATLineReader* reader = new FATLineReader(fat, f, 8192);
+	const char* line;
+	size_t len;
+	count = 0;
+	while(reader->next(&line, &len)){
+		sprintf(chunk, "%d,sensor,%d,%d", count, count*3, count*7);
+		TEST_ASSERT_EQUAL(strlen(chunk), len);
+		TEST_ASSERT_EQUAL(0, strncmp(chunk, line, len));
+		count++;
+	}
+	uint32_t t_reader = FATPlatform::now_us() - t0;
+	delete(reader);
+	fat->close(f);
+	TEST_ASSERT_EQUAL(NumLines, count);
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "%d lineas: byte a byte %d us, readLine %d us, FATLineReader %d us", NumLines, t_bytewise, t_readline, t_reader);
+}
+
+
+//------------------------------------------------------------------------------------
+TEST_CASE("INDICE DE LINEAS____________", "[FATInterface]") {
+	TEST_ASSERT_NOT_NULL(fat);
+	fat->eraseFile("index.txt");
+	fat->eraseFile("index.txt.lix");
+	FILE *f = fat->open("index.txt","w");
+	TEST_ASSERT_NOT_NULL(f);
+	char chunk[32];
+	for(int i=0;i<1000;i++){
+		sprintf(chunk, "Linea %d\n", i);
+		fat->write(chunk, sizeof(char), strlen(chunk), f);
+	}
+	fat->close(f);
+	f = fat->open("index.txt","r");
+	TEST_ASSERT_NOT_NULL(f);
+	TEST_ASSERT_EQUAL(1000, fat->getLineCount(f));
+	fat->close(f);
+	TEST_ASSERT_EQUAL(1000, fat->getLineCount("index.txt"));
+
+	// al aniadir lineas solo se indexa el final del archivo
+	f = fat->open("index.txt","a");
+	TEST_ASSERT_NOT_NULL(f);
+	for(int i=1000;i<1300;i++){
+		sprintf(chunk, "Linea %d\n", i);
+		fat->write(chunk, sizeof(char), strlen(chunk), f);
+	}
+	fat->close(f);
+	TEST_ASSERT_EQUAL(1300, fat->getLineCount("index.txt"));
+
+	FATLineIndex index(fat, "index.txt");
+	TEST_ASSERT_EQUAL(0, index.update());
+	TEST_ASSERT_EQUAL(1300, index.getLineCount());
+	f = fat->open("index.txt","r");
+	TEST_ASSERT_NOT_NULL(f);
+	TEST_ASSERT_EQUAL(0, index.seekLine(f, 1100));
+	TEST_ASSERT_NOT_NULL(fgets(chunk, sizeof(chunk), f));
+	TEST_ASSERT_EQUAL_STRING("Linea 1100\n", chunk);
+	TEST_ASSERT_NOT_EQUAL(0, index.seekLine(f, 1301));
+	fat->close(f);
+
+	// las lineas aniadidas con appendLines quedan indexadas sin esperar a una consulta
+	for(int i=1300;i<1400;i++){
+		sprintf(chunk, "Linea %d\n", i);
+		TEST_ASSERT_EQUAL(0, fat->appendLines("index.txt", chunk, strlen(chunk)));
+	}
+	uint32_t lix[4];
+	f = fat->open("index.txt.lix","rb");
+	TEST_ASSERT_NOT_NULL(f);
+	TEST_ASSERT_EQUAL(4, fat->read(lix, sizeof(uint32_t), 4, f));
+	fat->close(f);
+	TEST_ASSERT_EQUAL(fat->getFileSize("index.txt"), lix[2]);
+	TEST_ASSERT_EQUAL(1400, lix[3]);
+	TEST_ASSERT_EQUAL(0, index.append("Linea 1400\n", 11));
+	TEST_ASSERT_EQUAL(1401, index.getLineCount());
+	TEST_ASSERT_EQUAL(1401, fat->getLineCount("index.txt"));
+}
+
+
+//------------------------------------------------------------------------------------
+static int page_errors = 0;
+static bool visitPageLine(size_t number, const char* line, size_t len){
+	char expected[32];
+	sprintf(expected, "Linea %d", (int)number);
+	if(len != strlen(expected) || strncmp(expected, line, len) != 0){
+		page_errors++;
+	}
+	return true;
+}
+static bool visitLongLine(size_t number, const char* line, size_t len){
+	// la linea 1 excede el buffer de lectura y se entrega truncada
+	if(number == 1){
+		if(len != FATLineReader_DEFAULT_BLOCK_SIZE || line[0] != 'x' || line[len - 1] != 'x'){
+			page_errors++;
+		}
+		return true;
+	}
+	return visitPageLine(number, line, len);
+}
+
+TEST_CASE("LECTURA DE RANGO DE LINEAS__", "[FATInterface]") {
+	TEST_ASSERT_NOT_NULL(fat);
+	fat->eraseFile("page.txt");
+	fat->eraseFile("page.txt.lix");
+	FILE *f = fat->open("page.txt","w");
+	TEST_ASSERT_NOT_NULL(f);
+	char chunk[32];
+	for(int i=0;i<1000;i++){
+		sprintf(chunk, "Linea %d\r\n", i);
+		fat->write(chunk, sizeof(char), strlen(chunk), f);
+	}
+	fat->close(f);
+
+	page_errors = 0;
+	TEST_ASSERT_EQUAL(50, fat->readLines("page.txt", 900, 50, callback(visitPageLine)));
+	TEST_ASSERT_EQUAL(0, page_errors);
+
+	// pagina final incompleta
+	TEST_ASSERT_EQUAL(10, fat->readLines("page.txt", 990, 50, callback(visitPageLine)));
+	TEST_ASSERT_EQUAL(0, page_errors);
+	TEST_ASSERT_EQUAL(0, fat->readLines("page.txt", 1001, 50, callback(visitPageLine)));
+
+	// una linea mayor que el buffer cuenta como una sola linea
+	fat->eraseFile("long.txt");
+	fat->eraseFile("long.txt.lix");
+	f = fat->open("long.txt","w");
+	TEST_ASSERT_NOT_NULL(f);
+	fat->write("Linea 0\n", sizeof(char), 8, f);
+	memset(chunk, 'x', sizeof(chunk));
+	for(int i=0;i<9000/(int)sizeof(chunk);i++){
+		fat->write(chunk, sizeof(char), sizeof(chunk), f);
+	}
+	fat->write("\nLinea 2\nLinea 3\n", sizeof(char), 17, f);
+	fat->close(f);
+	TEST_ASSERT_EQUAL(4, fat->getLineCount("long.txt"));
+	page_errors = 0;
+	TEST_ASSERT_EQUAL(4, fat->readLines("long.txt", 0, 4, callback(visitLongLine)));
+	TEST_ASSERT_EQUAL(0, page_errors);
+	TEST_ASSERT_EQUAL(2, fat->readLines("long.txt", 2, 4, callback(visitLongLine)));
+	TEST_ASSERT_EQUAL(0, page_errors);
+
+	f = fat->open("long.txt","r");
+	TEST_ASSERT_NOT_NULL(f);
+	FATLineReader reader(fat, f);
+	const char* line;
+	size_t len;
+	bool truncated = true;
+	TEST_ASSERT_TRUE(reader.next(&line, &len, &truncated));
+	TEST_ASSERT_FALSE(truncated);
+	TEST_ASSERT_TRUE(reader.next(&line, &len, &truncated));
+	TEST_ASSERT_TRUE(truncated);
+	TEST_ASSERT_TRUE(reader.next(&line, &len, &truncated));
+	TEST_ASSERT_FALSE(truncated);
+	TEST_ASSERT_EQUAL(0, strncmp("Linea 2", line, len));
+	TEST_ASSERT_TRUE(reader.next(&line, &len));
+	TEST_ASSERT_FALSE(reader.next(&line, &len));
+	TEST_ASSERT_EQUAL(4, reader.getLineNumber());
+	fat->close(f);
+}
+
+
+//------------------------------------------------------------------------------------
+TEST_CASE("PATH DEMASIADO LARGO________", "[FATInterface]") {
+	TEST_ASSERT_NOT_NULL(fat);
+	char name[MAX_FULL_PATH_LENGTH + 8];
+	memset(name, 'a', sizeof(name) - 1);
+	name[sizeof(name) - 1] = 0;
+	TEST_ASSERT_NULL(fat->open(name, "w"));
+	TEST_ASSERT_NOT_EQUAL(0, fat->eraseFile(name));
+	TEST_ASSERT_NOT_EQUAL(0, fat->createFolder(name));
+	TEST_ASSERT_FALSE(fat->fileExists(name));
+	std::list<const char*> file_list;
+	TEST_ASSERT_EQUAL(-1, fat->listFolder(name, &file_list));
+}
+
+
+//------------------------------------------------------------------------------------
+static int dir_visited = 0;
+static int dir_stop_at = 0;
+static bool visitFile(const FATInterface::FATDirEntry& entry){
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Archivo %s, %d bytes", entry.name, entry.size);
+	return (++dir_visited != dir_stop_at);
+}
+
+TEST_CASE("RECORRE DIRECTORIO__________", "[FATInterface]") {
+	TEST_ASSERT_NOT_NULL(fat);
+	TEST_ASSERT_EQUAL(0, fat->createFolder("iter"));
+	char name[32];
+	for(int i=0;i<20;i++){
+		sprintf(name, "iter/log_%02d.%s", i, (i % 2)? "txt" : "bin");
+		FILE* f = fat->open(name, "w");
+		TEST_ASSERT_NOT_NULL(f);
+		fat->write(name, sizeof(char), strlen(name), f);
+		fat->close(f);
+	}
+	dir_visited = 0;
+	dir_stop_at = 0;
+	TEST_ASSERT_EQUAL(10, fat->forEachFile("iter", callback(visitFile), "log_", "txt"));
+
+	// paginas de 3 archivos
+	long cookie = 0;
+	int total = 0;
+	dir_stop_at = 3;
+	do{
+		dir_visited = 0;
+		int count = fat->forEachFile("iter", callback(visitFile), NULL, NULL, false, &cookie);
+		TEST_ASSERT_TRUE(count >= 0);
+		total += count;
+	}while(cookie != -1);
+	TEST_ASSERT_EQUAL(20, total);
+	// el recorrido finalizado no vuelve al inicio
+	dir_visited = 0;
+	TEST_ASSERT_EQUAL(0, fat->forEachFile("iter", callback(visitFile), NULL, NULL, false, &cookie));
+	TEST_ASSERT_EQUAL(0, dir_visited);
+	TEST_ASSERT_EQUAL(-1, cookie);
+}
+
+
+//------------------------------------------------------------------------------------
+static uint32_t copy_progress = 0;
+static bool copyProgress(uint32_t copied, uint32_t total){
+	copy_progress = copied;
+	return true;
+}
+static bool copyCancel(uint32_t copied, uint32_t total){
+	return false;
+}
+
+TEST_CASE("COPIA DE ARCHIVOS___________", "[FATInterface]") {
+	TEST_ASSERT_NOT_NULL(fat);
+	static const uint32_t FileSize = 20000;
+	FILE* f = fat->open("copy_src.bin", "wb");
+	TEST_ASSERT_NOT_NULL(f);
+	for(uint32_t i=0;i<FileSize;i++){
+		uint8_t b = (uint8_t)i;
+		fat->write(&b, sizeof(uint8_t), 1, f);
+	}
+	fat->close(f);
+
+	uint32_t* buffer = new uint32_t[2 * FAT_SECTOR_SIZE / sizeof(uint32_t)];
+	TEST_ASSERT_NOT_NULL(buffer);
+	TEST_ASSERT_EQUAL(0, fat->copyFile("copy_src.bin", "copy_dst.bin", false, buffer, 2 * FAT_SECTOR_SIZE, callback(copyProgress)));
+	TEST_ASSERT_EQUAL(FileSize, copy_progress);
+	delete[](buffer);
+
+	// cancelacion, sin archivo destino
+	TEST_ASSERT_EQUAL(-2, fat->copyFile("copy_src.bin", "copy_can.bin", false, NULL, 0, callback(copyCancel)));
+	TEST_ASSERT_FALSE(fat->fileExists("copy_can.bin"));
+
+	// movimiento
+	TEST_ASSERT_EQUAL(0, fat->copyFile("copy_dst.bin", "copy_mov.bin", true));
+	TEST_ASSERT_FALSE(fat->fileExists("copy_dst.bin"));
+	f = fat->open("copy_mov.bin", "rb");
+	TEST_ASSERT_NOT_NULL(f);
+	fseek(f, 0, SEEK_END);
+	TEST_ASSERT_EQUAL(FileSize, ftell(f));
+	fat->close(f);
+
+	// movimiento sobre un destino existente, que se sustituye
+	f = fat->open("copy_old.bin", "wb");
+	TEST_ASSERT_NOT_NULL(f);
+	fat->write("x", sizeof(char), 1, f);
+	fat->close(f);
+	TEST_ASSERT_EQUAL(0, fat->copyFile("copy_mov.bin", "copy_old.bin", true));
+	TEST_ASSERT_FALSE(fat->fileExists("copy_mov.bin"));
+	TEST_ASSERT_EQUAL(FileSize, fat->getFileSize("copy_old.bin"));
+
+	// un movimiento fallido conserva el destino
+	TEST_ASSERT_EQUAL(-1, fat->copyFile("copy_mov.bin", "copy_old.bin", true));
+	TEST_ASSERT_EQUAL(FileSize, fat->getFileSize("copy_old.bin"));
+	fat->eraseFile("copy_src.bin");
+	fat->eraseFile("copy_old.bin");
+}
+
+
+//------------------------------------------------------------------------------------
+TEST_CASE("CACHE DE METADATOS__________", "[FATInterface]") {
+	TEST_ASSERT_NOT_NULL(fat);
+	fat->setMetadataCache(16);
+	fat->eraseFile("meta.txt");
+	TEST_ASSERT_FALSE(fat->fileExists("meta.txt"));
+	TEST_ASSERT_FALSE(fat->fileExists("meta.txt"));
+	uint32_t hits, misses;
+	fat->getMetadataCacheStats(&hits, &misses);
+	TEST_ASSERT_EQUAL(1, hits);
+
+	// la creacion y las escrituras mantienen la cache coherente
+	FILE* f = fat->open("meta.txt", "w");
+	TEST_ASSERT_NOT_NULL(f);
+	TEST_ASSERT_TRUE(fat->fileExists("meta.txt"));
+	fat->write("12345", sizeof(char), 5, f);
+	fat->close(f);
+	TEST_ASSERT_EQUAL(5, fat->getFileSize("meta.txt"));
+	f = fat->open("meta.txt", "a");
+	TEST_ASSERT_NOT_NULL(f);
+	fat->write("67", sizeof(char), 2, f);
+	fat->close(f);
+	TEST_ASSERT_EQUAL(7, fat->getFileSize("meta.txt"));
+
+	// el tamanio consultado con datos en el buffer de stdio se descarta al volcar y al cerrar
+	f = fat->open("meta.txt", "a");
+	TEST_ASSERT_NOT_NULL(f);
+	fat->write("89", sizeof(char), 2, f);
+	TEST_ASSERT_EQUAL(7, fat->getFileSize("meta.txt"));
+	TEST_ASSERT_EQUAL(0, fat->flush(f));
+	TEST_ASSERT_EQUAL(9, fat->getFileSize("meta.txt"));
+	fat->write("0", sizeof(char), 1, f);
+	TEST_ASSERT_EQUAL(9, fat->getFileSize("meta.txt"));
+	fat->close(f);
+	TEST_ASSERT_EQUAL(10, fat->getFileSize("meta.txt"));
+
+	fat->eraseFile("meta_ren.txt");
+	TEST_ASSERT_EQUAL(0, fat->renameFile("meta.txt", "meta_ren.txt"));
+	TEST_ASSERT_FALSE(fat->fileExists("meta.txt"));
+	TEST_ASSERT_TRUE(fat->fileExists("meta_ren.txt"));
+	TEST_ASSERT_EQUAL(0, fat->eraseFile("meta_ren.txt"));
+	TEST_ASSERT_FALSE(fat->fileExists("meta_ren.txt"));
+	fat->setMetadataCache(0);
+}
+
+
+//------------------------------------------------------------------------------------
+static const int ConcurrentLines = 2000;
+static std::atomic<int> conc_errors(0);
+static void concurrentWriter(const char* name){
+	// se ejecuta tambien en threads auxiliares: los errores se registran y se comprueban en el test
+	FILE* f = fat->open(name, "w");
+	if(!f){
+		conc_errors++;
+		return;
+	}
+	char line[48];
+	for(int i=0;i<ConcurrentLines;i++){
+		int len = sprintf(line, "%s,%d,telemetria\n", name, i);
+		if(fat->write(line, sizeof(char), len, f) != (size_t)len){
+			conc_errors++;
+		}
+	}
+	fat->close(f);
+}
+static void concurrentReader(){
+	FILE* f = fat->open("conc_src.txt", "r");
+	if(!f){
+		conc_errors++;
+		return;
+	}
+	if(fat->getLineCount(f) != ConcurrentLines){
+		conc_errors++;
+	}
+	fat->close(f);
+}
+static void writerA(){ concurrentWriter("conc_a.txt"); }
+static void writerB(){ concurrentWriter("conc_b.txt"); }
+static void readerA(){ concurrentReader(); }
+static void readerB(){ concurrentReader(); }
+
+TEST_CASE("ACCESO CONCURRENTE__________", "[FATInterface]") {
+	TEST_ASSERT_NOT_NULL(fat);
+	conc_errors = 0;
+	concurrentWriter("conc_src.txt");
+
+	// ejecucion secuencial
+	uint32_t t0 = FATPlatform::now_us();
+	writerA();
+	writerB();
+	readerA();
+	readerB();
+	uint32_t t_seq = FATPlatform::now_us() - t0;
+
+	// ejecucion concurrente
+	Thread* th[4];
+	void (*tasks[4])() = {writerA, writerB, readerA, readerB};
+	t0 = FATPlatform::now_us();
+	for(int i=0;i<4;i++){
+		th[i] = new Thread(osPriorityNormal, 4096, NULL, "FATConc");
+		TEST_ASSERT_NOT_NULL(th[i]);
+		th[i]->start(callback(tasks[i]));
+	}
+	for(int i=0;i<4;i++){
+		th[i]->join();
+		delete(th[i]);
+	}
+	uint32_t t_conc = FATPlatform::now_us() - t0;
+	TEST_ASSERT_EQUAL(0, conc_errors.load());
+
+	const char* files[] = {"conc_a.txt", "conc_b.txt"};
+	for(int i=0;i<2;i++){
+		FILE* f = fat->open(files[i], "r");
+		TEST_ASSERT_NOT_NULL(f);
+		TEST_ASSERT_EQUAL(ConcurrentLines, fat->getLineCount(f));
+		fat->close(f);
+		fat->eraseFile(files[i]);
+	}
+	fat->eraseFile("conc_src.txt");
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "2 escritores + 2 lectores: secuencial %d us, concurrente %d us", t_seq, t_conc);
+}
+
+
+//------------------------------------------------------------------------------------
+TEST_CASE("LOG CON VOLCADO AGRUPADO____", "[FATInterface]") {
+	TEST_ASSERT_NOT_NULL(fat);
+	static const int NumEvents = 1000;
+	fat->eraseFile("events.log");
+	LogWriter* log = new LogWriter(fat, "events.log", 2048, 500);
+	TEST_ASSERT_NOT_NULL(log);
+	TEST_ASSERT_TRUE(log->ready());
+	char line[48];
+	uint32_t t0 = FATPlatform::now_us();
+	for(int i=0;i<NumEvents;i++){
+		sprintf(line, "%d,evento,%d", i, i*3);
+		TEST_ASSERT_EQUAL(0, log->appendLine(line));
+	}
+	TEST_ASSERT_EQUAL(0, log->sync());
+	uint32_t t_log = FATPlatform::now_us() - t0;
+	uint32_t records, groups;
+	log->getCounters(&records, &groups);
+	TEST_ASSERT_EQUAL(NumEvents, records);
+	TEST_ASSERT_TRUE(groups < records);
+	delete(log);
+
+	FILE* f = fat->open("events.log", "r");
+	TEST_ASSERT_NOT_NULL(f);
+	TEST_ASSERT_EQUAL(NumEvents, fat->getLineCount(f));
+	fat->close(f);
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "%d eventos en %d volcados, %d us", records, groups, t_log);
+
+#if defined(ENABLE_TEST_HOST)
+	// un volcado fallido (/dev/full) deja el error permanente
+	FATPlatformPosix* dev = new FATPlatformPosix("");
+	FATInterface* full = new FATInterface("dev", "dev", 1, false, dev);
+	TEST_ASSERT_TRUE(full->isReady());
+	log = new LogWriter(full, "full", 64, 500);
+	TEST_ASSERT_TRUE(log->ready());
+	TEST_ASSERT_EQUAL(0, log->appendLine("perdido"));
+	TEST_ASSERT_TRUE(log->sync() < 0);
+	TEST_ASSERT_TRUE(log->appendLine("siguiente") < 0);
+	TEST_ASSERT_TRUE(log->sync() < 0);
+	delete(log);
+	delete(full);
+	delete(dev);
+#endif
+}
+
+
+//------------------------------------------------------------------------------------
+TEST_CASE("LOG ROTATIVO________________", "[FATInterface]") {
+	TEST_ASSERT_NOT_NULL(fat);
+	for(int i=0;i<4;i++){
+		char name[16];
+		sprintf(name, "rot.log.%d", i);
+		fat->eraseFile(name);
+	}
+	fat->eraseFile("rot.log.idx");
+	FATRotatingLog* log = new FATRotatingLog(fat, "rot.log", 1000, 4);
+	TEST_ASSERT_NOT_NULL(log);
+	TEST_ASSERT_TRUE(log->ready());
+	char line[16];
+	// 11 bytes por linea, 90 lineas por archivo
+	for(int i=0;i<500;i++){
+		sprintf(line, "linea %04d", i);
+		TEST_ASSERT_EQUAL(0, log->writeLine(line));
+	}
+	TEST_ASSERT_EQUAL(5, log->getSequence());
+	uint32_t size = log->getCurrentSize();
+	delete(log);
+
+	// al reabrir se retoma el archivo actual desde el indice
+	log = new FATRotatingLog(fat, "rot.log", 1000, 4);
+	TEST_ASSERT_NOT_NULL(log);
+	TEST_ASSERT_EQUAL(5, log->getSequence());
+	TEST_ASSERT_EQUAL(size, log->getCurrentSize());
+	char name[32];
+	TEST_ASSERT_TRUE(log->getFileName(3, name, sizeof(name)));
+	FILE* f = fat->open(name, "r");
+	TEST_ASSERT_NOT_NULL(f);
+	TEST_ASSERT_TRUE(fat->readLine(line, sizeof(line) - 1, f) > 0);
+	TEST_ASSERT_EQUAL(0, strncmp(line, "linea 0180", 10));
+	fat->close(f);
+	for(int i=0;i<4;i++){
+		TEST_ASSERT_TRUE(log->getFileName(i, name, sizeof(name)));
+		TEST_ASSERT_TRUE(fat->getFileSize(name) <= 1000);
+	}
+	char current[32];
+	TEST_ASSERT_TRUE(log->getFileName(0, current, sizeof(current)));
+	delete(log);
+
+	// con la ultima copia del indice corrupta se retoma la anterior (la secuencia 5 esta en la segunda copia, de
+	// 16 bytes)
+	f = fat->open("rot.log.idx", "r+b");
+	TEST_ASSERT_NOT_NULL(f);
+	fseek(f, 16, SEEK_SET);
+	fat->write("XXXX", sizeof(char), 4, f);
+	fat->close(f);
+	log = new FATRotatingLog(fat, "rot.log", 1000, 4);
+	TEST_ASSERT_NOT_NULL(log);
+	TEST_ASSERT_EQUAL(4, log->getSequence());
+	delete(log);
+
+	// sin indice, el archivo actual es el de menor tamanio no vacio
+	fat->eraseFile("rot.log.idx");
+	log = new FATRotatingLog(fat, "rot.log", 1000, 4);
+	TEST_ASSERT_NOT_NULL(log);
+	TEST_ASSERT_TRUE(log->getFileName(0, name, sizeof(name)));
+	TEST_ASSERT_EQUAL_STRING(current, name);
+	TEST_ASSERT_EQUAL(size, log->getCurrentSize());
+	delete(log);
+}
+
+
+//------------------------------------------------------------------------------------
+TEST_CASE("ROTACION PATH DEMASIADO LARGO", "[FATInterface]") {
+	TEST_ASSERT_NOT_NULL(fat);
+	char base[MAX_PATH_NAME_LENGTH];
+	memset(base, 'r', sizeof(base) - 1);
+	base[sizeof(base) - 1] = 0;
+	FATRotatingLog* log = new FATRotatingLog(fat, base, 1000, 4);
+	TEST_ASSERT_FALSE(log->ready());
+	TEST_ASSERT_EQUAL(-1, log->writeLine("linea"));
+	delete(log);
+	// los archivos del anillo caben en MAX_PATH_NAME_LENGTH, pero no el indice
+	base[MAX_PATH_NAME_LENGTH - 4] = 0;
+	log = new FATRotatingLog(fat, base, 1000, 4);
+	TEST_ASSERT_FALSE(log->ready());
+	delete(log);
+}
+
+
+//------------------------------------------------------------------------------------
+static std::atomic<int> async_writes(0);
+static std::atomic<int> async_errors(0);
+static void asyncDone(const FATAsyncIO::Result& res){
+	if(res.op == FATAsyncIO::OpWrite){
+		async_writes++;
+	}
+	if(res.result < 0){
+		async_errors++;
+	}
+}
+
+TEST_CASE("E/S ASINCRONA_______________", "[FATInterface]") {
+	TEST_ASSERT_NOT_NULL(fat);
+	static const int NumWrites = 100;
+	FATAsyncIO* io = new FATAsyncIO(fat, 2, 8, 1000);
+	TEST_ASSERT_NOT_NULL(io);
+	async_writes = 0;
+	async_errors = 0;
+	int handles[2];
+	const char* files[] = {"async_a.txt", "async_b.txt"};
+	for(int k=0;k<2;k++){
+		handles[k] = io->open(files[k], "w", callback(asyncDone));
+		TEST_ASSERT_TRUE(handles[k] > 0);
+	}
+	char line[16];
+	for(int i=0;i<NumWrites;i++){
+		for(int k=0;k<2;k++){
+			sprintf(line, "%d:%07d\n", k, i);
+			TEST_ASSERT_EQUAL(0, io->write(handles[k], line, strlen(line), callback(asyncDone)));
+		}
+	}
+	for(int k=0;k<2;k++){
+		TEST_ASSERT_EQUAL(0, io->close(handles[k], callback(asyncDone)));
+	}
+	TEST_ASSERT_EQUAL(0, io->drain(10000));
+	TEST_ASSERT_EQUAL(2 * NumWrites, async_writes.load());
+	TEST_ASSERT_EQUAL(0, async_errors.load());
+	FATAsyncIO::Stats stats;
+	io->getStats(&stats);
+	TEST_ASSERT_EQUAL(stats.submitted, stats.completed);
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Cola E/S: max %d, bloqueos %d, rechazos %d, espera max %d us", stats.max_depth, stats.blocked, stats.rejected, stats.max_wait_us);
+	delete(io);
+
+	// el contenido de cada archivo respeta el orden de solicitud
+	for(int k=0;k<2;k++){
+		FILE* f = fat->open(files[k], "r");
+		TEST_ASSERT_NOT_NULL(f);
+		char expected[16];
+		for(int i=0;i<NumWrites;i++){
+			TEST_ASSERT_TRUE(fat->readLine(line, sizeof(line) - 1, f) > 0);
+			sprintf(expected, "%d:%07d\n", k, i);
+			TEST_ASSERT_EQUAL_STRING(expected, line);
+		}
+		fat->close(f);
+		fat->eraseFile(files[k]);
+	}
+}
+
+
+//------------------------------------------------------------------------------------
+struct RingSample{
+	uint32_t id;
+	int32_t value;
+};
+static uint32_t ring_last = 0;
+static int ring_errors = 0;
+static bool visitSample(uint32_t sequence, const void* record){
+	const RingSample* sample = (const RingSample*)record;
+	if(sample->id != sequence || sequence >= ring_last){
+		ring_errors++;
+	}
+	ring_last = sequence;
+	return true;
+}
+
+TEST_CASE("ARCHIVO CIRCULAR____________", "[FATInterface]") {
+	TEST_ASSERT_NOT_NULL(fat);
+	fat->eraseFile("ring.bin");
+	FATRingFile* ring = new FATRingFile(fat, "ring.bin", sizeof(RingSample), 100);
+	TEST_ASSERT_NOT_NULL(ring);
+	TEST_ASSERT_TRUE(ring->ready());
+	int32_t size = fat->getFileSize("ring.bin");
+	RingSample sample;
+	for(uint32_t i=0;i<250;i++){
+		sample.id = i;
+		sample.value = i * 10;
+		TEST_ASSERT_EQUAL(0, ring->append(&sample));
+	}
+	TEST_ASSERT_EQUAL(0, ring->sync());
+	TEST_ASSERT_EQUAL(100, ring->getCount());
+	TEST_ASSERT_EQUAL(size, fat->getFileSize("ring.bin"));
+	delete(ring);
+
+	// al reabrir se recupera la posicion desde la cabecera
+	ring = new FATRingFile(fat, "ring.bin", sizeof(RingSample), 100);
+	TEST_ASSERT_NOT_NULL(ring);
+	TEST_ASSERT_EQUAL(250, ring->getSequence());
+	TEST_ASSERT_EQUAL(0, ring->read(0, &sample));
+	TEST_ASSERT_EQUAL(249, sample.id);
+	TEST_ASSERT_EQUAL(0, ring->read(99, &sample));
+	TEST_ASSERT_EQUAL(150, sample.id);
+	TEST_ASSERT_NOT_EQUAL(0, ring->read(100, &sample));
+	ring_last = 250;
+	ring_errors = 0;
+	TEST_ASSERT_EQUAL(100, ring->forEach(callback(visitSample)));
+	TEST_ASSERT_EQUAL(0, ring_errors);
+	delete(ring);
+
+	// formatos no validos
+	ring = new FATRingFile(fat, "ring0.bin", sizeof(RingSample), 0);
+	TEST_ASSERT_FALSE(ring->ready());
+	TEST_ASSERT_NOT_EQUAL(0, ring->append(&sample));
+	delete(ring);
+	ring = new FATRingFile(fat, "ring0.bin", 0, 100);
+	TEST_ASSERT_FALSE(ring->ready());
+	delete(ring);
+	TEST_ASSERT_FALSE(fat->fileExists("ring0.bin"));
+}
+
+
+//------------------------------------------------------------------------------------
+struct SeriesEvent{
+	int32_t value;
+	uint16_t code;
+	uint16_t flags;
+};
+static int series_errors = 0;
+static bool visitEvent(uint32_t timestamp, const void* payload){
+	SeriesEvent ev;
+	memcpy(&ev, payload, sizeof(SeriesEvent));
+	if(ev.value != (int32_t)(timestamp * 2)){
+		series_errors++;
+	}
+	return true;
+}
+
+TEST_CASE("SERIE TEMPORAL______________", "[FATInterface]") {
+	TEST_ASSERT_NOT_NULL(fat);
+	FATSeriesStore* store = new FATSeriesStore(fat, "series", sizeof(SeriesEvent), 64, 16);
+	TEST_ASSERT_NOT_NULL(store);
+	TEST_ASSERT_TRUE(store->ready());
+	uint32_t first = store->getCount();
+	// continua tras la ultima marca de tiempo de ejecuciones anteriores
+	uint32_t t0 = 100000 + first * 2;
+	for(uint32_t i=0;i<5000;i++){
+		SeriesEvent ev = {(int32_t)((t0 + i * 2) * 2), 1, 0};
+		TEST_ASSERT_EQUAL(0, store->append(t0 + i * 2, ev));
+	}
+	SeriesEvent old = {0, 0, 0};
+	TEST_ASSERT_NOT_EQUAL(0, store->append(t0 - 1, old));
+	TEST_ASSERT_EQUAL(0, store->sync());
+	delete(store);
+
+	store = new FATSeriesStore(fat, "series", sizeof(SeriesEvent), 64, 16);
+	TEST_ASSERT_NOT_NULL(store);
+	TEST_ASSERT_EQUAL(first + 5000, store->getCount());
+	series_errors = 0;
+	uint32_t t_start = FATPlatform::now_us();
+	TEST_ASSERT_EQUAL(101, store->query(t0 + 4000, t0 + 4200, callback(visitEvent)));
+	uint32_t t_query = FATPlatform::now_us() - t_start;
+	TEST_ASSERT_EQUAL(0, series_errors);
+	TEST_ASSERT_TRUE(store->getLastQueryBlocks() <= 3);
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Consulta de 101 registros: %d bloques leidos, %d us", store->getLastQueryBlocks(), t_query);
+	delete(store);
+
+	// resumenes perdidos en un corte (20 bloques, mas de un segmento): se reconstruyen al recuperar
+	int32_t idx_size = fat->getFileSize("series/series.tsi");
+	uint32_t summaries = (first + 5000) / 64;
+	uint32_t kept_size = (summaries - 20) * (idx_size / summaries);
+	uint8_t* idx = new uint8_t[idx_size];
+	FILE* f = fat->open("series/series.tsi", "rb");
+	TEST_ASSERT_NOT_NULL(f);
+	TEST_ASSERT_EQUAL(idx_size, fat->read(idx, 1, idx_size, f));
+	fat->close(f);
+	f = fat->open("series/series.tsi", "wb");
+	TEST_ASSERT_NOT_NULL(f);
+	TEST_ASSERT_EQUAL(kept_size, fat->write(idx, 1, kept_size, f));
+	fat->close(f);
+	delete[](idx);
+	store = new FATSeriesStore(fat, "series", sizeof(SeriesEvent), 64, 16);
+	TEST_ASSERT_TRUE(store->ready());
+	TEST_ASSERT_EQUAL(first + 5000, store->getCount());
+	TEST_ASSERT_EQUAL(101, store->query(t0 + 4000, t0 + 4200, callback(visitEvent)));
+	TEST_ASSERT_EQUAL(0, series_errors);
+	delete(store);
+}
+
+
+//------------------------------------------------------------------------------------
+TEST_CASE("SERIES PATH DEMASIADO LARGO_", "[FATInterface]") {
+	TEST_ASSERT_NOT_NULL(fat);
+	char folder[MAX_PATH_NAME_LENGTH + 8];
+	memset(folder, 's', sizeof(folder) - 1);
+	folder[sizeof(folder) - 1] = 0;
+	FATSeriesStore* store = new FATSeriesStore(fat, folder, sizeof(SeriesEvent), 64, 16);
+	TEST_ASSERT_FALSE(store->ready());
+	TEST_ASSERT_EQUAL(-1, store->append(0, folder));
+	delete(store);
+	// el indice cabe en MAX_PATH_NAME_LENGTH, pero no el nombre de los segmentos
+	folder[MAX_PATH_NAME_LENGTH - 13] = 0;
+	store = new FATSeriesStore(fat, folder, sizeof(SeriesEvent), 64, 16);
+	TEST_ASSERT_FALSE(store->ready());
+	delete(store);
+	char name[MAX_PATH_NAME_LENGTH];
+	snprintf(name, MAX_PATH_NAME_LENGTH, "%s/series.tsi", folder);
+	fat->eraseFile(name);
+}
+
+
+
+
 //------------------------------------------------------------------------------------
 //-- TEST ENRY POINT -----------------------------------------------------------------
 //------------------------------------------------------------------------------------
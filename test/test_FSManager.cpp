@@ -0,0 +1,585 @@
+/*
+ * test_FSManager.cpp
+ *
+ *	Test unitario para el modulo FSManager
+ */
+
+
+
+//------------------------------------------------------------------------------------
+//-- TEST HEADERS --------------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+#include "unity.h"
+#include "FSManager.h"
+#include "NVSBlobStream.h"
+#include "mbed.h"
+#include "AppConfig.h"
+#include "Heap.h"
+#include <atomic>
+
+
+#if ESP_PLATFORM == 1 || (__MBED__ == 1 && defined(ENABLE_TEST_DEBUGGING) && defined(ENABLE_TEST_FSManager)) || defined(ENABLE_TEST_HOST)
+
+/** Requerido para test unitarios ESP-MDF */
+#if ESP_PLATFORM == 1
+
+/** Requerido para test unitarios STM32 */
+#elif __MBED__ == 1 && defined(ENABLE_TEST_DEBUGGING) && defined(ENABLE_TEST_FSManager)
+#include "unity_test_runner.h"
+#endif
+
+
+//------------------------------------------------------------------------------------
+//-- SPECIFIC COMPONENTS FOR TESTING -------------------------------------------------
+//------------------------------------------------------------------------------------
+
+static const char* _MODULE_ = "[TEST_FS].......";
+#define _EXPR_	(true)
+
+
+//------------------------------------------------------------------------------------
+//-- REQUIRED HEADERS & COMPONENTS FOR TESTING ---------------------------------------
+//------------------------------------------------------------------------------------
+
+static FSManager* fs = NULL;
+
+//------------------------------------------------------------------------------------
+//-- TEST CASES ----------------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+
+//------------------------------------------------------------------------------------
+TEST_CASE("CREA FSMANAGER______________", "[FSManager]") {
+	TEST_ASSERT_NULL(fs);
+	fs = new FSManager("test_fs");
+	TEST_ASSERT_NOT_NULL(fs);
+	TEST_ASSERT_TRUE(fs->ready());
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "FSManager... OK!");
+}
+
+
+//------------------------------------------------------------------------------------
+TEST_CASE("WRITE-BACK UN COMMIT________", "[FSManager]") {
+	TEST_ASSERT_NOT_NULL(fs);
+	fs->setWriteBack(true);
+	uint32_t commits = fs->getCommitCount();
+	TEST_ASSERT_TRUE(fs->open());
+	char key[NVSInterface_KEY_MAX_SIZE];
+	for(uint32_t i=0;i<20;i++){
+		sprintf(key, "wb_%d", i % 5);
+		TEST_ASSERT_EQUAL(0, fs->save(key, &i, sizeof(uint32_t), NVSInterface::TypeUint32));
+	}
+	TEST_ASSERT_EQUAL(commits, fs->getCommitCount());
+	fs->close();
+	TEST_ASSERT_EQUAL(commits + 1, fs->getCommitCount());
+
+	// se recupera el ultimo valor escrito de cada clave
+	fs->setWriteBack(false);
+	TEST_ASSERT_TRUE(fs->open());
+	for(uint32_t i=0;i<5;i++){
+		uint32_t value = 0;
+		sprintf(key, "wb_%d", i);
+		TEST_ASSERT_EQUAL(0, fs->restore(key, &value, sizeof(uint32_t), NVSInterface::TypeUint32));
+		TEST_ASSERT_EQUAL(15 + i, value);
+	}
+	fs->close();
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Write-back... OK!");
+}
+
+
+//------------------------------------------------------------------------------------
+TEST_CASE("WRITE-BACK FLUSH EXPLICITO__", "[FSManager]") {
+	TEST_ASSERT_NOT_NULL(fs);
+	fs->setWriteBack(true, 60000);
+	TEST_ASSERT_TRUE(fs->open());
+	fs->removeKey("wb_str");
+	uint32_t commits = fs->getCommitCount();
+	const char* txt = "write-back";
+	TEST_ASSERT_EQUAL(0, fs->save("wb_str", (void*)txt, strlen(txt)+1, NVSInterface::TypeString));
+	fs->close();
+	// el retardo no ha vencido, la clave sigue pendiente pero es legible
+	TEST_ASSERT_EQUAL(commits, fs->getCommitCount());
+	char value[16] = {0};
+	TEST_ASSERT_TRUE(fs->open());
+	TEST_ASSERT_EQUAL(0, fs->restore("wb_str", value, sizeof(value), NVSInterface::TypeString));
+	TEST_ASSERT_EQUAL_STRING(txt, value);
+	fs->close();
+	TEST_ASSERT_EQUAL(0, fs->flush());
+	TEST_ASSERT_EQUAL(commits + 1, fs->getCommitCount());
+	fs->setWriteBack(false);
+}
+
+
+#if NVSFlashSim_ENABLED == 1
+//------------------------------------------------------------------------------------
+TEST_CASE("WRITE-BACK COMMIT FALLIDO___", "[FSManager]") {
+	TEST_ASSERT_NOT_NULL(fs);
+	NVSFlashSim* part = NVSFlashSim::getPartition(DEFAULT_NVSInterface_Partition);
+	fs->setWriteBack(true, 60000);
+	TEST_ASSERT_TRUE(fs->open());
+	TEST_ASSERT_EQUAL(0, fs->save("wb_cfail", (uint32_t)7));
+	fs->close();
+	part->setCommitError(ESP_FAIL);
+	TEST_ASSERT_NOT_EQUAL(0, fs->flush());
+	part->setCommitError(ESP_OK);
+	// la clave sigue pendiente y se vuelve a volcar en el siguiente flush
+	uint32_t commits = fs->getCommitCount();
+	TEST_ASSERT_EQUAL(0, fs->flush());
+	TEST_ASSERT_EQUAL(commits + 1, fs->getCommitCount());
+	fs->setWriteBack(false);
+	uint32_t value = 0;
+	TEST_ASSERT_TRUE(fs->open());
+	TEST_ASSERT_EQUAL(0, fs->restore("wb_cfail", value));
+	fs->removeKey("wb_cfail");
+	fs->close();
+	TEST_ASSERT_EQUAL(7, value);
+}
+#endif
+
+
+//------------------------------------------------------------------------------------
+TEST_CASE("WRITE-BACK VOLCADO DIFERIDO", "[FSManager]") {
+	TEST_ASSERT_NOT_NULL(fs);
+	fs->setWriteBack(true, 200);
+	uint32_t commits = fs->getCommitCount();
+	uint32_t value = 1234;
+	TEST_ASSERT_TRUE(fs->open());
+	TEST_ASSERT_EQUAL(0, fs->save("wb_delay", &value, sizeof(uint32_t), NVSInterface::TypeUint32));
+	fs->close();
+	TEST_ASSERT_EQUAL(commits, fs->getCommitCount());
+	// el volcado se realiza al vencer el retardo, sin nuevas operaciones
+	ThisThread::sleep_for(600);
+	TEST_ASSERT_EQUAL(commits + 1, fs->getCommitCount());
+	fs->setWriteBack(false);
+	TEST_ASSERT_EQUAL(commits + 1, fs->getCommitCount());
+}
+
+
+
+
+//------------------------------------------------------------------------------------
+TEST_CASE("CACHE DE LECTURA____________", "[FSManager]") {
+	TEST_ASSERT_NOT_NULL(fs);
+	fs->setReadCache(8);
+	uint32_t hits, misses;
+	uint16_t value = 1234, rd = 0;
+	TEST_ASSERT_TRUE(fs->open());
+	TEST_ASSERT_EQUAL(0, fs->save("cal_0", &value, sizeof(uint16_t), NVSInterface::TypeUint16));
+	for(int i=0;i<10;i++){
+		TEST_ASSERT_EQUAL(0, fs->restore("cal_0", &rd, sizeof(uint16_t), NVSInterface::TypeUint16));
+		TEST_ASSERT_EQUAL(value, rd);
+	}
+	fs->getReadCacheStats(&hits, &misses);
+	TEST_ASSERT_EQUAL(9, hits);
+	TEST_ASSERT_EQUAL(1, misses);
+
+	// save invalida la clave cacheada
+	value = 4321;
+	TEST_ASSERT_EQUAL(0, fs->save("cal_0", &value, sizeof(uint16_t), NVSInterface::TypeUint16));
+	TEST_ASSERT_EQUAL(0, fs->restore("cal_0", &rd, sizeof(uint16_t), NVSInterface::TypeUint16));
+	TEST_ASSERT_EQUAL(value, rd);
+	fs->getReadCacheStats(&hits, &misses);
+	TEST_ASSERT_EQUAL(2, misses);
+	fs->close();
+	fs->setReadCache(0);
+}
+
+
+
+
+//------------------------------------------------------------------------------------
+TEST_CASE("ESCRITURA EN BLOQUE_________", "[FSManager]") {
+	TEST_ASSERT_NOT_NULL(fs);
+	uint8_t u8 = 8, r8 = 0;
+	int32_t i32 = -32, r32 = 0;
+	char txt[] = "batch", rtxt[16] = {0};
+	NVSInterface::KeyValueEntry wr[] = {
+		{"bt_u8", NVSInterface::TypeUint8, &u8, sizeof(u8)},
+		{"bt_i32", NVSInterface::TypeInt32, &i32, sizeof(i32)},
+		{"bt_str", NVSInterface::TypeString, txt, sizeof(txt)},
+	};
+	NVSInterface::KeyValueEntry rd[] = {
+		{"bt_u8", NVSInterface::TypeUint8, &r8, sizeof(r8)},
+		{"bt_i32", NVSInterface::TypeInt32, &r32, sizeof(r32)},
+		{"bt_str", NVSInterface::TypeString, rtxt, sizeof(rtxt)},
+	};
+	uint32_t commits = fs->getCommitCount();
+	TEST_ASSERT_TRUE(fs->open());
+	TEST_ASSERT_EQUAL(0, fs->saveBatch(wr, 3));
+	TEST_ASSERT_EQUAL(commits + 1, fs->getCommitCount());
+	TEST_ASSERT_EQUAL(0, fs->restoreBatch(rd, 3));
+	fs->close();
+	TEST_ASSERT_EQUAL(u8, r8);
+	TEST_ASSERT_EQUAL(i32, r32);
+	TEST_ASSERT_EQUAL_STRING(txt, rtxt);
+
+	// un bloque vacio no realiza escrituras
+	TEST_ASSERT_TRUE(fs->open());
+	commits = fs->getCommitCount();
+	TEST_ASSERT_EQUAL(0, fs->saveBatch(NULL, 0));
+	TEST_ASSERT_EQUAL(commits, fs->getCommitCount());
+	fs->close();
+
+	#if NVSFlashSim_ENABLED == 1
+	// un bloque fallido no borra una clave almacenada con otro tipo (el simulador rechaza blobs mayores que una
+	// pagina)
+	static uint8_t big[NVSFlashSim_MAX_VALUE_SIZE + 1];
+	NVSInterface::KeyValueEntry bad[] = {
+		{"bt_u8", NVSInterface::TypeString, txt, sizeof(txt)},
+		{"bt_big", NVSInterface::TypeBlob, big, sizeof(big)},
+	};
+	TEST_ASSERT_TRUE(fs->open());
+	TEST_ASSERT_TRUE(fs->saveBatch(bad, 2) != 0);
+	r8 = 0;
+	TEST_ASSERT_EQUAL(0, fs->restore("bt_u8", &r8, sizeof(r8), NVSInterface::TypeUint8));
+	TEST_ASSERT_TRUE(fs->restore("bt_u8", rtxt, sizeof(rtxt), NVSInterface::TypeString) != 0);
+	fs->close();
+	TEST_ASSERT_EQUAL(u8, r8);
+	#endif
+}
+
+
+
+
+//------------------------------------------------------------------------------------
+TEST_CASE("ESCRITURA SIN CAMBIOS_______", "[FSManager]") {
+	TEST_ASSERT_NOT_NULL(fs);
+	uint32_t value = 0xCAFE;
+	uint8_t blob[32];
+	memset(blob, 0xA5, sizeof(blob));
+	TEST_ASSERT_TRUE(fs->open());
+	TEST_ASSERT_EQUAL(0, fs->save("sc_u32", &value, sizeof(value), NVSInterface::TypeUint32));
+	TEST_ASSERT_EQUAL(0, fs->save("sc_blob", blob, sizeof(blob), NVSInterface::TypeBlob));
+	uint32_t commits = fs->getCommitCount();
+	uint32_t suppressed = fs->getSuppressedWrites();
+	TEST_ASSERT_EQUAL(0, fs->save("sc_u32", &value, sizeof(value), NVSInterface::TypeUint32));
+	TEST_ASSERT_EQUAL(0, fs->save("sc_blob", blob, sizeof(blob), NVSInterface::TypeBlob));
+	TEST_ASSERT_EQUAL(commits, fs->getCommitCount());
+	TEST_ASSERT_EQUAL(suppressed + 2, fs->getSuppressedWrites());
+
+	// un blob de distinta longitud si se escribe
+	TEST_ASSERT_EQUAL(0, fs->save("sc_blob", blob, sizeof(blob) - 1, NVSInterface::TypeBlob));
+	TEST_ASSERT_EQUAL(suppressed + 2, fs->getSuppressedWrites());
+	fs->close();
+}
+
+
+
+
+//------------------------------------------------------------------------------------
+TEST_CASE("SAVE/RESTORE TIPADOS________", "[FSManager]") {
+	TEST_ASSERT_NOT_NULL(fs);
+	struct Calib{
+		int16_t offset;
+		float gain;
+	};
+	Calib cal = {-12, 1.25f}, rcal = {0, 0};
+	int64_t counter = -1234567890123LL, rcounter = 0;
+	char txt[16] = {0};
+	TEST_ASSERT_TRUE(fs->open());
+	TEST_ASSERT_EQUAL(0, fs->save("ty_cal", cal));
+	TEST_ASSERT_EQUAL(0, fs->save("ty_cnt", counter));
+	TEST_ASSERT_EQUAL(0, fs->save("ty_str", "tipado"));
+	TEST_ASSERT_EQUAL(0, fs->restore("ty_cal", rcal));
+	TEST_ASSERT_EQUAL(0, fs->restore("ty_cnt", rcounter));
+	TEST_ASSERT_EQUAL(0, fs->restore("ty_str", txt));
+	// un tipo distinto al almacenado se rechaza
+	int32_t wrong = 0;
+	TEST_ASSERT_NOT_EQUAL(0, fs->restore("ty_cnt", wrong));
+	fs->close();
+	TEST_ASSERT_EQUAL(cal.offset, rcal.offset);
+	TEST_ASSERT_EQUAL_FLOAT(cal.gain, rcal.gain);
+	TEST_ASSERT_TRUE(counter == rcounter);
+	TEST_ASSERT_EQUAL_STRING("tipado", txt);
+}
+
+
+
+
+//------------------------------------------------------------------------------------
+static std::atomic<int> async_done(0);
+static std::atomic<int> async_errors(0);
+static void asyncDone(const char* key, int result){
+	// se ejecuta en el thread escritor, se registra el resultado para comprobarlo en el test
+	if(result != 0){
+		async_errors++;
+	}
+	async_done++;
+}
+
+TEST_CASE("ESCRITURA ASINCRONA_________", "[FSManager]") {
+	TEST_ASSERT_NOT_NULL(fs);
+	TEST_ASSERT_EQUAL(0, fs->startAsync(8));
+	async_done = 0;
+	async_errors = 0;
+	int token = 0;
+	for(uint32_t i=0;i<100;i++){
+		// las peticiones fusionadas sobre la clave estan acotadas, se espera al thread escritor si se satura
+		int retries = 0;
+		while((token = fs->saveAsync("as_u32", &i, sizeof(uint32_t), NVSInterface::TypeUint32, callback(asyncDone))) < 0 && retries++ < 500){
+			ThisThread::sleep_for(1);
+		}
+		TEST_ASSERT_TRUE(token > 0);
+	}
+	TEST_ASSERT_EQUAL(0, fs->drain(5000));
+	TEST_ASSERT_TRUE(fs->isCompleted(token));
+	TEST_ASSERT_EQUAL(0, fs->getAsyncResult(token));
+	TEST_ASSERT_EQUAL(-1, fs->getAsyncResult(token + 1));
+	TEST_ASSERT_EQUAL(100, async_done.load());
+	TEST_ASSERT_EQUAL(0, async_errors.load());
+	fs->stopAsync();
+
+	#if NVSFlashSim_ENABLED == 1
+	// los errores descartados del registro no se notifican como escrituras correctas (el simulador rechaza blobs
+	// mayores que una pagina)
+	static uint8_t big[NVSFlashSim_MAX_VALUE_SIZE + 1];
+	int failed[3];
+	TEST_ASSERT_EQUAL(0, fs->startAsync(2));
+	for(int i=0;i<3;i++){
+		char key[16];
+		sprintf(key, "as_big%d", i);
+		failed[i] = fs->saveAsync(key, big, sizeof(big), NVSInterface::TypeBlob);
+		TEST_ASSERT_TRUE(failed[i] > 0);
+		TEST_ASSERT_EQUAL(0, fs->drain(5000));
+	}
+	TEST_ASSERT_EQUAL(-1, fs->getAsyncResult(token));
+	TEST_ASSERT_EQUAL(-1, fs->getAsyncResult(failed[0]));
+	TEST_ASSERT_FALSE(fs->isCompleted(failed[0]));
+	TEST_ASSERT_EQUAL(-1, fs->getAsyncResult(failed[1]));
+	TEST_ASSERT_EQUAL(-1, fs->getAsyncResult(failed[2]));
+	fs->stopAsync();
+	#endif
+
+	uint32_t value = 0;
+	TEST_ASSERT_TRUE(fs->open());
+	TEST_ASSERT_EQUAL(0, fs->restore("as_u32", value));
+	fs->close();
+	TEST_ASSERT_EQUAL(99, value);
+}
+
+
+
+
+//------------------------------------------------------------------------------------
+static int it_blobs = 0;
+static bool visitKey(const NVSInterface::KeyInfo& info){
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Clave %s tipo %d size %d", info.key, (int)info.type, info.size);
+	TEST_ASSERT_EQUAL(0, strncmp(info.key, "it_", 3));
+	if(info.type == NVSInterface::TypeBlob){
+		TEST_ASSERT_EQUAL(20, info.size);
+		it_blobs++;
+	}
+	return true;
+}
+
+TEST_CASE("ENUMERA CLAVES______________", "[FSManager]") {
+	TEST_ASSERT_NOT_NULL(fs);
+	uint8_t blob[20] = {0};
+	uint32_t value = 32;
+	TEST_ASSERT_TRUE(fs->open());
+	TEST_ASSERT_EQUAL(0, fs->save("it_u32", value));
+	TEST_ASSERT_EQUAL(0, fs->save("it_blob", blob));
+	TEST_ASSERT_EQUAL(0, fs->save("it_str", "enumera"));
+	TEST_ASSERT_TRUE(fs->checkKey("it_u32"));
+	TEST_ASSERT_FALSE(fs->checkKey("it_none"));
+	it_blobs = 0;
+	TEST_ASSERT_EQUAL(3, fs->forEachKey("it_", NVSInterface::TypeAny, callback(visitKey)));
+	TEST_ASSERT_EQUAL(1, it_blobs);
+	TEST_ASSERT_EQUAL(1, fs->forEachKey("it_", NVSInterface::TypeString, callback(visitKey)));
+	fs->close();
+}
+
+
+
+
+//------------------------------------------------------------------------------------
+static bool visitChunkKey(const NVSInterface::KeyInfo& info){
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "Fragmento %s size %d", info.key, info.size);
+	return true;
+}
+
+TEST_CASE("BLOB POR FRAGMENTOS_________", "[FSManager]") {
+	TEST_ASSERT_NOT_NULL(fs);
+	static const uint32_t BlobSize = 10000;
+	uint8_t chunk[100];
+	TEST_ASSERT_TRUE(fs->open());
+	NVSBlobWriter* wr = new NVSBlobWriter(fs, "bigblob", 512);
+	for(uint32_t offset = 0; offset < BlobSize; offset += sizeof(chunk)){
+		for(uint32_t i = 0; i < sizeof(chunk); i++){
+			chunk[i] = (uint8_t)(offset + i);
+		}
+		TEST_ASSERT_EQUAL(sizeof(chunk), wr->write(chunk, sizeof(chunk)));
+	}
+	TEST_ASSERT_EQUAL(0, wr->finish());
+	delete(wr);
+
+	NVSBlobReader* rd = new NVSBlobReader(fs, "bigblob");
+	TEST_ASSERT_TRUE(rd->ready());
+	TEST_ASSERT_EQUAL(BlobSize, rd->size());
+	uint32_t offset = 0;
+	int count;
+	while((count = rd->read(chunk, 37)) > 0){
+		for(int i = 0; i < count; i++){
+			TEST_ASSERT_EQUAL((uint8_t)(offset + i), chunk[i]);
+		}
+		offset += count;
+	}
+	TEST_ASSERT_EQUAL(0, count);
+	TEST_ASSERT_EQUAL(BlobSize, offset);
+	delete(rd);
+
+	// una reescritura interrumpida antes del manifiesto no altera el blob vigente
+	memset(chunk, 0xA5, sizeof(chunk));
+	wr = new NVSBlobWriter(fs, "bigblob", 512);
+	for(uint32_t i = 0; i < 20; i++){
+		TEST_ASSERT_EQUAL(sizeof(chunk), wr->write(chunk, sizeof(chunk)));
+	}
+	delete(wr);
+	rd = new NVSBlobReader(fs, "bigblob");
+	TEST_ASSERT_TRUE(rd->ready());
+	offset = 0;
+	while((count = rd->read(chunk, sizeof(chunk))) > 0){
+		TEST_ASSERT_EQUAL((uint8_t)offset, chunk[0]);
+		offset += count;
+	}
+	TEST_ASSERT_EQUAL(0, count);
+	TEST_ASSERT_EQUAL(BlobSize, offset);
+	delete(rd);
+
+	// la reescritura completa sustituye el blob y elimina los fragmentos de la generacion anterior
+	memset(chunk, 0x5A, sizeof(chunk));
+	wr = new NVSBlobWriter(fs, "bigblob", 512);
+	TEST_ASSERT_EQUAL(sizeof(chunk), wr->write(chunk, sizeof(chunk)));
+	TEST_ASSERT_EQUAL(0, wr->finish());
+	delete(wr);
+	rd = new NVSBlobReader(fs, "bigblob");
+	TEST_ASSERT_TRUE(rd->ready());
+	TEST_ASSERT_EQUAL(sizeof(chunk), rd->read(chunk, sizeof(chunk)));
+	TEST_ASSERT_EQUAL(0x5A, chunk[sizeof(chunk) - 1]);
+	TEST_ASSERT_EQUAL(0, rd->read(chunk, sizeof(chunk)));
+	delete(rd);
+	TEST_ASSERT_EQUAL(1, fs->forEachKey("bigblob.", NVSInterface::TypeBlob, callback(visitChunkKey)));
+
+	// fragmentos de tamanio nulo
+	wr = new NVSBlobWriter(fs, "zeroblob", 0);
+	TEST_ASSERT_TRUE(wr->write(chunk, sizeof(chunk)) < 0);
+	TEST_ASSERT_TRUE(wr->finish() < 0);
+	delete(wr);
+	NVSBlobStream::Manifest manifest = {NVSBlobStream::ManifestMagic, BlobSize, 0, 1, 0};
+	TEST_ASSERT_EQUAL(0, fs->save("zeroblob", &manifest, sizeof(manifest), NVSInterface::TypeBlob));
+	rd = new NVSBlobReader(fs, "zeroblob");
+	TEST_ASSERT_FALSE(rd->ready());
+	delete(rd);
+	fs->removeKey("zeroblob");
+	fs->close();
+}
+
+
+
+
+//------------------------------------------------------------------------------------
+TEST_CASE("ESTADISTICAS________________", "[FSManager]") {
+	TEST_ASSERT_NOT_NULL(fs);
+	StorageOpStats stats[FSManager::StatCount];
+	fs->resetStats();
+	TEST_ASSERT_TRUE(fs->open());
+	for(uint32_t i=0;i<10;i++){
+		uint32_t value = 0;
+		TEST_ASSERT_EQUAL(0, fs->save("st_u32", i));
+		TEST_ASSERT_EQUAL(0, fs->restore("st_u32", value));
+		TEST_ASSERT_EQUAL(i, value);
+	}
+	fs->close();
+	fs->getStats(stats);
+	#if StorageStats_ENABLED == 1
+	TEST_ASSERT_EQUAL(10, stats[FSManager::StatSave].count);
+	TEST_ASSERT_EQUAL(40, stats[FSManager::StatSave].bytes);
+	TEST_ASSERT_EQUAL(10, stats[FSManager::StatRestore].count);
+	TEST_ASSERT_EQUAL(1, stats[FSManager::StatOpen].count);
+	TEST_ASSERT_TRUE(stats[FSManager::StatSave].p50() <= stats[FSManager::StatSave].p99());
+	TEST_ASSERT_TRUE(stats[FSManager::StatSave].p99() <= stats[FSManager::StatSave].max());
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "save p50=%dus p99=%dus max=%dus", stats[FSManager::StatSave].p50(), stats[FSManager::StatSave].p99(), stats[FSManager::StatSave].max());
+	#endif
+}
+
+
+
+#if NVSFlashSim_ENABLED == 1
+//------------------------------------------------------------------------------------
+TEST_CASE("SIMULADOR FLASH NVS_________", "[FSManager]") {
+	TEST_ASSERT_NOT_NULL(fs);
+	NVSFlashSim* part = NVSFlashSim::getPartition(DEFAULT_NVSInterface_Partition);
+	NVSFlashSim::Counters counters;
+	part->resetCounters();
+	// sobrescrituras de una clave hasta forzar la liberacion de paginas
+	TEST_ASSERT_TRUE(fs->open());
+	for(uint32_t i=0;i<1000;i++){
+		TEST_ASSERT_EQUAL(0, fs->save("sim_cnt", i));
+	}
+	fs->close();
+	part->getCounters(&counters);
+	TEST_ASSERT_TRUE(counters.page_erases > 0);
+	TEST_ASSERT_TRUE(counters.bytes_programmed > counters.user_bytes);
+	// sin write-back, cada sobrescritura borra la clave (commit) y la vuelve a escribir (commit)
+	TEST_ASSERT_EQUAL(1 + 999 * 2, counters.commits);
+	uint32_t value = 0;
+	TEST_ASSERT_TRUE(fs->open());
+	TEST_ASSERT_EQUAL(0, fs->restore("sim_cnt", value));
+	fs->close();
+	TEST_ASSERT_EQUAL(999, value);
+	DEBUG_TRACE_D(_EXPR_, _MODULE_, "erases=%d (max %d/pagina) programado=%dB usuario=%dB", counters.page_erases, counters.max_page_erases, counters.bytes_programmed, counters.user_bytes);
+}
+
+
+//------------------------------------------------------------------------------------
+TEST_CASE("SIMULADOR PARTICION LLENA___", "[FSManager]") {
+	NVSFlashSim::Config cfg = NVSFlashSim::defaultConfig();
+	cfg.num_pages = 3;
+	NVSFlashSim* part = NVSFlashSim::configure("nvs_full", cfg);
+	TEST_ASSERT_NOT_NULL(part);
+	TEST_ASSERT_EQUAL(ESP_OK, nvs_flash_init_partition("nvs_full"));
+	nvs_handle h;
+	TEST_ASSERT_EQUAL(ESP_OK, nvs_open_from_partition("nvs_full", "full", NVS_READWRITE, &h));
+	static uint8_t blob[1900];
+	char key[8];
+	// dos blobs por pagina y una pagina reservada para liberar: caben 4
+	for(int i=0;i<4;i++){
+		sprintf(key, "blob%d", i);
+		TEST_ASSERT_EQUAL(ESP_OK, nvs_set_blob(h, key, blob, sizeof(blob)));
+	}
+	NVSFlashSim::Counters counters;
+	part->getCounters(&counters);
+	uint32_t erases = counters.page_erases;
+	TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_ENOUGH_SPACE, nvs_set_blob(h, "blob4", blob, sizeof(blob)));
+	part->getCounters(&counters);
+	TEST_ASSERT_TRUE(counters.page_erases <= erases + cfg.num_pages);
+	// al borrar una clave se recupera su espacio
+	TEST_ASSERT_EQUAL(ESP_OK, nvs_erase_key(h, "blob0"));
+	TEST_ASSERT_EQUAL(ESP_OK, nvs_set_blob(h, "blob4", blob, sizeof(blob)));
+	size_t len = sizeof(blob);
+	TEST_ASSERT_EQUAL(ESP_OK, nvs_get_blob(h, "blob1", blob, &len));
+	TEST_ASSERT_EQUAL(sizeof(blob), len);
+	nvs_close(h);
+}
+#endif
+
+
+
+//------------------------------------------------------------------------------------
+//-- TEST ENRY POINT -----------------------------------------------------------------
+//------------------------------------------------------------------------------------
+
+
+//-----------------------------------------------------------------------------
+#if __MBED__ == 1 && defined(ENABLE_TEST_DEBUGGING) && defined(ENABLE_TEST_FSManager)
+void firmwareStart(bool wait_forever){
+	esp_log_level_set(_MODULE_, ESP_LOG_DEBUG);
+	DEBUG_TRACE_I(_EXPR_, _MODULE_, "Inicio del programa");
+	Heap::setDebugLevel(ESP_LOG_ERROR);
+	unity_run_menu();
+}
+#endif
+
+
+#endif